@@ -58,7 +58,6 @@ private:
 	VkSampler sampler;
 	VkImage image;
 	VkImageView view;
-	vks::Buffer vertexBuffer;
 	VkDeviceMemory imageMemory;
 	VkDescriptorPool descriptorPool;
 	VkDescriptorSetLayout descriptorSetLayout;
@@ -70,7 +69,23 @@ private:
 	VkCommandPool commandPool;
 	std::vector<VkFramebuffer*> frameBuffers;
 	std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
-	VkFence fence;
+
+	/*
+		Vertex buffer of each frame slot, so the text can change while earlier frames still render it
+		A slot only picks up the current text in updateFrame, once the frame that last used it has finished
+	*/
+	struct FrameSlot {
+		vks::Buffer vertexBuffer;
+		uint32_t numLetters = 0;
+		// Set if the slot's vertex buffer doesn't hold the current text yet
+		bool outdated = true;
+		// Swap chain image the slot's command buffer was last recorded for
+		uint32_t recordedBuffer = UINT32_MAX;
+	};
+	std::vector<FrameSlot> frameSlots;
+
+	// Text geometry of the last update, copied into the frame slots' vertex buffers
+	std::vector<glm::vec4> vertices;
 
 	// Used during text updates
 	glm::vec4 *mappedLocal = nullptr;
@@ -87,12 +102,14 @@ public:
 
 	float scale = 1.0f;
 
+	// Command buffer of each frame slot (see updateFrame)
 	std::vector<VkCommandBuffer> cmdBuffers;
 
 	/**
 	* Default constructor
 	*
 	* @param vulkanDevice Pointer to a valid VulkanDevice
+	* @param frameSlotCount Number of frames in flight, each frame slot gets its own vertex and command buffer
 	*/
 	VulkanTextOverlay(
 		vks::VulkanDevice *vulkanDevice,
@@ -102,7 +119,8 @@ public:
 		VkFormat depthformat,
 		uint32_t *framebufferwidth,
 		uint32_t *framebufferheight,
-		std::vector<VkPipelineShaderStageCreateInfo> shaderstages)
+		std::vector<VkPipelineShaderStageCreateInfo> shaderstages,
+		uint32_t frameSlotCount)
 	{
 		this->vulkanDevice = vulkanDevice;
 		this->queue = queue;
@@ -136,7 +154,9 @@ public:
 		};
 #endif
 
-		cmdBuffers.resize(framebuffers.size());
+		cmdBuffers.resize(frameSlotCount);
+		frameSlots.resize(frameSlotCount);
+		vertices.resize(MAX_CHAR_COUNT);
 		prepareResources();
 		prepareRenderPass();
 		preparePipeline();
@@ -148,7 +168,10 @@ public:
 	~VulkanTextOverlay()
 	{
 		// Free up all Vulkan resources requested by the text overlay
-		vertexBuffer.destroy();
+		for (auto &frameSlot : frameSlots)
+		{
+			frameSlot.vertexBuffer.destroy();
+		}
 		vkDestroySampler(vulkanDevice->logicalDevice, sampler, nullptr);
 		vkDestroyImage(vulkanDevice->logicalDevice, image, nullptr);
 		vkDestroyImageView(vulkanDevice->logicalDevice, view, nullptr);
@@ -161,7 +184,6 @@ public:
 		vkDestroyRenderPass(vulkanDevice->logicalDevice, renderPass, nullptr);
 		vkFreeCommandBuffers(vulkanDevice->logicalDevice, commandPool, static_cast<uint32_t>(cmdBuffers.size()), cmdBuffers.data());
 		vkDestroyCommandPool(vulkanDevice->logicalDevice, commandPool, nullptr);
-		vkDestroyFence(vulkanDevice->logicalDevice, fence, nullptr);
 	}
 
 	/**
@@ -190,15 +212,18 @@ public:
 
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &cmdBufAllocateInfo, cmdBuffers.data()));
 
-		// Vertex buffer
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&vertexBuffer,
-			MAX_CHAR_COUNT * sizeof(glm::vec4)));
-
-		// Map persistent
-		vertexBuffer.map();
+		// Vertex buffers
+		for (auto &frameSlot : frameSlots)
+		{
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&frameSlot.vertexBuffer,
+				MAX_CHAR_COUNT * sizeof(glm::vec4)));
+
+			// Map persistent
+			frameSlot.vertexBuffer.map();
+		}
 
 		// Font texture
 		VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
@@ -370,10 +395,6 @@ public:
 		VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 		pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
 		VK_CHECK_RESULT(vkCreatePipelineCache(vulkanDevice->logicalDevice, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
-
-		// Command buffer execution fence
-		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo();
-		VK_CHECK_RESULT(vkCreateFence(vulkanDevice->logicalDevice, &fenceCreateInfo, nullptr, &fence));
 	}
 
 	/**
@@ -513,10 +534,11 @@ public:
 		// Transition from final to initial (VK_SUBPASS_EXTERNAL refers to all commmands executed outside of the actual renderpass)
 		subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		subpassDependencies[0].dstSubpass = 0;
-		subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-		subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		subpassDependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		// Also orders the depth attachment access after the depth writes of earlier passes and frames (the depth image is shared)
+		subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		subpassDependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 		subpassDependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 		// Transition from initial to final
@@ -554,11 +576,11 @@ public:
 	}
 
 	/**
-	* Maps the buffer, resets letter count
+	* Resets the text geometry and letter count
 	*/
 	void beginTextUpdate()
 	{
-		mappedLocal = (glm::vec4*)vertexBuffer.mapped;
+		mappedLocal = vertices.data();
 		numLetters = 0;
 	}
 
@@ -572,7 +594,7 @@ public:
 	*/
 	void addText(std::string text, float x, float y, TextAlign align)
 	{
-		assert(vertexBuffer.mapped != nullptr);
+		assert(mappedLocal != nullptr);
 
 		if (align == alignLeft) {
 			x *= scale;
@@ -644,18 +666,40 @@ public:
 	}
 
 	/**
-	* Unmap buffer and update command buffers
+	* Finishes the text update, the frame slots pick up the new text with their next updateFrame
 	*/
 	void endTextUpdate()
 	{
-		updateCommandBuffers();
+		for (auto &frameSlot : frameSlots)
+		{
+			frameSlot.outdated = true;
+		}
 	}
 
 	/**
-	* Update the command buffers to reflect text changes
+	* Copies the current text into a frame slot's vertex buffer and records the slot's command buffer for a swap chain image
+	* @note The frame that last used the slot must have finished (e.g. after waiting for the slot's fence)
+	*
+	* @param slot Frame slot to update
+	* @param bufferIndex Index of the swap chain image (frame buffer) the text is rendered to
 	*/
-	void updateCommandBuffers()
+	void updateFrame(uint32_t slot, uint32_t bufferIndex)
 	{
+		FrameSlot &frameSlot = frameSlots[slot];
+		if ((!frameSlot.outdated) && (frameSlot.recordedBuffer == bufferIndex))
+		{
+			return;
+		}
+		if (frameSlot.outdated)
+		{
+			memcpy(frameSlot.vertexBuffer.mapped, vertices.data(), numLetters * 4 * sizeof(glm::vec4));
+			frameSlot.numLetters = numLetters;
+			frameSlot.outdated = false;
+		}
+		frameSlot.recordedBuffer = bufferIndex;
+
+		VkCommandBuffer cmdBuffer = cmdBuffers[slot];
+
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
@@ -665,70 +709,47 @@ public:
 		// None of the attachments will be cleared
 		renderPassBeginInfo.clearValueCount = 0;
 		renderPassBeginInfo.pClearValues = nullptr;
+		renderPassBeginInfo.framebuffer = *frameBuffers[bufferIndex];
 
-		for (size_t i = 0; i < cmdBuffers.size(); ++i)
-		{
-			renderPassBeginInfo.framebuffer = *frameBuffers[i];
-
-			VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffers[i], &cmdBufInfo));
-
-			if (vks::debugmarker::active)
-			{
-				vks::debugmarker::beginRegion(cmdBuffers[i], "Text overlay", glm::vec4(1.0f, 0.94f, 0.3f, 1.0f));
-			}
-
-			vkCmdBeginRenderPass(cmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			VkViewport viewport = vks::initializers::viewport((float)*frameBufferWidth, (float)*frameBufferHeight, 0.0f, 1.0f);
-			vkCmdSetViewport(cmdBuffers[i], 0, 1, &viewport);
+		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
 
-			VkRect2D scissor = vks::initializers::rect2D(*frameBufferWidth, *frameBufferHeight, 0, 0);
-			vkCmdSetScissor(cmdBuffers[i], 0, 1, &scissor);
-			
-			vkCmdBindPipeline(cmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-			vkCmdBindDescriptorSets(cmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+		if (vks::debugmarker::active)
+		{
+			vks::debugmarker::beginRegion(cmdBuffer, "Text overlay", glm::vec4(1.0f, 0.94f, 0.3f, 1.0f));
+		}
 
-			VkDeviceSize offsets = 0;
-			vkCmdBindVertexBuffers(cmdBuffers[i], 0, 1, &vertexBuffer.buffer, &offsets);
-			vkCmdBindVertexBuffers(cmdBuffers[i], 1, 1, &vertexBuffer.buffer, &offsets);
-			for (uint32_t j = 0; j < numLetters; j++)
-			{
-				vkCmdDraw(cmdBuffers[i], 4, 1, j * 4, 0);
-			}
+		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			vkCmdEndRenderPass(cmdBuffers[i]);
+		VkViewport viewport = vks::initializers::viewport((float)*frameBufferWidth, (float)*frameBufferHeight, 0.0f, 1.0f);
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
 
-			if (vks::debugmarker::active)
-			{
-				vks::debugmarker::endRegion(cmdBuffers[i]);
-			}
+		VkRect2D scissor = vks::initializers::rect2D(*frameBufferWidth, *frameBufferHeight, 0, 0);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffers[i]));
-		}
-	}
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
 
-	/**
-	* Submit the text command buffers to a queue
-	*/
-	void submit(VkQueue queue, uint32_t bufferindex, VkSubmitInfo submitInfo)
-	{
-		if (!visible)
+		VkDeviceSize offsets = 0;
+		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &frameSlot.vertexBuffer.buffer, &offsets);
+		vkCmdBindVertexBuffers(cmdBuffer, 1, 1, &frameSlot.vertexBuffer.buffer, &offsets);
+		for (uint32_t j = 0; j < frameSlot.numLetters; j++)
 		{
-			return;
+			vkCmdDraw(cmdBuffer, 4, 1, j * 4, 0);
 		}
 
-		submitInfo.pCommandBuffers = &cmdBuffers[bufferindex];
-		submitInfo.commandBufferCount = 1;
+		vkCmdEndRenderPass(cmdBuffer);
 
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+		if (vks::debugmarker::active)
+		{
+			vks::debugmarker::endRegion(cmdBuffer);
+		}
 
-		VK_CHECK_RESULT(vkWaitForFences(vulkanDevice->logicalDevice, 1, &fence, VK_TRUE, UINT64_MAX));
-		VK_CHECK_RESULT(vkResetFences(vulkanDevice->logicalDevice, 1, &fence));
+		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
 	}
 
 	/**
 	* Reallocate command buffers for the text overlay
-	* @note Frees the existing command buffers
+	* @note Frees the existing command buffers, the frame that last used them must have finished
 	*/
 	void reallocateCommandBuffers()
 	{
@@ -741,6 +762,12 @@ public:
 				static_cast<uint32_t>(cmdBuffers.size()));
 
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &cmdBufAllocateInfo, cmdBuffers.data()));
+
+		// The frame buffers may have changed, record every slot again
+		for (auto &frameSlot : frameSlots)
+		{
+			frameSlot.recordedBuffer = UINT32_MAX;
+		}
 	}
 
 };
\ No newline at end of file
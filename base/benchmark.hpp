@@ -6,6 +6,9 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
+#include <stdio.h>
 #include <vector>
 #include <string>
 #include <algorithm>
@@ -13,12 +16,128 @@
 #include <functional>
 #include <chrono>
 #include <iomanip>
+#include <iostream>
+#include <fstream>
+#include <numeric>
+#include <cmath>
 
 namespace vks
 {
+	/*
+		Summary statistics for a set of timings (in ms)
+		Percentiles are interpolated linearly between the two closest samples, the lows are the average of the slowest
+		1% and 0.1% of the samples (at least one sample), as used for the "1% low" frame rates
+	*/
+	struct BenchmarkStatistics {
+		double min = 0.0;
+		double max = 0.0;
+		double avg = 0.0;
+		double stddev = 0.0;
+		double median = 0.0;
+		double p90 = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double low1 = 0.0;
+		double low01 = 0.0;
+
+		// Returns the p-th percentile (0..100) of an ascending sorted list of samples
+		static double percentile(const std::vector<double> &sorted, double p) {
+			if (sorted.empty()) {
+				return 0.0;
+			}
+			const double rank = p / 100.0 * (sorted.size() - 1);
+			const size_t lower = (size_t)floor(rank);
+			const size_t upper = std::min(lower + 1, sorted.size() - 1);
+			return sorted[lower] + (sorted[upper] - sorted[lower]) * (rank - lower);
+		}
+
+		// Returns the average of the slowest fraction (0..1) of an ascending sorted list of samples
+		static double low(const std::vector<double> &sorted, double fraction) {
+			if (sorted.empty()) {
+				return 0.0;
+			}
+			const size_t count = std::max((size_t)ceil(sorted.size() * fraction), (size_t)1);
+			return std::accumulate(sorted.end() - count, sorted.end(), 0.0) / count;
+		}
+
+		static BenchmarkStatistics calculate(std::vector<double> samples) {
+			BenchmarkStatistics stats;
+			if (samples.empty()) {
+				return stats;
+			}
+			std::sort(samples.begin(), samples.end());
+			stats.min = samples.front();
+			stats.max = samples.back();
+			stats.avg = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+			double variance = 0.0;
+			for (auto sample : samples) {
+				variance += (sample - stats.avg) * (sample - stats.avg);
+			}
+			stats.stddev = sqrt(variance / samples.size());
+			stats.median = percentile(samples, 50.0);
+			stats.p90 = percentile(samples, 90.0);
+			stats.p95 = percentile(samples, 95.0);
+			stats.p99 = percentile(samples, 99.0);
+			stats.low1 = low(samples, 0.01);
+			stats.low01 = low(samples, 0.001);
+			return stats;
+		}
+	};
+
 	class Benchmark {
 	private:
 		FILE *stream;
+
+		// Frames per second for a frame time in ms, 0 if there is no frame time (so no inf ends up in the results)
+		static double getFps(double frameTime) {
+			return (frameTime > 0.0) ? 1000.0 / frameTime : 0.0;
+		}
+
+		// Frame times of all iterations (without the warm up run)
+		std::vector<double> getFrameTimes() const {
+			std::vector<double> frameTimes;
+			for (auto &iteration : iterations) {
+				frameTimes.insert(frameTimes.end(), iteration.frameTimes.begin(), iteration.frameTimes.end());
+			}
+			return frameTimes;
+		}
+
+		bool saveJSON(const std::string &filename, const std::string &appinfo, const std::string &deviceinfo, const BenchmarkStatistics &stats) const {
+			std::ofstream file(filename, std::ios::out);
+			if (!file.is_open()) {
+				return false;
+			}
+			file << std::fixed << std::setprecision(4);
+			file << "{" << std::endl;
+			file << "\t\"application\": \"" << appinfo << "\"," << std::endl;
+			file << "\t\"device\": \"" << deviceinfo << "\"," << std::endl;
+			file << "\t\"iterations\": " << iterations.size() << "," << std::endl;
+			file << "\t\"framesPerIteration\": " << framesPerIteration << "," << std::endl;
+			file << "\t\"frameTime\": { \"min\": " << stats.min << ", \"max\": " << stats.max << ", \"avg\": " << stats.avg
+				<< ", \"stddev\": " << stats.stddev << ", \"p50\": " << stats.median << ", \"p90\": " << stats.p90
+				<< ", \"p95\": " << stats.p95 << ", \"p99\": " << stats.p99 << ", \"low1\": " << stats.low1 << ", \"low01\": " << stats.low01 << " }," << std::endl;
+			file << "\t\"fps\": { \"avg\": " << getFps(stats.avg) << ", \"p50\": " << getFps(stats.median)
+				<< ", \"low1\": " << getFps(stats.low1) << ", \"low01\": " << getFps(stats.low01) << " }," << std::endl;
+			file << "\t\"stutters\": { \"factor\": " << stutterFactor << ", \"count\": " << stutterCount << " }," << std::endl;
+			file << "\t\"histogram\": { \"bucketWidth\": " << histogramBucketWidth << ", \"counts\": [";
+			for (size_t i = 0; i < histogram.size(); i++) {
+				file << (i > 0 ? ", " : "") << histogram[i];
+			}
+			file << "] }," << std::endl;
+			file << "\t\"iterationAverages\": [";
+			for (size_t i = 0; i < iterations.size(); i++) {
+				const std::vector<double> &frameTimes = iterations[i].frameTimes;
+				file << (i > 0 ? ", " : "") << std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) / frameTimes.size();
+			}
+			file << "]," << std::endl;
+			file << "\t\"counters\": {";
+			for (size_t i = 0; i < counters.size(); i++) {
+				file << (i > 0 ? ", " : " ") << "\"" << counters[i].first << "\": " << counters[i].second << ((i == counters.size() - 1) ? " " : "");
+			}
+			file << "}" << std::endl;
+			file << "}" << std::endl;
+			return true;
+		}
 	public:
 		bool active = false;
 		uint32_t framesPerIteration = 1000;
@@ -29,6 +148,21 @@ namespace vks
 		};
 		std::vector<Iteration> iterations;
 		std::string filename = "benchmarkresults.csv";
+		// Summary for automated comparisons, defaults to the result file name with a .json extension
+		std::string jsonFilename;
+		// Application specific counters added to the results (name, value)
+		std::vector<std::pair<std::string, uint64_t>> counters;
+		// Frames taking longer than stutterFactor times the median frame time count as stutters
+		double stutterFactor = 2.0;
+		uint32_t stutterCount = 0;
+		// Number of frames per frame time range of histogramBucketWidth ms, the last bucket also counts all slower frames
+		double histogramBucketWidth = 0.5;
+		uint32_t histogramBucketCount = 100;
+		std::vector<uint32_t> histogram;
+
+		void addCounter(const std::string &name, uint64_t value) {
+			counters.push_back(std::make_pair(name, value));
+		}
 
 		void run(std::function<void()> renderFunc) {
 			active = true;
@@ -56,6 +190,15 @@ namespace vks
 		}
 
 		void saveResults(std::string appinfo, std::string deviceinfo) {
+			const std::vector<double> frameTimes = getFrameTimes();
+			const BenchmarkStatistics stats = BenchmarkStatistics::calculate(frameTimes);
+			stutterCount = 0;
+			histogram.assign(histogramBucketCount, 0);
+			for (auto frameTime : frameTimes) {
+				stutterCount += (frameTime > stutterFactor * stats.median) ? 1 : 0;
+				histogram[std::min((size_t)(frameTime / histogramBucketWidth), histogram.size() - 1)]++;
+			}
+
 			std::ofstream result(filename, std::ios::out);
 			if (result.is_open()) {
 				double tMinAll = std::numeric_limits<double>::max();
@@ -83,13 +226,35 @@ namespace vks
 				tAvgAll /= static_cast<uint32_t>(iterations.size());
 				result << "summary,min(ms),max(ms),avg(ms),min(fps),max(fps),avg(fps)" << std::endl;
 				result << index << "," << tMinAll << "," << tMaxAll << "," << tAvgAll << "," << (1000.0 / tMaxAll) << "," << (1000.0 / tMinAll) << "," << (1000.0 / tAvgAll) << std::endl;
+				result << "p50(ms),p95(ms),p99(ms),1% low(ms),0.1% low(ms),1% low(fps),0.1% low(fps),stutters" << std::endl;
+				result << stats.median << "," << stats.p95 << "," << stats.p99 << "," << stats.low1 << "," << stats.low01 << "," << getFps(stats.low1) << "," << getFps(stats.low01) << "," << stutterCount << std::endl;
+				result << "histogram from(ms),frames" << std::endl;
+				for (size_t i = 0; i < histogram.size(); i++) {
+					if (histogram[i] > 0) {
+						result << i * histogramBucketWidth << "," << histogram[i] << std::endl;
+					}
+				}
+				if (!counters.empty()) {
+					result << "counter,value" << std::endl;
+					for (auto &counter : counters) {
+						result << counter.first << "," << counter.second << std::endl;
+					}
+				}
 
 				// Output averages to stdout
 				std::cout << std::fixed << std::setprecision(3);
 				std::cout << "best : " << (1000.0 / tMinAll) << " fps (" << tMinAll << " ms)" << std::endl;
 				std::cout << "worst: " << (1000.0 / tMaxAll) << " fps (" << tMaxAll << " ms)" << std::endl;
 				std::cout << "avg  : " << (1000.0 / tAvgAll) << " fps (" << tAvgAll << " ms)" << std::endl;
+				std::cout << "p50 / p95 / p99: " << stats.median << " / " << stats.p95 << " / " << stats.p99 << " ms" << std::endl;
+				std::cout << "1% / 0.1% low: " << getFps(stats.low1) << " / " << getFps(stats.low01) << " fps" << std::endl;
+				std::cout << "stutters: " << stutterCount << " frames > " << stutterFactor << "x median" << std::endl;
+				for (auto &counter : counters) {
+					std::cout << counter.first << ": " << counter.second << std::endl;
+				}
 				std::cout << std::endl;
+
+				saveJSON(jsonFilename.empty() ? filename.substr(0, filename.find_last_of('.')) + ".json" : jsonFilename, appinfo, deviceinfo, stats);
 #if defined(_WIN32)
 				fclose(stream);
 				FreeConsole();
@@ -97,4 +262,4 @@ namespace vks
 			}
 		}
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,352 @@
+/*
+* Per frame CPU and GPU stage timings
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanDevice.hpp"
+
+namespace vks
+{
+	/*
+		CPU and GPU timings of named stages of a frame, kept in a ring buffer for the last historySize frames
+
+		CPU times are taken with scoped timers, a stage timed more than once per frame adds up
+		GPU times are taken with timestamp queries written around the stage's commands. Each frame slot (frame in
+		flight) has its own range of queries, which is reset when the slot's frame begins and read back when the slot
+		begins its next frame (after waiting for the slot's fence), so the GPU times of a frame are available
+		maxFramesInFlight frames later
+
+		Times are in ms, CPU start times are relative to the start of the frame, GPU start times to the first
+		timestamp of the frame. Stages that weren't measured in a frame have a negative time
+	*/
+	class FrameProfiler
+	{
+	public:
+		static const uint32_t maxStages = 8;
+		static const uint32_t historySize = 256;
+
+		struct Timing {
+			double start = 0.0;
+			double time = -1.0;
+		};
+
+		struct Frame {
+			uint64_t index = 0;
+			// Start of the frame on the CPU since the profiler was prepared
+			double begin = 0.0;
+			// Set once the GPU timings have been read back
+			bool complete = false;
+			Timing cpu[maxStages];
+			Timing gpu[maxStages];
+		};
+
+		// Adds the time from construction to destruction to a stage's CPU time of the current frame
+		class CpuScope {
+		private:
+			FrameProfiler &profiler;
+			uint32_t stage;
+			std::chrono::high_resolution_clock::time_point tStart;
+		public:
+			CpuScope(FrameProfiler &profiler, uint32_t stage) : profiler(profiler), stage(stage) {
+				tStart = std::chrono::high_resolution_clock::now();
+			}
+			~CpuScope() {
+				profiler.addCpuTime(stage, tStart, std::chrono::high_resolution_clock::now());
+			}
+		};
+
+		std::vector<std::string> stageNames;
+		// False if the graphics queue doesn't support timestamps, only CPU times are taken then
+		bool gpuTimestamps = false;
+
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		uint32_t slotCount = 0;
+		uint64_t timestampMask = 0;
+		// Nanoseconds per timestamp tick
+		float timestampPeriod = 1.0f;
+		// Reset the query range of each slot
+		std::vector<VkCommandBuffer> resetCommandBuffers;
+		// Write a single timestamp (see getTimestampCommandBuffer), created on first use
+		std::vector<VkCommandBuffer> timestampCommandBuffers;
+		// Index of the frame last begun in each slot, UINT64_MAX if none
+		std::vector<uint64_t> slotFrames;
+		std::vector<Frame> history;
+		// Number of frames begun so far, the current frame is frameCount - 1
+		uint64_t frameCount = 0;
+		std::chrono::high_resolution_clock::time_point tStart;
+		std::chrono::high_resolution_clock::time_point tFrame;
+
+		inline uint32_t getQueryIndex(uint32_t slot, uint32_t stage, bool end) const {
+			return (slot * maxStages + stage) * 2 + (end ? 1 : 0);
+		}
+
+		inline double getMilliseconds(std::chrono::high_resolution_clock::time_point from, std::chrono::high_resolution_clock::time_point to) const {
+			return std::chrono::duration<double, std::milli>(to - from).count();
+		}
+
+		// Reads the timestamps of the slot's last frame into its history entry
+		void readResults(uint32_t slot) {
+			const uint64_t index = slotFrames[slot];
+			if ((index == UINT64_MAX) || (frameCount - index > historySize)) {
+				return;
+			}
+			Frame &frame = history[index % historySize];
+			if (gpuTimestamps) {
+				// Value and availability of each query, stages that weren't written in the frame aren't available
+				uint64_t results[maxStages * 2 * 2];
+				VkResult result = vkGetQueryPoolResults(device, queryPool, getQueryIndex(slot, 0, false), maxStages * 2, sizeof(results), results, 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+				if (result != VK_NOT_READY) {
+					VK_CHECK_RESULT(result);
+				}
+				uint64_t first = UINT64_MAX;
+				for (uint32_t stage = 0; stage < maxStages; stage++) {
+					if ((results[stage * 4 + 1] != 0) && (results[stage * 4 + 3] != 0)) {
+						first = std::min(first, results[stage * 4] & timestampMask);
+					}
+				}
+				for (uint32_t stage = 0; stage < maxStages; stage++) {
+					if ((results[stage * 4 + 1] != 0) && (results[stage * 4 + 3] != 0)) {
+						const uint64_t begin = results[stage * 4] & timestampMask;
+						const uint64_t end = results[stage * 4 + 2] & timestampMask;
+						frame.gpu[stage].start = (double)(begin - first) * timestampPeriod / 1000000.0;
+						frame.gpu[stage].time = (double)(end - begin) * timestampPeriod / 1000000.0;
+					}
+				}
+			}
+			frame.complete = true;
+		}
+
+	public:
+		/*
+			Creates the query pool for the given number of frame slots (if the graphics queue supports timestamps)
+		*/
+		void prepare(vks::VulkanDevice *vulkanDevice, uint32_t slotCount) {
+			device = vulkanDevice->logicalDevice;
+			this->slotCount = slotCount;
+			slotFrames.assign(slotCount, UINT64_MAX);
+			history.assign(historySize, Frame());
+			frameCount = 0;
+			tStart = std::chrono::high_resolution_clock::now();
+
+			const uint32_t validBits = vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits;
+			gpuTimestamps = (validBits > 0);
+			if (!gpuTimestamps) {
+				return;
+			}
+			timestampMask = (validBits >= 64) ? UINT64_MAX : ((1ULL << validBits) - 1);
+			timestampPeriod = vulkanDevice->properties.limits.timestampPeriod;
+
+			VkQueryPoolCreateInfo queryPoolInfo = {};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = slotCount * maxStages * 2;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool));
+
+			commandPool = vulkanDevice->createCommandPool(vulkanDevice->queueFamilyIndices.graphics);
+			resetCommandBuffers.resize(slotCount);
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, slotCount);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, resetCommandBuffers.data()));
+			for (uint32_t slot = 0; slot < slotCount; slot++) {
+				VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+				VK_CHECK_RESULT(vkBeginCommandBuffer(resetCommandBuffers[slot], &cmdBufInfo));
+				vkCmdResetQueryPool(resetCommandBuffers[slot], queryPool, getQueryIndex(slot, 0, false), maxStages * 2);
+				VK_CHECK_RESULT(vkEndCommandBuffer(resetCommandBuffers[slot]));
+			}
+			timestampCommandBuffers.assign(slotCount * maxStages * 2, VK_NULL_HANDLE);
+		}
+
+		void destroy() {
+			if (commandPool != VK_NULL_HANDLE) {
+				vkDestroyCommandPool(device, commandPool, nullptr);
+				commandPool = VK_NULL_HANDLE;
+			}
+			if (queryPool != VK_NULL_HANDLE) {
+				vkDestroyQueryPool(device, queryPool, nullptr);
+				queryPool = VK_NULL_HANDLE;
+			}
+		}
+
+		// Returns the index of a new stage
+		uint32_t addStage(const std::string &name) {
+			assert(stageNames.size() < maxStages);
+			stageNames.push_back(name);
+			return static_cast<uint32_t>(stageNames.size() - 1);
+		}
+
+		/*
+			Starts a new frame in the given slot, the slot's previous frame must have finished on the GPU
+			Reads back the timestamps of the previous frame and submits the reset of the slot's queries
+		*/
+		void beginFrame(VkQueue queue, uint32_t slot) {
+			readResults(slot);
+			tFrame = std::chrono::high_resolution_clock::now();
+			Frame &frame = history[frameCount % historySize];
+			frame = Frame();
+			frame.index = frameCount;
+			frame.begin = getMilliseconds(tStart, tFrame);
+			slotFrames[slot] = frameCount;
+			frameCount++;
+			if (gpuTimestamps) {
+				VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+				submitInfo.commandBufferCount = 1;
+				submitInfo.pCommandBuffers = &resetCommandBuffers[slot];
+				VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+			}
+		}
+
+		void addCpuTime(uint32_t stage, std::chrono::high_resolution_clock::time_point from, std::chrono::high_resolution_clock::time_point to) {
+			if (frameCount == 0) {
+				return;
+			}
+			Timing &timing = history[(frameCount - 1) % historySize].cpu[stage];
+			if (timing.time < 0.0) {
+				timing.start = getMilliseconds(tFrame, from);
+				timing.time = 0.0;
+			}
+			timing.time += getMilliseconds(from, to);
+		}
+
+		/*
+			Records a timestamp at the begin or the end of a stage into a command buffer of the given slot
+			The command buffer must be submitted after the slot's beginFrame (re-submitting it in later frames of the
+			same slot is fine)
+		*/
+		void writeTimestamp(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t stage, bool end) {
+			if (gpuTimestamps) {
+				vkCmdWriteTimestamp(commandBuffer, end ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, getQueryIndex(slot, stage, end));
+			}
+		}
+
+		/*
+			Returns a command buffer that only writes a timestamp at the begin or the end of a stage, for bracketing
+			command buffers that aren't recorded per slot (VK_NULL_HANDLE if timestamps aren't supported)
+		*/
+		VkCommandBuffer getTimestampCommandBuffer(uint32_t slot, uint32_t stage, bool end) {
+			if (!gpuTimestamps) {
+				return VK_NULL_HANDLE;
+			}
+			VkCommandBuffer &commandBuffer = timestampCommandBuffers[getQueryIndex(slot, stage, end)];
+			if (commandBuffer == VK_NULL_HANDLE) {
+				VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &commandBuffer));
+				VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+				VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+				writeTimestamp(commandBuffer, slot, stage, end);
+				VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+			}
+			return commandBuffer;
+		}
+
+		// Calls func for every complete frame of the history, oldest first
+		template <typename F>
+		void forEachFrame(F func) const {
+			for (uint64_t index = (frameCount > historySize) ? frameCount - historySize : 0; index < frameCount; index++) {
+				const Frame &frame = history[index % historySize];
+				if (frame.complete) {
+					func(frame);
+				}
+			}
+		}
+
+		// Average CPU or GPU time of a stage over the frames of the history it was measured in (negative if none)
+		double getAverage(uint32_t stage, bool gpu) const {
+			double sum = 0.0;
+			uint32_t count = 0;
+			forEachFrame([&](const Frame &frame) {
+				const Timing &timing = gpu ? frame.gpu[stage] : frame.cpu[stage];
+				if (timing.time >= 0.0) {
+					sum += timing.time;
+					count++;
+				}
+			});
+			return (count > 0) ? sum / count : -1.0;
+		}
+
+		// Writes the stage timings of the history, one line per frame and measured stage
+		bool saveCsv(const std::string &filename) const {
+			std::ofstream result(filename, std::ios::out);
+			if (!result.is_open()) {
+				return false;
+			}
+			result << std::fixed << std::setprecision(4);
+			result << "frame,stage,cpu start(ms),cpu(ms),gpu start(ms),gpu(ms)" << std::endl;
+			forEachFrame([&](const Frame &frame) {
+				for (uint32_t stage = 0; stage < stageNames.size(); stage++) {
+					const Timing &cpu = frame.cpu[stage];
+					const Timing &gpu = frame.gpu[stage];
+					if ((cpu.time < 0.0) && (gpu.time < 0.0)) {
+						continue;
+					}
+					result << frame.index << "," << stageNames[stage] << ",";
+					if (cpu.time >= 0.0) {
+						result << cpu.start << "," << cpu.time;
+					}
+					else {
+						result << ",";
+					}
+					result << ",";
+					if (gpu.time >= 0.0) {
+						result << gpu.start << "," << gpu.time;
+					}
+					else {
+						result << ",";
+					}
+					result << std::endl;
+				}
+			});
+			return true;
+		}
+
+		/*
+			Writes the stage timings of the history in the Chrome trace event format (chrome://tracing), CPU and GPU
+			stages are shown as separate threads
+			The GPU clock isn't related to the CPU clock, GPU stages are placed relative to the start of their frame
+			on the CPU, so only their durations and their order within a frame are meaningful
+		*/
+		bool saveTrace(const std::string &filename) const {
+			std::ofstream result(filename, std::ios::out);
+			if (!result.is_open()) {
+				return false;
+			}
+			result << std::fixed << std::setprecision(3);
+			result << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+			result << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}}," << std::endl;
+			result << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+			forEachFrame([&](const Frame &frame) {
+				for (uint32_t stage = 0; stage < stageNames.size(); stage++) {
+					const Timing timings[2] = { frame.cpu[stage], frame.gpu[stage] };
+					for (uint32_t tid = 0; tid < 2; tid++) {
+						if (timings[tid].time < 0.0) {
+							continue;
+						}
+						result << "," << std::endl;
+						result << "{\"name\":\"" << stageNames[stage] << "\",\"cat\":\"" << (tid == 0 ? "cpu" : "gpu") << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid;
+						result << ",\"ts\":" << (frame.begin + timings[tid].start) * 1000.0 << ",\"dur\":" << timings[tid].time * 1000.0;
+						result << ",\"args\":{\"frame\":" << frame.index << "}}";
+					}
+				}
+			});
+			result << std::endl << "]}" << std::endl;
+			return true;
+		}
+	};
+}
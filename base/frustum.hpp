@@ -8,8 +8,21 @@
 
 #include <array>
 #include <math.h>
+#include <string.h>
+#include <stdint.h>
 #include <glm/glm.hpp>
 
+// Batched tests use the widest instruction set enabled at compile time, with a scalar fallback
+#if defined(__AVX__)
+#include <immintrin.h>
+#define VKS_FRUSTUM_SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define VKS_FRUSTUM_SIMD_WIDTH 4
+#else
+#define VKS_FRUSTUM_SIMD_WIDTH 1
+#endif
+
 namespace vks
 {
 	class Frustum
@@ -111,5 +124,133 @@ namespace vks
 			return ret;
 		}
 
+		/*
+			Batched box test for boxes stored as structure of arrays (centers and half extents)
+			Sets bit i of visible (one bit per box, (count + 63) / 64 words) if box i is at least partially inside,
+			the same result as (checkBox(center, extent) & 1)
+			Returns the number of visible boxes
+		*/
+		uint32_t checkBoxes(const float *centerX, const float *centerY, const float *centerZ, const float *extentX, const float *extentY, const float *extentZ, uint32_t count, uint64_t *visible) const {
+			memset(visible, 0, ((count + 63) / 64) * sizeof(uint64_t));
+			uint32_t visibleCount = 0;
+			uint32_t i = 0;
+#if VKS_FRUSTUM_SIMD_WIDTH > 1
+			// Box corners farthest along the plane normals, the extents are negated (exactly) for negative normal components
+			for (; i + VKS_FRUSTUM_SIMD_WIDTH <= count; i += VKS_FRUSTUM_SIMD_WIDTH) {
+#if VKS_FRUSTUM_SIMD_WIDTH == 8
+				const __m256 cx = _mm256_loadu_ps(centerX + i), cy = _mm256_loadu_ps(centerY + i), cz = _mm256_loadu_ps(centerZ + i);
+				const __m256 ex = _mm256_loadu_ps(extentX + i), ey = _mm256_loadu_ps(extentY + i), ez = _mm256_loadu_ps(extentZ + i);
+				const __m256 signBit = _mm256_set1_ps(-0.0f);
+				const __m256 threshold = _mm256_set1_ps(-0.02f);
+				__m256 outside = _mm256_setzero_ps();
+				for (uint32_t p = 0; p < 6; p++) {
+					const glm::vec4 &plane = planes[p];
+					const __m256 px = _mm256_add_ps(cx, (plane.x >= 0.0f) ? ex : _mm256_xor_ps(ex, signBit));
+					const __m256 py = _mm256_add_ps(cy, (plane.y >= 0.0f) ? ey : _mm256_xor_ps(ey, signBit));
+					const __m256 pz = _mm256_add_ps(cz, (plane.z >= 0.0f) ? ez : _mm256_xor_ps(ez, signBit));
+					__m256 dist = _mm256_add_ps(_mm256_mul_ps(px, _mm256_set1_ps(plane.x)), _mm256_mul_ps(py, _mm256_set1_ps(plane.y)));
+					dist = _mm256_add_ps(_mm256_add_ps(dist, _mm256_mul_ps(pz, _mm256_set1_ps(plane.z))), _mm256_set1_ps(plane.w));
+					outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, threshold, _CMP_LT_OQ));
+				}
+				const uint32_t mask = ~(uint32_t)_mm256_movemask_ps(outside) & 0xff;
+#else
+				const __m128 cx = _mm_loadu_ps(centerX + i), cy = _mm_loadu_ps(centerY + i), cz = _mm_loadu_ps(centerZ + i);
+				const __m128 ex = _mm_loadu_ps(extentX + i), ey = _mm_loadu_ps(extentY + i), ez = _mm_loadu_ps(extentZ + i);
+				const __m128 signBit = _mm_set1_ps(-0.0f);
+				const __m128 threshold = _mm_set1_ps(-0.02f);
+				__m128 outside = _mm_setzero_ps();
+				for (uint32_t p = 0; p < 6; p++) {
+					const glm::vec4 &plane = planes[p];
+					const __m128 px = _mm_add_ps(cx, (plane.x >= 0.0f) ? ex : _mm_xor_ps(ex, signBit));
+					const __m128 py = _mm_add_ps(cy, (plane.y >= 0.0f) ? ey : _mm_xor_ps(ey, signBit));
+					const __m128 pz = _mm_add_ps(cz, (plane.z >= 0.0f) ? ez : _mm_xor_ps(ez, signBit));
+					__m128 dist = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(plane.x)), _mm_mul_ps(py, _mm_set1_ps(plane.y)));
+					dist = _mm_add_ps(_mm_add_ps(dist, _mm_mul_ps(pz, _mm_set1_ps(plane.z))), _mm_set1_ps(plane.w));
+					outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, threshold));
+				}
+				const uint32_t mask = ~(uint32_t)_mm_movemask_ps(outside) & 0xf;
+#endif
+				visible[i / 64] |= (uint64_t)mask << (i % 64);
+				visibleCount += bitCount(mask);
+			}
+#endif
+			for (; i < count; i++) {
+				bool inside = true;
+				for (uint32_t p = 0; p < 6; p++) {
+					const glm::vec4 &plane = planes[p];
+					const float px = centerX[i] + ((plane.x >= 0.0f) ? extentX[i] : -extentX[i]);
+					const float py = centerY[i] + ((plane.y >= 0.0f) ? extentY[i] : -extentY[i]);
+					const float pz = centerZ[i] + ((plane.z >= 0.0f) ? extentZ[i] : -extentZ[i]);
+					inside &= (px * plane.x + py * plane.y + pz * plane.z + plane.w >= -0.02f);
+				}
+				if (inside) {
+					visible[i / 64] |= 1ULL << (i % 64);
+					visibleCount++;
+				}
+			}
+			return visibleCount;
+		}
+
+		/*
+			Batched sphere test for spheres stored as structure of arrays
+			Sets bit i of visible (one bit per sphere, (count + 63) / 64 words) if checkSphere returns true for sphere i
+			Returns the number of visible spheres
+		*/
+		uint32_t checkSpheres(const float *centerX, const float *centerY, const float *centerZ, const float *radius, uint32_t count, uint64_t *visible) const {
+			memset(visible, 0, ((count + 63) / 64) * sizeof(uint64_t));
+			uint32_t visibleCount = 0;
+			uint32_t i = 0;
+#if VKS_FRUSTUM_SIMD_WIDTH > 1
+			for (; i + VKS_FRUSTUM_SIMD_WIDTH <= count; i += VKS_FRUSTUM_SIMD_WIDTH) {
+#if VKS_FRUSTUM_SIMD_WIDTH == 8
+				const __m256 cx = _mm256_loadu_ps(centerX + i), cy = _mm256_loadu_ps(centerY + i), cz = _mm256_loadu_ps(centerZ + i);
+				const __m256 threshold = _mm256_xor_ps(_mm256_loadu_ps(radius + i), _mm256_set1_ps(-0.0f));
+				__m256 outside = _mm256_setzero_ps();
+				for (uint32_t p = 0; p < 6; p++) {
+					const glm::vec4 &plane = planes[p];
+					__m256 dist = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), cx), _mm256_mul_ps(_mm256_set1_ps(plane.y), cy));
+					dist = _mm256_add_ps(_mm256_add_ps(dist, _mm256_mul_ps(_mm256_set1_ps(plane.z), cz)), _mm256_set1_ps(plane.w));
+					outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, threshold, _CMP_LE_OQ));
+				}
+				const uint32_t mask = ~(uint32_t)_mm256_movemask_ps(outside) & 0xff;
+#else
+				const __m128 cx = _mm_loadu_ps(centerX + i), cy = _mm_loadu_ps(centerY + i), cz = _mm_loadu_ps(centerZ + i);
+				const __m128 threshold = _mm_xor_ps(_mm_loadu_ps(radius + i), _mm_set1_ps(-0.0f));
+				__m128 outside = _mm_setzero_ps();
+				for (uint32_t p = 0; p < 6; p++) {
+					const glm::vec4 &plane = planes[p];
+					__m128 dist = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), cx), _mm_mul_ps(_mm_set1_ps(plane.y), cy));
+					dist = _mm_add_ps(_mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(plane.z), cz)), _mm_set1_ps(plane.w));
+					outside = _mm_or_ps(outside, _mm_cmple_ps(dist, threshold));
+				}
+				const uint32_t mask = ~(uint32_t)_mm_movemask_ps(outside) & 0xf;
+#endif
+				visible[i / 64] |= (uint64_t)mask << (i % 64);
+				visibleCount += bitCount(mask);
+			}
+#endif
+			for (; i < count; i++) {
+				bool inside = true;
+				for (uint32_t p = 0; p < 6; p++) {
+					const glm::vec4 &plane = planes[p];
+					inside &= ((plane.x * centerX[i]) + (plane.y * centerY[i]) + (plane.z * centerZ[i]) + plane.w > -radius[i]);
+				}
+				if (inside) {
+					visible[i / 64] |= 1ULL << (i % 64);
+					visibleCount++;
+				}
+			}
+			return visibleCount;
+		}
+
+	private:
+		static inline uint32_t bitCount(uint32_t mask) {
+			uint32_t count = 0;
+			for (; mask != 0; mask &= mask - 1) {
+				count++;
+			}
+			return count;
+		}
+
 	};
 }
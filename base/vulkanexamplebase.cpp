@@ -187,6 +187,8 @@ void VulkanExampleBase::prepare()
 	setupRenderPass();
 	createPipelineCache();
 	setupFrameBuffer();
+	profiler.prepare(vulkanDevice, maxFramesInFlight);
+	textOverlayStage = profiler.addStage("text overlay");
 	enableTextOverlay = enableTextOverlay && (!benchmark.active);
 	if (enableTextOverlay)
 	{
@@ -202,7 +204,8 @@ void VulkanExampleBase::prepare()
 			depthFormat,
 			&width,
 			&height,
-			shaderStages
+			shaderStages,
+			maxFramesInFlight
 			);
 		updateTextOverlay();
 	}
@@ -273,7 +276,12 @@ void VulkanExampleBase::renderLoop()
 	if (benchmark.active) {
 		benchmark.run([=] { render(); });
 		vkDeviceWaitIdle(device);
+		getBenchmarkCounters(benchmark);
 		benchmark.saveResults(title, deviceProperties.deviceName);
+		// Stage timings of the last frames next to the results
+		const std::string stageFilename = benchmark.filename.substr(0, benchmark.filename.find_last_of('.'));
+		profiler.saveCsv(stageFilename + "_stages.csv");
+		profiler.saveTrace(stageFilename + "_trace.json");
 		return;
 	}
 
@@ -550,6 +558,8 @@ void VulkanExampleBase::updateTextOverlay()
 	if (!enableTextOverlay)
 		return;
 
+	vks::FrameProfiler::CpuScope profilerScope(profiler, textOverlayStage);
+
 	textOverlay->beginTextUpdate();
 
 	textOverlay->addText(title, 5.0f, 5.0f, VulkanTextOverlay::alignLeft);
@@ -571,8 +581,17 @@ void VulkanExampleBase::updateTextOverlay()
 
 void VulkanExampleBase::getOverlayText(VulkanTextOverlay*) {}
 
+void VulkanExampleBase::getBenchmarkCounters(vks::Benchmark&) {}
+
 void VulkanExampleBase::prepareFrame()
 {
+	// The slot's semaphores and everything recorded for the slot may still be in use by its previous frame
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &frameSync[currentFrame].fence, VK_TRUE, UINT64_MAX));
+	profiler.beginFrame(queue, currentFrame);
+	semaphores.presentComplete = frameSync[currentFrame].presentComplete;
+	semaphores.renderComplete = frameSync[currentFrame].renderComplete;
+	semaphores.textOverlayComplete = frameSync[currentFrame].textOverlayComplete;
+
 	// Acquire the next image from the swap chain
 	VkResult err = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
@@ -590,6 +609,9 @@ void VulkanExampleBase::submitFrame()
 
 	if (submitTextOverlay)
 	{
+		// prepareFrame has waited for the slot's previous frame, so the slot's overlay buffers can be rewritten
+		textOverlay->updateFrame(currentFrame, currentBuffer);
+
 		// Wait for color attachment output to finish before rendering the text overlay
 		VkPipelineStageFlags stageFlags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		submitInfo.pWaitDstStageMask = &stageFlags;
@@ -602,9 +624,20 @@ void VulkanExampleBase::submitFrame()
 		submitInfo.signalSemaphoreCount = 1;
 		submitInfo.pSignalSemaphores = &semaphores.textOverlayComplete;
 
-		// Submit current text overlay command buffer
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &textOverlay->cmdBuffers[currentBuffer];
+		// Submit current text overlay command buffer, bracketed by the profiler's timestamps
+		std::array<VkCommandBuffer, 3> commandBuffers = {
+			profiler.getTimestampCommandBuffer(currentFrame, textOverlayStage, false),
+			textOverlay->cmdBuffers[currentFrame],
+			profiler.getTimestampCommandBuffer(currentFrame, textOverlayStage, true)
+		};
+		if (profiler.gpuTimestamps) {
+			submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+			submitInfo.pCommandBuffers = commandBuffers.data();
+		}
+		else {
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &textOverlay->cmdBuffers[currentFrame];
+		}
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		// Reset stage mask
@@ -618,9 +651,22 @@ void VulkanExampleBase::submitFrame()
 		submitInfo.pSignalSemaphores = &semaphores.renderComplete;
 	}
 
+	// Signaled once all work submitted so far (this frame's and all earlier frames') has finished
+	VK_CHECK_RESULT(vkResetFences(device, 1, &frameSync[currentFrame].fence));
+	VK_CHECK_RESULT(vkQueueSubmit(queue, 0, nullptr, frameSync[currentFrame].fence));
+
 	VK_CHECK_RESULT(swapChain.queuePresent(queue, currentBuffer, submitTextOverlay ? semaphores.textOverlayComplete : semaphores.renderComplete));
 
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	currentFrame = (currentFrame + 1) % maxFramesInFlight;
+}
+
+void VulkanExampleBase::waitForFrames()
+{
+	std::array<VkFence, maxFramesInFlight> fences;
+	for (uint32_t i = 0; i < maxFramesInFlight; i++) {
+		fences[i] = frameSync[i].fence;
+	}
+	VK_CHECK_RESULT(vkWaitForFences(device, maxFramesInFlight, fences.data(), VK_TRUE, UINT64_MAX));
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
@@ -666,12 +712,12 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 		}
 		if ((args[i] == std::string("-b")) || (args[i] == std::string("-benchmark"))) {
 			benchmark.active = true;
-			// Result file name can be overriden
-			if (args.size() > i + 1) {
+			// Result file name can be overriden (other arguments may follow)
+			if ((args.size() > i + 1) && (args[i + 1][0] != '-')) {
 				benchmark.filename = args[i + 1];
 			}
 			// Number of iterations as optional parameter
-			if (args.size() > i + 2) {
+			if ((args.size() > i + 2) && (args[i + 1][0] != '-')) {
 				char* endptr;
 				uint32_t iterations = strtol(args[i + 2], &endptr, 10);
 				if (endptr != args[i + 2]) { benchmark.iterationCount = iterations; };
@@ -728,15 +774,20 @@ VulkanExampleBase::~VulkanExampleBase()
 
 	vkDestroyCommandPool(device, cmdPool, nullptr);
 
-	vkDestroySemaphore(device, semaphores.presentComplete, nullptr);
-	vkDestroySemaphore(device, semaphores.renderComplete, nullptr);
-	vkDestroySemaphore(device, semaphores.textOverlayComplete, nullptr);
+	for (auto &sync : frameSync) {
+		vkDestroySemaphore(device, sync.presentComplete, nullptr);
+		vkDestroySemaphore(device, sync.renderComplete, nullptr);
+		vkDestroySemaphore(device, sync.textOverlayComplete, nullptr);
+		vkDestroyFence(device, sync.fence, nullptr);
+	}
 
 	if (enableTextOverlay)
 	{
 		delete textOverlay;
 	}
 
+	profiler.destroy();
+
 	delete vulkanDevice;
 
 	if (settings.validation)
@@ -889,18 +940,26 @@ void VulkanExampleBase::initVulkan()
 
 	swapChain.connect(instance, physicalDevice, device);
 
-	// Create synchronization objects
+	// Create synchronization objects, one set per frame slot
 	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-	// Create a semaphore used to synchronize image presentation
-	// Ensures that the image is displayed before we start submitting new commands to the queu
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.presentComplete));
-	// Create a semaphore used to synchronize command submission
-	// Ensures that the image is not presented until all commands have been sumbitted and executed
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.renderComplete));
-	// Create a semaphore used to synchronize command submission
-	// Ensures that the image is not presented until all commands for the text overlay have been sumbitted and executed
-	// Will be inserted after the render complete semaphore if the text overlay is enabled
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.textOverlayComplete));
+	// Signaled, so waiting for a slot that hasn't been used yet returns immediately
+	VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+	for (auto &sync : frameSync) {
+		// Create a semaphore used to synchronize image presentation
+		// Ensures that the image is displayed before we start submitting new commands to the queu
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &sync.presentComplete));
+		// Create a semaphore used to synchronize command submission
+		// Ensures that the image is not presented until all commands have been sumbitted and executed
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &sync.renderComplete));
+		// Create a semaphore used to synchronize command submission
+		// Ensures that the image is not presented until all commands for the text overlay have been sumbitted and executed
+		// Will be inserted after the render complete semaphore if the text overlay is enabled
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &sync.textOverlayComplete));
+		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &sync.fence));
+	}
+	semaphores.presentComplete = frameSync[0].presentComplete;
+	semaphores.renderComplete = frameSync[0].renderComplete;
+	semaphores.textOverlayComplete = frameSync[0].textOverlayComplete;
 
 	// Set up submit info structure
 	// Semaphores will stay the same during application lifetime
@@ -2028,10 +2087,11 @@ void VulkanExampleBase::setupRenderPass()
 
 	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 	dependencies[0].dstSubpass = 0;
-	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	// The depth attachment is shared by all frames in flight, so the depth clear and writes also wait for the previous frame's depth writes
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 	dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 	dependencies[1].srcSubpass = 0;
@@ -51,6 +51,7 @@
 #include "VulkanTextOverlay.hpp"
 #include "camera.hpp"
 #include "benchmark.hpp"
+#include "frameprofiler.hpp"
 
 class VulkanExampleBase
 {
@@ -65,7 +66,6 @@ private:
 	uint32_t destWidth;
 	uint32_t destHeight;
 	bool resizing = false;
-	vks::Benchmark benchmark;
 	// Called if the window is resized and some resources have to be recreatesd
 	void windowResize();
 protected:
@@ -128,7 +128,25 @@ protected:
 		// Text overlay submission and execution
 		VkSemaphore textOverlayComplete;
 	} semaphores;
+public:
+	/*
+		Number of frames the CPU may record and submit while the GPU is still working on earlier ones
+		Resources the host writes or records every frame need one copy per frame slot (indexed by currentFrame), a
+		slot's copy is free to change once prepareFrame has waited for the slot's previous frame
+	*/
+	static const uint32_t maxFramesInFlight = 2;
+protected:
+	// Synchronization objects of a frame slot, the fence is signaled once all submissions of the slot's frame have finished
+	struct FrameSync {
+		VkSemaphore presentComplete;
+		VkSemaphore renderComplete;
+		VkSemaphore textOverlayComplete;
+		VkFence fence;
+	};
+	std::array<FrameSync, maxFramesInFlight> frameSync;
 public: 
+	// Frame slot of the frame being prepared
+	uint32_t currentFrame = 0;
 	bool prepared = false;
 	uint32_t width = 1280;
 	uint32_t height = 720;
@@ -168,6 +186,13 @@ public:
 	bool enableTextOverlay = false;
 	VulkanTextOverlay *textOverlay;
 
+	/** @brief Benchmark run (enabled via "-benchmark"), examples can e.g. adjust the number of frames per iteration */
+	vks::Benchmark benchmark;
+
+	/** @brief CPU and GPU timings of the stages of the last frames, examples can add their own stages */
+	vks::FrameProfiler profiler;
+	uint32_t textOverlayStage;
+
 	// Use to adjust mouse rotation speed
 	float rotationSpeed = 1.0f;
 	// Use to adjust mouse zoom speed
@@ -391,15 +416,23 @@ public:
 	/** @brief (Virtual) Called when the text overlay is updating, can be used to add custom text to the overlay */
 	virtual void getOverlayText(VulkanTextOverlay*);
 
+	/** @brief (Virtual) Called after a benchmark run before the results are saved, can be used to add custom counters to the results */
+	virtual void getBenchmarkCounters(vks::Benchmark &benchmark);
+
 	// Prepare the frame for workload submission
+	// - Waits until the previous frame of the current frame slot has finished on the GPU
 	// - Acquires the next image from the swap chain 
 	// - Sets the default wait and signal semaphores
 	void prepareFrame();
 
 	// Submit the frames' workload 
 	// - Submits the text overlay (if enabled)
+	// - Signals the frame slot's fence and advances to the next slot
 	void submitFrame();
 
+	// Wait until all frames in flight have finished on the GPU
+	void waitForFrames();
+
 };
 
 // OS specific macros for the example main entry points
@@ -12,6 +12,11 @@ Player::Player()
 {
 	freeLookDelta = glm::vec2(0.0f);
 	freeLookRotation = glm::vec3(0.0f);
+	freeLook = false;
+	// Not turning
+	rotationDir = 0.0f;
+	animRotation = 0.0f;
+	targetRotation = 0.0f;
 }
 
 
@@ -43,16 +48,21 @@ void Player::setRotation(glm::vec3 rotation)
 	updateViewMatrix();
 }
 
-void Player::setDungeon(dungeongenerator::Dungeon *dungeon)
+void Player::setCellAccessor(dungeongenerator::CellAccessor *cells)
 {
-	this->dungeon = dungeon;
+	this->cells = cells;
+}
+
+glm::ivec2 Player::getTargetCell(glm::vec3 dirVec) {
+	glm::vec3 movementVector = glm::rotate(dirVec, glm::radians(rotation.y), glm::vec3(0.0, 1.0f, 0.0f));
+	return glm::ivec2(round(position.x + movementVector.x), round(position.z - movementVector.z));
 }
 
 bool Player::move(glm::vec3 dirVec, bool animate) {
 	glm::vec3 movementVector = dirVec;
 	movementVector = glm::rotate(movementVector, glm::radians(rotation.y), glm::vec3(0.0, 1.0f, 0.0f));
-	dungeongenerator::Cell *targetCell = dungeon->getCell(round(position.x + movementVector.x), round(position.z - movementVector.z));
-	if (targetCell->type == dungeongenerator::Cell::cellTypeEmpty) {
+	glm::ivec2 targetCell = getTargetCell(dirVec);
+	if (cells->getCellType(targetCell.x, targetCell.y) == dungeongenerator::Cell::cellTypeEmpty) {
 		// TODO : Blocking animation
 		return false;
 	}
@@ -63,7 +73,6 @@ bool Player::move(glm::vec3 dirVec, bool animate) {
 		updateViewMatrix();
 	}
 	else {
-		dungeongenerator::Cell *targetCell = dungeon->getCell(round(position.x + movementVector.x), round(position.z - movementVector.z));
 		double distance = glm::distance(position, targetPosition);
 		if (distance == 0.0f) {
 			targetPosition.x = position.x + movementVector.x;
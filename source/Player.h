@@ -13,13 +13,13 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/rotate_vector.hpp>
-#include "generator\Dungeon.h"
+#include "generator/CellAccessor.h"
 
 class Player
 {
 private:
 	glm::vec2 freeLookDelta;
-	dungeongenerator::Dungeon *dungeon;
+	dungeongenerator::CellAccessor *cells = nullptr;
 	float rotationDir;
 	float animRotation;
 	float targetRotation;
@@ -50,7 +50,10 @@ public:
 	void setPosition(glm::vec3 position);
 	void setRotation(glm::vec3 rotation);
 
-	void setDungeon(dungeongenerator::Dungeon *dungeon);
+	// Cells used for collision checks (a single dungeon or a chunked world)
+	void setCellAccessor(dungeongenerator::CellAccessor *cells);
+	// Returns the grid cell reached when moving into the given direction (relative to the player's rotation)
+	glm::ivec2 getTargetCell(glm::vec3 dirVec);
 	bool move(glm::vec3 dirVec, bool animate);
 	void rotate(float dir, bool animate);
 	bool update(float timeFactor);
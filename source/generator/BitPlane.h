@@ -0,0 +1,159 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace dungeongenerator {
+
+	/*
+		Helpers for storing one row of the cell grid as bit planes (one bit per cell, 64 cells per word)
+		Bit i of word k stands for cell x = k * 64 + i, bits beyond the row's width are always zero
+		Conversion between byte and bit rows is done eight cells at a time (assumes a little endian host)
+	*/
+	class BitPlane
+	{
+	private:
+		static const uint64_t lowBits = 0x0101010101010101ULL;
+
+		// Packs bit 0 of eight bytes into the eight low bits of the result
+		static inline uint64_t packLowBits(uint64_t v) {
+			return ((v & lowBits) * 0x0102040810204080ULL) >> 56;
+		}
+
+		// Inverse of packLowBits, bit i of the low byte of v ends up in bit 0 of byte i
+		static inline uint64_t spreadLowBits(uint64_t v) {
+			// Replicate the byte, keep bit i in byte i and move it down to bit 0
+			const uint64_t bits = ((v & 0xff) * lowBits) & 0x8040201008040201ULL;
+			return ((bits + 0x7f7f7f7f7f7f7f7fULL) >> 7) & lowBits;
+		}
+
+	public:
+		static inline uint32_t getWordCount(int width) { return ((uint32_t)width + 63) / 64; }
+
+		/*
+			Packs a row of cell types into planes for occupied (non-empty) cells, corridors and rooms
+			Uses the bits of the type values (empty = 0, corridor = 1, room = 2)
+		*/
+		static void packTypes(const uint8_t *types, int width, uint64_t *occupied, uint64_t *corridors, uint64_t *rooms) {
+			const uint32_t wordCount = getWordCount(width);
+			for (uint32_t k = 0; k < wordCount; k++) {
+				const int first = k * 64;
+				const int count = (width - first < 64) ? width - first : 64;
+				uint64_t corridorWord = 0;
+				uint64_t roomWord = 0;
+				int i = 0;
+				for (; i + 8 <= count; i += 8) {
+					uint64_t v;
+					memcpy(&v, types + first + i, sizeof(v));
+					corridorWord |= packLowBits(v) << i;
+					roomWord |= packLowBits(v >> 1) << i;
+				}
+				for (; i < count; i++) {
+					corridorWord |= (uint64_t)(types[first + i] & 1) << i;
+					roomWord |= (uint64_t)((types[first + i] >> 1) & 1) << i;
+				}
+				occupied[k] = corridorWord | roomWord;
+				corridors[k] = corridorWord;
+				rooms[k] = roomWord;
+			}
+		}
+
+		// Packs bit n of a row of bytes into a plane (e.g. one direction of the wall masks)
+		static void packBit(const uint8_t *bytes, int width, uint32_t n, uint64_t *plane) {
+			const uint32_t wordCount = getWordCount(width);
+			for (uint32_t k = 0; k < wordCount; k++) {
+				const int first = k * 64;
+				const int count = (width - first < 64) ? width - first : 64;
+				uint64_t word = 0;
+				int i = 0;
+				for (; i + 8 <= count; i += 8) {
+					uint64_t v;
+					memcpy(&v, bytes + first + i, sizeof(v));
+					word |= packLowBits(v >> n) << i;
+				}
+				for (; i < count; i++) {
+					word |= (uint64_t)((bytes[first + i] >> n) & 1) << i;
+				}
+				plane[k] = word;
+			}
+		}
+
+		/*
+			ORs four planes into a row of bytes, planes[n] sets bit n of the bytes
+			Words without any bits set are skipped
+		*/
+		static void unpackOr(const uint64_t *planes[4], int width, uint8_t *bytes) {
+			const uint32_t wordCount = getWordCount(width);
+			for (uint32_t k = 0; k < wordCount; k++) {
+				if ((planes[0][k] | planes[1][k] | planes[2][k] | planes[3][k]) == 0) {
+					continue;
+				}
+				const int first = k * 64;
+				const int count = (width - first < 64) ? width - first : 64;
+				int i = 0;
+				for (; i + 8 <= count; i += 8) {
+					if ((((planes[0][k] | planes[1][k] | planes[2][k] | planes[3][k]) >> i) & 0xff) == 0) {
+						continue;
+					}
+					const uint64_t bits =
+						spreadLowBits(planes[0][k] >> i) |
+						(spreadLowBits(planes[1][k] >> i) << 1) |
+						(spreadLowBits(planes[2][k] >> i) << 2) |
+						(spreadLowBits(planes[3][k] >> i) << 3);
+					uint64_t v;
+					memcpy(&v, bytes + first + i, sizeof(v));
+					v |= bits;
+					memcpy(bytes + first + i, &v, sizeof(v));
+				}
+				for (; i < count; i++) {
+					for (uint32_t n = 0; n < 4; n++) {
+						bytes[first + i] |= (uint8_t)(((planes[n][k] >> i) & 1) << n);
+					}
+				}
+			}
+		}
+
+		// Index of the lowest set bit, v must not be zero
+		static inline uint32_t getLowestBit(uint64_t v) {
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward64(&index, v);
+			return (uint32_t)index;
+#else
+			return (uint32_t)__builtin_ctzll(v);
+#endif
+		}
+
+		// Number of set bits
+		static inline uint32_t getBitCount(uint64_t v) {
+#if defined(_MSC_VER)
+			return (uint32_t)__popcnt64(v);
+#else
+			return (uint32_t)__builtin_popcountll(v);
+#endif
+		}
+
+		// Value of the western neighbour (x - 1) for every cell of word k, zero for the first cell in the row
+		static inline uint64_t westOf(const uint64_t *plane, uint32_t k) {
+			return (plane[k] << 1) | ((k > 0) ? (plane[k - 1] >> 63) : 0);
+		}
+
+		// Value of the eastern neighbour (x + 1) for every cell of word k, zero for the last cell in the row
+		static inline uint64_t eastOf(const uint64_t *plane, uint32_t k, uint32_t wordCount) {
+			return (plane[k] >> 1) | ((k + 1 < wordCount) ? (plane[k + 1] << 63) : 0);
+		}
+	};
+
+}
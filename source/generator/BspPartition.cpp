@@ -9,160 +9,169 @@
 #include "BspPartition.h"
 #include <vector>
 #include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "threadpool.hpp"
 
 namespace dungeongenerator {
 
-	BspPartition::BspPartition(BspPartition* parent, int left, int top, int right, int bottom, int splitIn, int depth)
+	BspPartition::BspPartition(int32_t parent, int left, int top, int right, int bottom, int splitIn, int depth, Random random)
 	{
 		this->parent = parent;
 		this->left = left;
 		this->right = right;
 		this->top = top;
 		this->bottom = bottom;
-		this->splitIn = splitIn;
-		this->depth = depth;
+		this->splitIn = (uint8_t)splitIn;
+		this->depth = (uint8_t)depth;
+		this->random = random;
+
+		this->centerX = (int32_t)round(left + (float)(right - left) / 2.0f);
+		this->centerY = (int32_t)round(top + (float)(bottom - top) / 2.0f);
+	}
+
+	bool BspTree::split(std::vector<BspPartition> &nodes, int32_t index)
+	{
+		// Note: Nodes are added below, so don't hold a reference to the node across push_back
+		BspPartition partition = nodes[index];
 
-		this->centerX = round(left + (float)(right - left) / 2.0f);
-		this->centerY = round(top + (float)(bottom - top) / 2.0f);
-		
 		// Don't split if any of the dimensions is below certain threshold
-		if ((depth > 0) && ((right - left <= 8) || (bottom - top <= 8))) {
-			return;
+		if ((partition.depth > 0) && ((partition.right - partition.left <= 8) || (partition.bottom - partition.top <= 8))) {
+			return false;
 		}
 
 		// Randomly stop splitting
-		if (splitIn == BspPartitionSplitVertical) {
-			if ((right - left < 4) || (bottom - top < 4)) {
-				if ((rand() % 100 < 25 /*this.dungeon.splitStop*/) && (depth > 0)) {
-					return;
+		if (partition.splitIn == BspPartition::BspPartitionSplitVertical) {
+			if ((partition.right - partition.left < 4) || (partition.bottom - partition.top < 4)) {
+				if ((partition.random.range(100) < 25 /*this.dungeon.splitStop*/) && (partition.depth > 0)) {
+					nodes[index].random = partition.random;
+					return false;
 				}
 			}
 		}
 
+		const int left = partition.left;
+		const int right = partition.right;
+		const int top = partition.top;
+		const int bottom = partition.bottom;
+		const int depth = partition.depth;
+		Random &random = partition.random;
+
 		// Split
 		int splitRangeX = round((float)(right - left) / ((depth == 0) ? 8 : 4));
 		int splitRangeY = round((float)(bottom - top) / ((depth == 0) ? 8 : 4));
 
-		int splitX = round(left + ((right - left) / 2) + round(rand() % splitRangeX) - round(rand() % splitRangeX));
-		int splitY = round(top + ((bottom - top) / 2) + round(rand() % splitRangeY) - round(rand() % splitRangeY));
+		int splitX = round(left + ((right - left) / 2) + random.range(splitRangeX) - random.range(splitRangeX));
+		int splitY = round(top + ((bottom - top) / 2) + random.range(splitRangeY) - random.range(splitRangeY));
 
 		// Add four new child partitions
-		children.push_back(new BspPartition(this, left, top, splitX, splitY, rand() % 2, depth + 1));
-		children.push_back(new BspPartition(this, splitX, top, right, splitY, rand() % 2, depth + 1));
-		children.push_back(new BspPartition(this, left, splitY, splitX, bottom, rand() % 2, depth + 1));
-		children.push_back(new BspPartition(this, splitX, splitY, right, bottom, rand() % 2, depth + 1));
-
-	}
-
-
-	BspPartition::~BspPartition()
-	{
+		partition.firstChild = (int32_t)nodes.size();
+		nodes.push_back(BspPartition(index, left, top, splitX, splitY, random.range(2), depth + 1, random.fork(0)));
+		nodes.push_back(BspPartition(index, splitX, top, right, splitY, random.range(2), depth + 1, random.fork(1)));
+		nodes.push_back(BspPartition(index, left, splitY, splitX, bottom, random.range(2), depth + 1, random.fork(2)));
+		nodes.push_back(BspPartition(index, splitX, splitY, right, bottom, random.range(2), depth + 1, random.fork(3)));
+		nodes[index] = partition;
+
+		return true;
 	}
 
-	void BspPartition::split(bool origin, int maxDivision, int minDivision) 
+	void BspTree::splitRecursive(std::vector<BspPartition> &nodes, int32_t index)
 	{
-
-		// Don't split if any of the dimensions is below certain threshold
-		if ( (right - left <= maxDivision) || (bottom - top <= maxDivision) ) {
-			return;
-		}
-
-		// Randomly stop splitting
-		if (splitIn == BspPartitionSplitVertical) {
-			if ((right - left < minDivision) || (bottom - top < minDivision)) {
-				if ((rand() % 100 < 25 /*this.dungeon.splitStop*/) && (!origin)) {
-					return;
-				}
+		if (split(nodes, index)) {
+			const int32_t firstChild = nodes[index].firstChild;
+			for (int32_t i = 0; i < 4; i++) {
+				splitRecursive(nodes, firstChild + i);
 			}
 		}
-
-		// Split
-		int splitRangeX = round((float)(right - left) / ((origin) ? 8 : 4));
-		int splitRangeY = round((float)(bottom - top) / ((origin) ? 8 : 4));
-
-		int splitX = round(left + ((right - left) / 2) + round(rand() % splitRangeX) - round(rand() % splitRangeX));
-		int splitY = round(top + ((bottom - top) / 2) + round(rand() % splitRangeY) - round(rand() % splitRangeY));
-
-		// Add four new child partitions
-
-		BspPartition child0 = BspPartition(this, left, top, splitX, splitY, rand() % 2, depth + 1);
-		BspPartition child1 = BspPartition(this, splitX, top, right, splitY, rand() % 2, depth + 1);
-		BspPartition child2 = BspPartition(this, left, splitY, splitX, bottom, rand() % 2, depth + 1);
-		BspPartition child3 = BspPartition(this, splitX, splitY, right, bottom, rand() % 2, depth + 1);
-
-		child0.split(false, 12, 24);
-		child1.split(false, 12, 24);
-		child2.split(false, 12, 24);
-		child3.split(false, 12, 24);
-
-		children.push_back(&child0);
-		children.push_back(&child1);
-		children.push_back(&child2);
-		children.push_back(&child3);
-
-		//for (auto child : children) {
-		//	child.split(false, 16, 32);
-		//}
 	}
 
-	void BspPartition::connect()
+	void BspTree::build(int width, int height, Random random, vks::ThreadPool *threadPool)
 	{
-		std::vector<BspPartition*> connectionList;
-
-		// Add child nodes with rooms to connection target list
-		if (!children.empty()) {
-			for (auto child : children) {
-				if (child->hasRoom) {
-					connectionList.push_back(child);
+		clear();
+		nodes.push_back(BspPartition(-1, 0, 0, width, height, BspPartition::BspPartitionSplitHorizontal, 0, random));
+
+		// Split the upper levels until there are enough subtrees
+		std::vector<int32_t> subtrees = { rootIndex };
+		while ((!subtrees.empty()) && (subtrees.size() < subtreeCount)) {
+			std::vector<int32_t> nextLevel;
+			for (auto index : subtrees) {
+				if (split(nodes, index)) {
+					for (int32_t i = 0; i < 4; i++) {
+						nextLevel.push_back(nodes[index].firstChild + i);
+					}
 				}
 			}
+			subtrees.swap(nextLevel);
 		}
 
-		// Add this node (and if set it's parent) to the connection list
-		connectionList.push_back(this);
-		if (parent != NULL) {
-			connectionList.push_back(parent);
+		// Split the remaining subtrees, each one into its own arena
+		if (subtreeNodes.size() < subtrees.size()) {
+			subtreeNodes.resize(subtrees.size());
 		}
-		fprintf(stdout, "%d\n", connectionList.size());
-
-		if (connectionList.size() == 0) {
-			return;
+		for (size_t i = 0; i < subtrees.size(); i++) {
+			std::vector<BspPartition> *subtree = &subtreeNodes[i];
+			subtree->clear();
+			subtree->push_back(nodes[subtrees[i]]);
+			if (threadPool) {
+				threadPool->threads[i % threadPool->threads.size()]->addJob([subtree] { splitRecursive(*subtree, 0); });
+			}
+			else {
+				splitRecursive(*subtree, 0);
+			}
 		}
-
-		// Randomize connection list
-		// TODO : Not the pretiest code...
-		bool skip = false;
-		int index = 0;
-		std::vector<BspPartition*> randomList;
-
-		//do {
-		//	index = rand() %  connectionList.size(); 
-		//	fprintf(stdout, "%d - %d / %d\n", index, randomList.size(), connectionList.size());
-		//	if (std::find(randomList.begin(), randomList.end(), connectionList[index]) == randomList.end()) {
-		//		randomList.push_back(connectionList[index]);
-		//	}
-		//} 
-		//while (randomList.size() != connectionList.size());
-
-		for (int i = 0; i < connectionList.size(); i++) {
-			randomList.push_back(connectionList[i]);
+		if (threadPool) {
+			threadPool->wait();
 		}
 
-		for (auto partition : randomList) {
-
+		// Append the subtrees in a fixed order, so the node layout doesn't depend on the number of threads
+		size_t nodeCount = nodes.size();
+		for (size_t i = 0; i < subtrees.size(); i++) {
+			nodeCount += subtreeNodes[i].size() - 1;
 		}
+		nodes.reserve(nodeCount);
+		for (size_t i = 0; i < subtrees.size(); i++) {
+			const std::vector<BspPartition> &subtree = subtreeNodes[i];
+			const int32_t subtreeRoot = subtrees[i];
+			// Local node 0 is the subtree's root, all other local nodes n are appended at base + n
+			const int32_t base = (int32_t)nodes.size() - 1;
+			auto remap = [subtreeRoot, base](int32_t local) {
+				return (local < 0) ? -1 : ((local == 0) ? subtreeRoot : base + local);
+			};
+			BspPartition root = subtree[0];
+			root.firstChild = remap(root.firstChild);
+			nodes[subtreeRoot] = root;
+			for (size_t n = 1; n < subtree.size(); n++) {
+				BspPartition node = subtree[n];
+				node.parent = remap(node.parent);
+				node.firstChild = remap(node.firstChild);
+				nodes.push_back(node);
+			}
+		}
+	}
 
+	void BspTree::clear()
+	{
+		nodes.clear();
+	}
 
-		//if (randomList.length > 0) {
-		//	for (var i = 0; i < randomList.length - 1; i++) {
-		//		srcX = connectionList[randomList[i]].centerX;
-		//		srcY = connectionList[randomList[i]].centerY;
-		//		dstX = connectionList[randomList[i + 1]].centerX;
-		//		dstY = connectionList[randomList[i + 1]].centerY;
-		//		this.createCorridor(srcX, srcY, dstX, dstY);
-		//	}
-		//}
-
+	void BspTree::getLeaves(std::vector<int32_t> &leaves) const
+	{
+		if (nodes.empty()) {
+			return;
+		}
+		std::vector<int32_t> stack = { rootIndex };
+		while (!stack.empty()) {
+			const int32_t index = stack.back();
+			stack.pop_back();
+			if (nodes[index].isLeaf()) {
+				leaves.push_back(index);
+			}
+			else {
+				for (int32_t i = 3; i >= 0; i--) {
+					stack.push_back(nodes[index].firstChild + i);
+				}
+			}
+		}
 	}
 
 }
@@ -9,32 +9,70 @@
 #pragma once
 
 #include <vector>
+#include <stdint.h>
+#include <stdlib.h>
+#include "Random.h"
+
+namespace vks {
+	class ThreadPool;
+}
 
 namespace dungeongenerator {
 
-	class BspPartition
+	/*
+		Node of the partition tree
+		Nodes live in a flat array owned by the tree (see BspTree) and refer to each other by index
+		The four children of a node are stored next to each other starting at firstChild
+	*/
+	struct BspPartition
 	{
-	public:
-		BspPartition *parent;
-		int left;
-		int right;
-		int top;
-		int bottom;
-		int centerX;
-		int centerY;
-		int splitIn;
-		int depth;
-		bool hasRoom = false;
 		static const int BspPartitionSplitVertical = 0;
 		static const int BspPartitionSplitHorizontal = 0;
-		std::vector<BspPartition*> children;
-		BspPartition(BspPartition *parent, int left, int top, int right, int bottom, int splitIn, int depth);
-		~BspPartition();
-		void placeRoom();
-		void split(bool origin, int maxDivision, int minDivision);
-		void createCorridor(int originX, int originY, int destX, int destY);
-		void connect();
+		int32_t parent;
+		int32_t firstChild = -1;
+		int32_t left;
+		int32_t right;
+		int32_t top;
+		int32_t bottom;
+		int32_t centerX;
+		int32_t centerY;
+		uint8_t splitIn;
+		uint8_t depth;
+		bool hasRoom = false;
+		// Random stream of this partition, children get their own streams forked from it
+		Random random;
+		BspPartition(int32_t parent, int left, int top, int right, int bottom, int splitIn, int depth, Random random);
+		inline bool isLeaf() const { return firstChild < 0; }
 	};
 
-}
+	/*
+		Partition tree with all nodes allocated from one array
+		Clearing the tree releases all nodes at once while keeping the memory for the next dungeon
+	*/
+	class BspTree
+	{
+	private:
+		// Scratch arenas for the subtrees that are split in parallel (kept to reuse their memory)
+		std::vector< std::vector<BspPartition> > subtreeNodes;
+		// Splits a single node into four children, returns false if the node is a leaf
+		static bool split(std::vector<BspPartition> &nodes, int32_t index);
+		static void splitRecursive(std::vector<BspPartition> &nodes, int32_t index);
+	public:
+		static const int32_t rootIndex = 0;
+		// Number of subtrees the upper levels are split into before the subtrees are built separately
+		static const size_t subtreeCount = 64;
+		std::vector<BspPartition> nodes;
+		inline BspPartition& operator[](int32_t index) { return nodes[index]; }
+		inline const BspPartition& operator[](int32_t index) const { return nodes[index]; }
+		/*
+			Builds the tree for the given area
+			If a thread pool is passed, subtrees are split in parallel. The resulting tree (including
+			the node order) is the same for any number of threads
+		*/
+		void build(int width, int height, Random random, vks::ThreadPool *threadPool = nullptr);
+		void clear();
+		// Returns the indices of all leaf nodes in depth first order
+		void getLeaves(std::vector<int32_t> &leaves) const;
+	};
 
+}
@@ -8,12 +8,14 @@
 
 #pragma once
 
-#include <vector>
-#include "vulkan/vulkan.h"
-#include <glm\glm.hpp>
+#include <stdint.h>
 
 namespace dungeongenerator {
 
+	/*
+		Cell types and directions
+		The cell data itself is stored in flat arrays owned by the dungeon (see Dungeon.h)
+	*/
 	class Cell
 	{
 	public:
@@ -24,18 +26,8 @@ namespace dungeongenerator {
 		static const int dirSouth = 1;
 		static const int dirWest= 2;
 		static const int dirEast = 3;
-		int x;
-		int y;
-		int type;
-		bool hasDoor = false;
-		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
-		bool uncovered = false;
-		glm::mat4 modelMatrix;
-		std::vector<bool> walls;
-		std::vector<bool> doors;
-		Cell(int posX, int posY);
-		~Cell();
+		// Returns the bit for the given direction in a cell's wall or door mask
+		static inline uint8_t dirBit(int dir) { return (uint8_t)(1 << dir); }
 	};
 
 }
-
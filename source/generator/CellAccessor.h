@@ -0,0 +1,45 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include "Cell.h"
+#include "Dungeon.h"
+
+namespace dungeongenerator {
+
+	/*
+		Read access to cells by world position, independent of how the cells are stored
+		(a single dungeon grid or a world made of chunks). Positions outside of the world are empty
+	*/
+	class CellAccessor
+	{
+	public:
+		virtual ~CellAccessor() {}
+		virtual uint8_t getCellType(int x, int y) = 0;
+		virtual uint8_t getCellWalls(int x, int y) = 0;
+		virtual uint8_t getCellDoors(int x, int y) = 0;
+		inline bool hasWall(int x, int y, int dir) { return (getCellWalls(x, y) & Cell::dirBit(dir)) != 0; }
+		inline bool hasDoor(int x, int y, int dir) { return (getCellDoors(x, y) & Cell::dirBit(dir)) != 0; }
+	};
+
+	// Accessor for a single dungeon grid
+	class DungeonAccessor : public CellAccessor
+	{
+	private:
+		Dungeon *dungeon;
+		inline bool inside(int x, int y) const { return (x >= 0) && (y >= 0) && (x < dungeon->width) && (y < dungeon->height); }
+	public:
+		DungeonAccessor(Dungeon *dungeon) : dungeon(dungeon) {}
+		uint8_t getCellType(int x, int y) override { return inside(x, y) ? dungeon->getCellType(x, y) : (uint8_t)Cell::cellTypeEmpty; }
+		uint8_t getCellWalls(int x, int y) override { return inside(x, y) ? dungeon->cellWalls[dungeon->getCellIndex(x, y)] : 0; }
+		uint8_t getCellDoors(int x, int y) override { return inside(x, y) ? dungeon->cellDoors[dungeon->getCellIndex(x, y)] : 0; }
+	};
+
+}
@@ -0,0 +1,196 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "CellHierarchy.h"
+#include <math.h>
+#include <algorithm>
+
+namespace dungeongenerator {
+
+	const int CellHierarchy::boxOutside;
+	const int CellHierarchy::boxInside;
+	const int CellHierarchy::boxIntersecting;
+
+	// Same tolerance as vks::Frustum
+	static const float planeTolerance = 0.02f;
+
+	int CellHierarchy::checkBox(const float *planes, const float *boxMin, const float *boxMax)
+	{
+		int result = boxInside;
+		for (uint32_t i = 0; i < 6; i++) {
+			const float *plane = &planes[i * 4];
+			// Distances of the corners farthest along and against the plane's normal
+			float farthest = plane[3];
+			float nearest = plane[3];
+			for (uint32_t axis = 0; axis < 3; axis++) {
+				if (plane[axis] >= 0.0f) {
+					farthest += plane[axis] * boxMax[axis];
+					nearest += plane[axis] * boxMin[axis];
+				}
+				else {
+					farthest += plane[axis] * boxMin[axis];
+					nearest += plane[axis] * boxMax[axis];
+				}
+			}
+			if (farthest < -planeTolerance) {
+				return boxOutside;
+			}
+			if (nearest < -planeTolerance) {
+				result = boxIntersecting;
+			}
+		}
+		return result;
+	}
+
+	bool CellHierarchy::testCell(uint32_t cell, const float *planes, const float *eye, float maxDistance) const
+	{
+		const float x = (float)(cell % width);
+		const float z = (float)(cell / width);
+		if ((x - eye[0]) * (x - eye[0]) + eye[1] * eye[1] + (z - eye[2]) * (z - eye[2]) > maxDistance * maxDistance) {
+			return false;
+		}
+		const float boxMin[3] = { x - 0.5f, -cellHalfHeight, z - 0.5f };
+		const float boxMax[3] = { x + 0.5f, cellHalfHeight, z + 0.5f };
+		return checkBox(planes, boxMin, boxMax) != boxOutside;
+	}
+
+	void CellHierarchy::build(const Dungeon &dungeon)
+	{
+		width = dungeon.width;
+		height = dungeon.height;
+		const BspTree &tree = dungeon.partitions;
+		nodes.resize(tree.nodes.size());
+		cells.clear();
+
+		// Leaves in depth first order, so the cells of every subtree end up next to each other
+		for (auto index : dungeon.partitionList) {
+			const BspPartition &partition = tree[index];
+			Node &node = nodes[index];
+			node.minX = node.minY = INT32_MAX;
+			node.maxX = node.maxY = INT32_MIN;
+			node.firstChild = -1;
+			node.firstCell = (uint32_t)cells.size();
+			for (int y = std::max(partition.top, 0); y < std::min(partition.bottom, height); y++) {
+				for (int x = std::max(partition.left, 0); x < std::min(partition.right, width); x++) {
+					if (dungeon.getCellType(x, y) != Cell::cellTypeEmpty) {
+						cells.push_back(dungeon.getCellIndex(x, y));
+						node.minX = std::min(node.minX, x);
+						node.minY = std::min(node.minY, y);
+						node.maxX = std::max(node.maxX, x);
+						node.maxY = std::max(node.maxY, y);
+					}
+				}
+			}
+			node.cellCount = (uint32_t)cells.size() - node.firstCell;
+		}
+
+		// Children are stored after their parents, so walking backwards visits all children first
+		for (int32_t index = (int32_t)tree.nodes.size() - 1; index >= 0; index--) {
+			const BspPartition &partition = tree[index];
+			if (partition.isLeaf()) {
+				continue;
+			}
+			Node &node = nodes[index];
+			node.minX = node.minY = INT32_MAX;
+			node.maxX = node.maxY = INT32_MIN;
+			node.firstChild = partition.firstChild;
+			node.firstCell = nodes[partition.firstChild].firstCell;
+			node.cellCount = 0;
+			for (int32_t i = 0; i < 4; i++) {
+				const Node &child = nodes[partition.firstChild + i];
+				if (child.cellCount > 0) {
+					node.minX = std::min(node.minX, child.minX);
+					node.minY = std::min(node.minY, child.minY);
+					node.maxX = std::max(node.maxX, child.maxX);
+					node.maxY = std::max(node.maxY, child.maxY);
+				}
+				node.cellCount += child.cellCount;
+			}
+		}
+
+		// Cells outside of all leaves (if any) are kept at the end
+		firstUncoveredCell = (uint32_t)cells.size();
+		const size_t occupied = dungeon.cellTypes.size() - std::count(dungeon.cellTypes.begin(), dungeon.cellTypes.end(), (uint8_t)Cell::cellTypeEmpty);
+		if (cells.size() < occupied) {
+			std::vector<uint8_t> covered(dungeon.cellTypes.size(), 0);
+			for (auto cell : cells) {
+				covered[cell] = 1;
+			}
+			for (uint32_t cell = 0; cell < dungeon.cellTypes.size(); cell++) {
+				if ((dungeon.cellTypes[cell] != Cell::cellTypeEmpty) && (!covered[cell])) {
+					cells.push_back(cell);
+				}
+			}
+		}
+	}
+
+	void CellHierarchy::cull(const float *planes, const float *eye, float maxDistance, std::vector<uint32_t> &result)
+	{
+		nodesVisited = 0;
+		cellsTested = 0;
+		const float maxDistanceSquared = maxDistance * maxDistance;
+		stack.clear();
+		if (!nodes.empty()) {
+			stack = { BspTree::rootIndex };
+		}
+		while (!stack.empty()) {
+			const Node &node = nodes[stack.back()];
+			stack.pop_back();
+			nodesVisited++;
+			if (node.cellCount == 0) {
+				continue;
+			}
+
+			// Distance of the nearest and the farthest cell center
+			const float nearestX = std::min(std::max(eye[0], (float)node.minX), (float)node.maxX) - eye[0];
+			const float nearestZ = std::min(std::max(eye[2], (float)node.minY), (float)node.maxY) - eye[2];
+			if (nearestX * nearestX + eye[1] * eye[1] + nearestZ * nearestZ > maxDistanceSquared) {
+				continue;
+			}
+			const float farthestX = std::max(fabsf(node.minX - eye[0]), fabsf(node.maxX - eye[0]));
+			const float farthestZ = std::max(fabsf(node.minY - eye[2]), fabsf(node.maxY - eye[2]));
+			const bool withinDistance = (farthestX * farthestX + eye[1] * eye[1] + farthestZ * farthestZ <= maxDistanceSquared);
+
+			const float boxMin[3] = { node.minX - 0.5f, -cellHalfHeight, node.minY - 0.5f };
+			const float boxMax[3] = { node.maxX + 0.5f, cellHalfHeight, node.maxY + 0.5f };
+			const int frustumCheck = checkBox(planes, boxMin, boxMax);
+			if (frustumCheck == boxOutside) {
+				continue;
+			}
+
+			if ((frustumCheck == boxInside) && (withinDistance)) {
+				result.insert(result.end(), cells.begin() + node.firstCell, cells.begin() + node.firstCell + node.cellCount);
+			}
+			else if (node.firstChild < 0) {
+				for (uint32_t i = node.firstCell; i < node.firstCell + node.cellCount; i++) {
+					cellsTested++;
+					if (testCell(cells[i], planes, eye, maxDistance)) {
+						result.push_back(cells[i]);
+					}
+				}
+			}
+			else {
+				for (int32_t i = 3; i >= 0; i--) {
+					stack.push_back(node.firstChild + i);
+				}
+			}
+		}
+		for (uint32_t i = firstUncoveredCell; i < cells.size(); i++) {
+			cellsTested++;
+			if (testCell(cells[i], planes, eye, maxDistance)) {
+				result.push_back(cells[i]);
+			}
+		}
+	}
+
+	size_t CellHierarchy::getMemorySize() const
+	{
+		return nodes.capacity() * sizeof(Node) + cells.capacity() * sizeof(uint32_t);
+	}
+
+}
@@ -0,0 +1,76 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include "Dungeon.h"
+
+namespace dungeongenerator {
+
+	/*
+		Bounding volume hierarchy over the non-empty cells, using the dungeon's partition tree
+
+		Every partition node stores the tight bounds of the non-empty cells below it. The cells are stored in depth
+		first order of the leaves, so the cells of any subtree are one contiguous range. Culling rejects subtrees
+		outside of the frustum or the draw distance and takes subtrees completely inside of both as a whole, only
+		cells of leaves crossing a boundary are tested one by one.
+
+		Cell (x, y) is a box centered on (x, 0, y) in world space, half a cell wide and cellHalfHeight high.
+		Frustum planes are (nx, ny, nz, d) with normals pointing inwards (as in vks::Frustum).
+	*/
+	class CellHierarchy
+	{
+	public:
+		struct Node {
+			// Bounds of the non-empty cells (inclusive), only valid if cellCount > 0
+			int32_t minX;
+			int32_t minY;
+			int32_t maxX;
+			int32_t maxY;
+			int32_t firstChild;
+			// Range of the subtree's cells in cells
+			uint32_t firstCell;
+			uint32_t cellCount;
+		};
+
+		static const int boxOutside = 0;
+		static const int boxInside = 1;
+		static const int boxIntersecting = 2;
+
+	private:
+		std::vector<int32_t> stack;
+		// Cells not covered by a leaf partition (tested one by one)
+		uint32_t firstUncoveredCell = 0;
+		bool testCell(uint32_t cell, const float *planes, const float *eye, float maxDistance) const;
+	public:
+		int width = 0;
+		int height = 0;
+		float cellHalfHeight = 2.5f;
+		// Indexed like the nodes of the partition tree
+		std::vector<Node> nodes;
+		std::vector<uint32_t> cells;
+		// Statistics of the last call to cull
+		uint32_t nodesVisited = 0;
+		uint32_t cellsTested = 0;
+
+		// Builds the hierarchy for the current partition tree and cells (has to be rebuilt after edits)
+		void build(const Dungeon &dungeon);
+		/*
+			Appends all cells inside of the frustum (six planes) whose center is within maxDistance of the eye position
+			Cells are appended in the order of the hierarchy
+		*/
+		void cull(const float *planes, const float *eye, float maxDistance, std::vector<uint32_t> &result);
+		// Classifies a box against the frustum planes
+		static int checkBox(const float *planes, const float *boxMin, const float *boxMax);
+		// Memory used by the hierarchy in bytes
+		size_t getMemorySize() const;
+	};
+
+}
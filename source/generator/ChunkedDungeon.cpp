@@ -0,0 +1,194 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "ChunkedDungeon.h"
+#include <stdlib.h>
+#include <algorithm>
+
+namespace dungeongenerator {
+
+	ChunkedDungeon::ChunkedDungeon(uint64_t worldSeed, int chunkSize, size_t maxChunks)
+	{
+		this->worldSeed = worldSeed;
+		this->chunkSize = std::max(chunkSize, 32);
+		this->maxChunks = std::max(maxChunks, (size_t)1);
+	}
+
+	int ChunkedDungeon::getPortalOffset(int32_t chunkX, int32_t chunkY, bool vertical) const
+	{
+		// Keep the corridor away from the corners
+		const int margin = chunkSize / 8;
+		Random random = Random(worldSeed, vertical ? 1 : 2).fork(getChunkKey(chunkX, chunkY));
+		return margin + random.range(chunkSize - 2 * margin);
+	}
+
+	void ChunkedDungeon::generateChunk(Chunk &chunk)
+	{
+		Dungeon &dungeon = chunk.dungeon;
+		dungeon.generateRooms();
+		dungeon.generateCorridors();
+
+		/*
+			Connect the chunk to its neighbours
+			Vertical borders are identified by the chunk to the east, horizontal borders by the chunk to the south
+			Each portal is connected to the nearest room via a point two cells inside the chunk, so the corridor
+			only touches the border at the portal itself
+		*/
+		const int last = chunkSize - 1;
+		struct Portal {
+			int x, y;
+			int innerX, innerY;
+			int dir;
+		} portals[4];
+		int offset = getPortalOffset(chunk.chunkX, chunk.chunkY, true);
+		portals[0] = { 0, offset, 2, offset, Cell::dirWest };
+		offset = getPortalOffset(chunk.chunkX + 1, chunk.chunkY, true);
+		portals[1] = { last, offset, last - 2, offset, Cell::dirEast };
+		offset = getPortalOffset(chunk.chunkX, chunk.chunkY, false);
+		portals[2] = { offset, 0, offset, 2, Cell::dirNorth };
+		offset = getPortalOffset(chunk.chunkX, chunk.chunkY + 1, false);
+		portals[3] = { offset, last, offset, last - 2, Cell::dirSouth };
+
+		for (auto &portal : portals) {
+			int targetX = chunkSize / 2;
+			int targetY = chunkSize / 2;
+			int minDistance = -1;
+			for (auto index : dungeon.partitionList) {
+				const BspPartition &partition = dungeon.partitions[index];
+				if (!partition.hasRoom) {
+					continue;
+				}
+				const int distance = abs(partition.centerX - portal.innerX) + abs(partition.centerY - portal.innerY);
+				if ((minDistance < 0) || (distance < minDistance)) {
+					minDistance = distance;
+					targetX = partition.centerX;
+					targetY = partition.centerY;
+				}
+			}
+			dungeon.carveCorridor(targetX, targetY, portal.innerX, portal.innerY);
+			dungeon.carveCorridor(portal.innerX, portal.innerY, portal.x, portal.y);
+		}
+
+		dungeon.generateWalls();
+		dungeon.generateDoors();
+
+		// Open the walls towards the neighbouring chunks
+		for (auto &portal : portals) {
+			dungeon.cellWalls[dungeon.getCellIndex(portal.x, portal.y)] &= ~Cell::dirBit(portal.dir);
+		}
+	}
+
+	ChunkedDungeon::Chunk* ChunkedDungeon::loadChunk(int32_t chunkX, int32_t chunkY)
+	{
+		const uint64_t key = getChunkKey(chunkX, chunkY);
+		auto it = chunks.find(key);
+		if (it != chunks.end()) {
+			lru.splice(lru.begin(), lru, it->second.lruPosition);
+			return it->second.chunk.get();
+		}
+
+		Random random = Random(worldSeed).fork(key);
+		// Separate statements, the evaluation order of two calls within one expression differs between compilers
+		const uint64_t seedHigh = random.next();
+		const uint64_t seedLow = random.next();
+		const uint64_t chunkSeed = (seedHigh << 32) | seedLow;
+		ChunkEntry &entry = chunks[key];
+		entry.chunk.reset(new Chunk(chunkX, chunkY, chunkSize, chunkSeed));
+		lru.push_front(entry.chunk.get());
+		entry.lruPosition = lru.begin();
+		generateChunk(*entry.chunk);
+		chunksGenerated++;
+		if (onChunkLoaded) {
+			onChunkLoaded(*entry.chunk);
+		}
+		return entry.chunk.get();
+	}
+
+	void ChunkedDungeon::evict(size_t keep)
+	{
+		const size_t limit = std::max(maxChunks, keep);
+		while (lru.size() > limit) {
+			Chunk *chunk = lru.back();
+			if (onChunkEvicted) {
+				onChunkEvicted(*chunk);
+			}
+			lru.pop_back();
+			chunks.erase(getChunkKey(chunk->chunkX, chunk->chunkY));
+		}
+	}
+
+	ChunkedDungeon::Chunk* ChunkedDungeon::getChunk(int32_t chunkX, int32_t chunkY)
+	{
+		// Chunks are only evicted by update, so pointers handed out since then stay valid
+		return loadChunk(chunkX, chunkY);
+	}
+
+	ChunkedDungeon::Chunk* ChunkedDungeon::findChunk(int32_t chunkX, int32_t chunkY) const
+	{
+		auto it = chunks.find(getChunkKey(chunkX, chunkY));
+		return (it != chunks.end()) ? it->second.chunk.get() : nullptr;
+	}
+
+	ChunkedDungeon::Chunk* ChunkedDungeon::getChunkAt(int x, int y)
+	{
+		const int32_t chunkX = getChunkCoord(x);
+		const int32_t chunkY = getChunkCoord(y);
+		Chunk *chunk = findChunk(chunkX, chunkY);
+		return chunk ? chunk : getChunk(chunkX, chunkY);
+	}
+
+	void ChunkedDungeon::update(int x, int y, int radius)
+	{
+		const int32_t minX = getChunkCoord(x - radius);
+		const int32_t maxX = getChunkCoord(x + radius);
+		const int32_t minY = getChunkCoord(y - radius);
+		const int32_t maxY = getChunkCoord(y + radius);
+		activeChunks.clear();
+		for (int32_t chunkY = minY; chunkY <= maxY; chunkY++) {
+			for (int32_t chunkX = minX; chunkX <= maxX; chunkX++) {
+				activeChunks.push_back(loadChunk(chunkX, chunkY));
+			}
+		}
+		// Chunks of the area are the most recently used ones, so they are kept
+		evict((size_t)(maxX - minX + 1) * (maxY - minY + 1));
+	}
+
+	uint8_t ChunkedDungeon::getCellType(int x, int y)
+	{
+		Chunk *chunk = getChunkAt(x, y);
+		return chunk->dungeon.getCellType(x - chunk->chunkX * chunkSize, y - chunk->chunkY * chunkSize);
+	}
+
+	uint8_t ChunkedDungeon::getCellWalls(int x, int y)
+	{
+		Chunk *chunk = getChunkAt(x, y);
+		return chunk->dungeon.cellWalls[chunk->dungeon.getCellIndex(x - chunk->chunkX * chunkSize, y - chunk->chunkY * chunkSize)];
+	}
+
+	uint8_t ChunkedDungeon::getCellDoors(int x, int y)
+	{
+		Chunk *chunk = getChunkAt(x, y);
+		return chunk->dungeon.cellDoors[chunk->dungeon.getCellIndex(x - chunk->chunkX * chunkSize, y - chunk->chunkY * chunkSize)];
+	}
+
+	void ChunkedDungeon::getRoomCenter(int32_t chunkX, int32_t chunkY, int &x, int &y)
+	{
+		Chunk *chunk = getChunk(chunkX, chunkY);
+		x = chunkX * chunkSize + chunkSize / 2;
+		y = chunkY * chunkSize + chunkSize / 2;
+		for (auto index : chunk->dungeon.partitionList) {
+			const BspPartition &partition = chunk->dungeon.partitions[index];
+			if (partition.hasRoom) {
+				x = chunkX * chunkSize + partition.centerX;
+				y = chunkY * chunkSize + partition.centerY;
+				return;
+			}
+		}
+	}
+
+}
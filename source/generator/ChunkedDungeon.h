@@ -0,0 +1,104 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <list>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include "Dungeon.h"
+#include "CellAccessor.h"
+
+namespace dungeongenerator {
+
+	/*
+		Unbounded dungeon world made of fixed size chunks
+
+		Chunks are generated on demand as separate dungeons. Each chunk's seed only depends on the world seed and
+		the chunk's position, so chunks can be generated in any order and regenerated after being evicted with the
+		same result. Only a limited number of chunks is kept in memory, the least recently used ones are evicted
+
+		Neighbouring chunks are connected by one corridor per shared border. The corridor's position on the border
+		is derived from the world seed and the border's position, so both chunks agree on it without knowing
+		about each other
+	*/
+	class ChunkedDungeon : public CellAccessor
+	{
+	public:
+		struct Chunk {
+			int32_t chunkX;
+			int32_t chunkY;
+			Dungeon dungeon;
+			Chunk(int32_t chunkX, int32_t chunkY, int size, uint64_t seed) : chunkX(chunkX), chunkY(chunkY), dungeon(size, size, seed) {}
+		};
+	private:
+		typedef std::list<Chunk*> LruList;
+		struct ChunkEntry {
+			std::unique_ptr<Chunk> chunk;
+			LruList::iterator lruPosition;
+		};
+		std::unordered_map<uint64_t, ChunkEntry> chunks;
+		// Most recently used chunk first
+		LruList lru;
+
+		static inline uint64_t getChunkKey(int32_t chunkX, int32_t chunkY) { return ((uint64_t)(uint32_t)chunkX << 32) | (uint32_t)chunkY; }
+		// Floor division, so negative positions map to the right chunk
+		inline int32_t getChunkCoord(int v) const { return (v >= 0) ? v / chunkSize : -((-v - 1) / chunkSize) - 1; }
+		// Position of the connecting corridor on the border between two chunks (offset along the border)
+		int getPortalOffset(int32_t chunkX, int32_t chunkY, bool vertical) const;
+		void generateChunk(Chunk &chunk);
+		// Returns the chunk (generated if required) and marks it as most recently used
+		Chunk* loadChunk(int32_t chunkX, int32_t chunkY);
+		// Evicts least recently used chunks until no more than max(maxChunks, keep) chunks are loaded
+		void evict(size_t keep);
+	public:
+		uint64_t worldSeed;
+		int chunkSize;
+		// Maximum number of chunks kept in memory
+		size_t maxChunks;
+		// Number of chunks generated so far (including regenerated ones)
+		uint64_t chunksGenerated = 0;
+		// Called when a chunk has been generated or is about to be evicted (e.g. to create or release render data)
+		std::function<void(Chunk&)> onChunkLoaded;
+		std::function<void(Chunk&)> onChunkEvicted;
+		// Chunks within the area of the last update call (valid until the next update)
+		std::vector<Chunk*> activeChunks;
+
+		ChunkedDungeon(uint64_t worldSeed, int chunkSize = 64, size_t maxChunks = 64);
+
+		/*
+			Returns the chunk at the given chunk position, generates it if it's not loaded
+			Marks the chunk as recently used, never evicts (see update)
+		*/
+		Chunk* getChunk(int32_t chunkX, int32_t chunkY);
+		// Returns the loaded chunk at the given position or null (doesn't change the LRU order)
+		Chunk* findChunk(int32_t chunkX, int32_t chunkY) const;
+		// Returns the chunk containing the given world cell position (generated if required)
+		Chunk* getChunkAt(int x, int y);
+
+		/*
+			Loads all chunks within radius cells around the given position and marks them as recently used
+			This is the only place where chunks are evicted, chunks loaded by lookups in between may exceed maxChunks
+			until the next update. Cell queries within the area don't change any state afterwards, so they can be
+			done from multiple threads
+		*/
+		void update(int x, int y, int radius);
+		size_t getLoadedChunkCount() const { return chunks.size(); }
+
+		// Cell access by world position (not thread safe if the chunk needs to be generated, see update)
+		uint8_t getCellType(int x, int y) override;
+		uint8_t getCellWalls(int x, int y) override;
+		uint8_t getCellDoors(int x, int y) override;
+		// Returns a cell position inside a room of the chunk at the given position (e.g. as a starting point)
+		void getRoomCenter(int32_t chunkX, int32_t chunkY, int &x, int &y);
+	};
+
+}
@@ -0,0 +1,106 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "CorridorRouter.h"
+#include "Dungeon.h"
+#include <stdlib.h>
+#include <algorithm>
+
+namespace dungeongenerator {
+
+	void CorridorRouter::route(Dungeon &dungeon, int startX, int startY, int destX, int destY, int left, int top, int right, int bottom)
+	{
+		// Centers of degenerate partitions can lie on the grid's outer edge (see generateCells)
+		startX = std::min(std::max(startX, 0), dungeon.width - 1);
+		startY = std::min(std::max(startY, 0), dungeon.height - 1);
+		destX = std::min(std::max(destX, 0), dungeon.width - 1);
+		destY = std::min(std::max(destY, 0), dungeon.height - 1);
+		left = std::max(std::min(left, std::min(startX, destX)), 0);
+		top = std::max(std::min(top, std::min(startY, destY)), 0);
+		right = std::min(std::max(right, std::max(startX, destX)), dungeon.width - 1);
+		bottom = std::min(std::max(bottom, std::max(startY, destY)), dungeon.height - 1);
+		const int areaWidth = right - left + 1;
+		const size_t areaSize = (size_t)areaWidth * (bottom - top + 1);
+
+		visited.assign((areaSize + 63) / 64, 0);
+		if (parentDir.size() < areaSize) {
+			parentDir.resize(areaSize);
+		}
+		openList.clear();
+
+		const int offsets[4][2] = { { 0, -1 }, { 0, 1 }, { -1, 0 }, { 1, 0 } };
+		const uint32_t start = (startY - top) * areaWidth + (startX - left);
+		const uint32_t dest = (destY - top) * areaWidth + (destX - left);
+		uint32_t sequence = 0;
+
+		openList.push_back({ costEmpty * (uint32_t)(abs(destX - startX) + abs(destY - startY)), 0, sequence++, start, Cell::dirNorth });
+		while (!openList.empty()) {
+			std::pop_heap(openList.begin(), openList.end(), OpenNodeCompare());
+			const OpenNode node = openList.back();
+			openList.pop_back();
+			uint64_t &visitedWord = visited[node.cell / 64];
+			const uint64_t visitedBit = 1ULL << (node.cell % 64);
+			if (visitedWord & visitedBit) {
+				continue;
+			}
+			visitedWord |= visitedBit;
+			parentDir[node.cell] = node.dir;
+			cellsExpanded++;
+			if (node.cell == dest) {
+				break;
+			}
+			const int x = left + node.cell % areaWidth;
+			const int y = top + node.cell / areaWidth;
+			// The direction this cell was entered from is pushed last, so it's taken first on ties
+			const int arrivalDir = parentDir[node.cell];
+			for (int i = 1; i <= 4; i++) {
+				const int dir = (arrivalDir + i) % 4;
+				const int nx = x + offsets[dir][0];
+				const int ny = y + offsets[dir][1];
+				if ((nx < left) || (ny < top) || (nx > right) || (ny > bottom)) {
+					continue;
+				}
+				const uint32_t cell = (ny - top) * areaWidth + (nx - left);
+				if (visited[cell / 64] & (1ULL << (cell % 64))) {
+					continue;
+				}
+				uint32_t cost;
+				switch (dungeon.getCellType(nx, ny)) {
+				case Cell::cellTypeCorridor:
+					cost = costCorridor;
+					break;
+				case Cell::cellTypeRoom:
+					cost = costRoom;
+					break;
+				default:
+					cost = costEmpty;
+				}
+				// Cells can be pushed more than once, only the first one to be popped is expanded
+				const uint32_t g = node.g + cost;
+				openList.push_back({ g + costEmpty * (uint32_t)(abs(destX - nx) + abs(destY - ny)), g, sequence++, cell, (uint8_t)dir });
+				std::push_heap(openList.begin(), openList.end(), OpenNodeCompare());
+			}
+		}
+
+		// Walk back from the destination, the area is a rectangle so the destination is always reached
+		uint32_t cell = dest;
+		while (true) {
+			const int x = left + cell % areaWidth;
+			const int y = top + cell / areaWidth;
+			if (dungeon.getCellType(x, y) != Cell::cellTypeRoom) {
+				dungeon.setCellType(x, y, Cell::cellTypeCorridor);
+			}
+			if (cell == start) {
+				break;
+			}
+			const int dir = parentDir[cell] ^ 1;
+			cell = (y + offsets[dir][1] - top) * areaWidth + (x + offsets[dir][0] - left);
+		}
+	}
+
+}
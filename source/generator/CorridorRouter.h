@@ -0,0 +1,62 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+namespace dungeongenerator {
+
+	class Dungeon;
+
+	/*
+		Routes corridors with A* over a cost field
+		Existing corridors are cheaper than rooms, which are cheaper than empty cells, so new corridors merge into
+		existing ones where this doesn't mean a detour. The heuristic is weighted with the cost of empty cells, so
+		the search runs straight towards the destination in open space instead of exploring the whole area
+		(at the price of not always finding the cheapest path)
+
+		The open list, the visited bitmap and the path directions are kept between searches to reuse their memory
+	*/
+	class CorridorRouter
+	{
+	private:
+		struct OpenNode {
+			uint32_t f;
+			uint32_t g;
+			// Push order, the most recently pushed of two equally good nodes comes first (keeps corridors straight)
+			uint32_t sequence;
+			uint32_t cell;
+			// Direction the cell is entered from
+			uint8_t dir;
+		};
+		struct OpenNodeCompare {
+			inline bool operator()(const OpenNode &a, const OpenNode &b) const {
+				return (a.f != b.f) ? (a.f > b.f) : (a.sequence < b.sequence);
+			}
+		};
+		std::vector<OpenNode> openList;
+		// One bit per cell of the search area
+		std::vector<uint64_t> visited;
+		// Direction each visited cell was entered from
+		std::vector<uint8_t> parentDir;
+	public:
+		static const uint32_t costCorridor = 1;
+		static const uint32_t costRoom = 2;
+		static const uint32_t costEmpty = 4;
+		// Number of cells expanded by all searches so far
+		uint64_t cellsExpanded = 0;
+		/*
+			Finds a path between the two cells (clamped to the grid) within the given area (inclusive, clipped to the grid)
+			and turns all non-room cells along it into corridors
+		*/
+		void route(Dungeon &dungeon, int startX, int startY, int destX, int destY, int left, int top, int right, int bottom);
+	};
+
+}
@@ -8,82 +8,70 @@
 
 #include "Dungeon.h"
 #include "BspPartition.h"
+#include "BitPlane.h"
 #include <stdio.h>
+#include <algorithm>
+#include "threadpool.hpp"
 
 namespace dungeongenerator {
 
-	Dungeon::Dungeon(int w, int h)
+	Dungeon::Dungeon(int w, int h, uint64_t seed)
 	{
 		width = w;
 		height = h;
+		this->seed = seed;
 
-		cells.resize(width);
-		for (int x = 0; x < width; ++x) {
-			cells[x].resize(height);
-			for (int y = 0; y < height; ++y) {
-				cells[x][y] = new Cell(x, y);
-			}
-		}
+		const size_t cellCount = (size_t)width * height;
+		cellTypes.assign(cellCount, (uint8_t)Cell::cellTypeEmpty);
+		cellWalls.assign(cellCount, 0);
+		cellDoors.assign(cellCount, 0);
 
+		dirtyTilesX = (width + dirtyTileSize - 1) / dirtyTileSize;
+		dirtyTilesY = (height + dirtyTileSize - 1) / dirtyTileSize;
+		dirtyTiles.assign((size_t)dirtyTilesX * dirtyTilesY, 0);
 	}
 
 
 	Dungeon::~Dungeon()
 	{
-		for (int x = 0; x < width; ++x) {
-			cells[x].resize(height);
-			for (int y = 0; y < height; ++y) {
-				delete(cells[x][y]);
-			}
-		}
 	}
 
-	Cell* Dungeon::getCell(int x, int y) {
-		return cells[x][y];
+	size_t Dungeon::getCellMemorySize() const
+	{
+		return cellTypes.capacity() + cellWalls.capacity() + cellDoors.capacity();
 	}
 
+	// Randomly places a room inside a leaf partition (only writes cells inside the partition)
 	void generateCells(Dungeon* dungeon, BspPartition* bspPartition) {
 		// TODO: Constant for max. room size (to avoid huge rooms)
-		if ((bspPartition->children.size() == 0) && (rand() % 100) < 75 /*dungeonRoomFrequency*/) {
+		if (bspPartition->random.range(100) < 75 /*dungeonRoomFrequency*/) {
+			// Degenerate partitions on the grid's outer edge (one cell wide or less) can have their center outside of the grid
+			if ((bspPartition->centerX >= dungeon->width) || (bspPartition->centerY >= dungeon->height)) {
+				return;
+			}
 			bspPartition->hasRoom = true;
 			for (int x = bspPartition->left + 2; x <= bspPartition->right - 2; x++) {
 				for (int y = bspPartition->top + 2; y <= bspPartition->bottom - 2; y++) {
 					if ((x >= dungeon->width - 1) || (y >= dungeon->height - 1)) {
 						break;
 					}
-					dungeon->cells[x][y]->type = Cell::cellTypeRoom;
+					dungeon->setCellType(x, y, Cell::cellTypeRoom);
 					//this.roomDimLeft = this.left + 2;
 					//this.roomDimTop = this.top + 2;
 					//this.roomDimRight = this.right - 2;
 					//this.roomDimBottom = this.bottom - 2;
 				}
 			}
-
-
-		}
-		else {
-			for (auto& child : bspPartition->children) {
-				generateCells(dungeon, child);
-			}
-		}
-
-	}
-
-	void Dungeon::getPartitions(BspPartition *bspPartition)
-	{
-		if (bspPartition->children.empty()) {
-			partitionList.push_back(bspPartition);
-		} else {
-			for (auto child : bspPartition->children) {
-				getPartitions(child);
-			}
 		}
 	}
 
 	void generateCorridor(Dungeon* dungeon, int startX, int startY, int destX, int destY) {
 
-		int curPosX = startX;
-		int curPosY = startY;
+		// Centers of degenerate partitions can lie on the grid's outer edge (see generateCells)
+		destX = std::min(std::max(destX, 0), dungeon->width - 1);
+		destY = std::min(std::max(destY, 0), dungeon->height - 1);
+		int curPosX = std::min(std::max(startX, 0), dungeon->width - 1);
+		int curPosY = std::min(std::max(startY, 0), dungeon->height - 1);
 
 		do {
 
@@ -110,163 +98,469 @@ namespace dungeongenerator {
 			//	dungeon->cell[curPosX][curPosY].isCorridor = true;
 			//}
 
-			if (dungeon->cells[curPosX][curPosY]->type != Cell::cellTypeRoom) {
-				dungeon->cells[curPosX][curPosY]->type = Cell::cellTypeCorridor;
+			if (dungeon->getCellType(curPosX, curPosY) != Cell::cellTypeRoom) {
+				dungeon->setCellType(curPosX, curPosY, Cell::cellTypeCorridor);
 			}
 
 		} while ((curPosX != destX) || (curPosY != destY));
 
 	}
 	
-	void connectPartition(Dungeon* dungeon, BspPartition* partition) {
-		std::vector<BspPartition*> connectionList;
+	// Returns the partitions a node gets connected with (child rooms, the node itself and its parent), in connection order
+	void getConnectionList(const BspTree &partitions, int32_t index, std::vector<int32_t> &connectionList) {
+		const BspPartition &partition = partitions[index];
+		connectionList.clear();
 
 		// Add child nodes with rooms to connection target list
-		if (!partition->children.empty()) {
-			for (auto child : partition->children) {
-				if (child->hasRoom) {
-					connectionList.push_back(child);
+		if (!partition.isLeaf()) {
+			for (int32_t i = 0; i < 4; i++) {
+				if (partitions[partition.firstChild + i].hasRoom) {
+					connectionList.push_back(partition.firstChild + i);
 				}
 			}
 		}
 
 		// Add this node (and if set it's parent) to the connection list
-		connectionList.push_back(partition);
-		if (partition->parent != NULL) {
-			connectionList.push_back(partition->parent);
-		}
-
-		if (connectionList.size() == 0) {
-			return;
+		connectionList.push_back(index);
+		if (partition.parent >= 0) {
+			connectionList.push_back(partition.parent);
 		}
+	}
 
-		for (int i = 0; i < connectionList.size() - 1; i++) {
-			int startX = connectionList[i]->centerX;
-			int startY = connectionList[i]->centerY;
-			int destX = connectionList[i + 1]->centerX;
-			int destY = connectionList[i + 1]->centerY;
+	void connectPartition(Dungeon* dungeon, int32_t index) {
+		const BspTree &partitions = dungeon->partitions;
+		const BspPartition &partition = partitions[index];
+		std::vector<int32_t> connectionList;
+		getConnectionList(partitions, index, connectionList);
+
+		for (size_t i = 0; i < connectionList.size() - 1; i++) {
+			int startX = partitions[connectionList[i]].centerX;
+			int startY = partitions[connectionList[i]].centerY;
+			int destX = partitions[connectionList[i + 1]].centerX;
+			int destY = partitions[connectionList[i + 1]].centerY;
 			generateCorridor(dungeon, startX, startY, destX, destY);
 		}
 
-		if (partition->parent != NULL) {
-			connectPartition(dungeon, partition->parent);
+		if (partition.parent >= 0) {
+			connectPartition(dungeon, partition.parent);
 		}
 	}
 
-	void generateCorridors(Dungeon* dungeon) {
-		for (auto partition : dungeon->partitionList) {
-			if ((partition->hasRoom) && (partition->children.empty())) {
-				connectPartition(dungeon, partition);
+	void Dungeon::generateRooms() {
+		random = Random(seed);
+
+		std::fill(cellTypes.begin(), cellTypes.end(), (uint8_t)Cell::cellTypeEmpty);
+		std::fill(cellWalls.begin(), cellWalls.end(), 0);
+		std::fill(cellDoors.begin(), cellDoors.end(), 0);
+
+		// Pending edits are meaningless for a new dungeon
+		clearEdits();
+
+		if (threadCount > 1) {
+			vks::ThreadPool threadPool;
+			threadPool.setThreadCount(threadCount);
+
+			partitions.build(width, height, random.fork(0), &threadPool);
+
+			partitionList.clear();
+			partitions.getLeaves(partitionList);
+
+			// Leaf partitions don't overlap, so rooms can be placed in parallel
+			const size_t blockSize = (partitionList.size() + threadCount - 1) / threadCount;
+			for (uint32_t t = 0; t < threadCount; t++) {
+				const size_t first = std::min(t * blockSize, partitionList.size());
+				const size_t last = std::min(first + blockSize, partitionList.size());
+				threadPool.threads[t]->addJob([this, first, last] {
+					for (size_t i = first; i < last; i++) {
+						generateCells(this, &partitions[partitionList[i]]);
+					}
+				});
+			}
+			threadPool.wait();
+		}
+		else {
+			partitions.build(width, height, random.fork(0));
+
+			partitionList.clear();
+			partitions.getLeaves(partitionList);
+
+			for (auto index : partitionList) {
+				generateCells(this, &partitions[index]);
 			}
 		}
 	}
-	
-	void Dungeon::generateRooms() {
-		dungeongenerator::BspPartition rootPartition(NULL, 0, 0, width, height, BspPartition::BspPartitionSplitHorizontal, 0);
-		//rootPartition.split(true, 15, 32);
 
-		generateCells(this, &rootPartition);
+	void Dungeon::clearEdits() {
+		for (auto tile : dirtyTileList) {
+			dirtyTiles[tile] = 0;
+		}
+		dirtyTileList.clear();
+		editedCells.clear();
+		changedCells.clear();
+	}
 
-		partitionList.clear();
-		getPartitions(&rootPartition);
+	void Dungeon::generateRooms(uint64_t seed) {
+		this->seed = seed;
+		generateRooms();
+	}
 
-		generateCorridors(this);
-				
+	void Dungeon::generateCorridors() {
+		// Each node on the way from a room to the root is connected once, a chain ends at the first node that's already connected
+		std::vector<uint8_t> connected(partitions.nodes.size(), 0);
+		std::vector<int32_t> connectionList;
+		for (auto leaf : partitionList) {
+			if (!partitions[leaf].hasRoom) {
+				continue;
+			}
+			for (int32_t index = leaf; (index >= 0) && (!connected[index]); index = partitions[index].parent) {
+				connected[index] = 1;
+				getConnectionList(partitions, index, connectionList);
+				for (size_t i = 0; i < connectionList.size() - 1; i++) {
+					const BspPartition &start = partitions[connectionList[i]];
+					const BspPartition &dest = partitions[connectionList[i + 1]];
+					if (corridorRouting == corridorRoutingStraight) {
+						generateCorridor(this, start.centerX, start.centerY, dest.centerX, dest.centerY);
+					}
+					else {
+						// Connections to the parent are routed within the parent's area, all others within the node's area
+						const BspPartition &area = (connectionList[i + 1] == partitions[index].parent) ? dest : partitions[index];
+						corridorRouter.route(*this, start.centerX, start.centerY, dest.centerX, dest.centerY, area.left, area.top, area.right, area.bottom);
+					}
+				}
+			}
+		}
+	}
+
+	void Dungeon::generateCorridorsRecursive() {
+		for (auto index : partitionList) {
+			if (partitions[index].hasRoom) {
+				connectPartition(this, index);
+			}
+		}
+	}
+
+	void Dungeon::carveCorridor(int startX, int startY, int destX, int destY) {
+		if ((startX != destX) || (startY != destY)) {
+			generateCorridor(this, startX, startY, destX, destY);
+		}
 	}
 
 	BspPartition* Dungeon::getRandomRoom() {
+		// Leaves without rooms are skipped below, which would never end if there are no rooms at all (e.g. a loaded level)
+		if (std::none_of(partitionList.begin(), partitionList.end(), [this](int32_t index) { return partitions[index].hasRoom; })) {
+			return NULL;
+		}
 		BspPartition* room = NULL;
 		do {
-			int roomIndex = rand() % partitionList.size();
-			if ((partitionList[roomIndex]->hasRoom) && (partitionList[roomIndex]->children.empty())) {
-				room = partitionList[roomIndex];
+			int roomIndex = random.range((int)partitionList.size());
+			if (partitions[partitionList[roomIndex]].hasRoom) {
+				room = &partitions[partitionList[roomIndex]];
 			}
 		} while (room == NULL);
 
 		return room;
 	}
 
-	void Dungeon::generateWalls() {
-		for (int x = 0; x < width; ++x) {
-			for (int y = 0; y < height; ++y) {
-				if (cells[x][y]->type != Cell::cellTypeEmpty) {
-					Cell *curCell = cells[x][y];
-					// To the west
-					if (x == 0) {
-						curCell->walls[Cell::dirWest] = true;
-					}
-					else {
-						if (cells[x - 1][y]->type == Cell::cellTypeEmpty) {
-							curCell->walls[Cell::dirWest] = true;
-						}
-					}
+	void Dungeon::generateWallsScalar() {
+		for (int y = 0; y < height; ++y) {
+			const uint8_t *row = &cellTypes[getCellIndex(0, y)];
+			const uint8_t *rowNorth = (y > 0) ? row - width : nullptr;
+			const uint8_t *rowSouth = (y < height - 1) ? row + width : nullptr;
+			uint8_t *walls = &cellWalls[getCellIndex(0, y)];
+			for (int x = 0; x < width; ++x) {
+				if (row[x] == Cell::cellTypeEmpty) {
+					continue;
+				}
+				uint8_t mask = 0;
+				// To the west
+				if ((x == 0) || (row[x - 1] == Cell::cellTypeEmpty)) {
+					mask |= Cell::dirBit(Cell::dirWest);
+				}
+				// To the east
+				if ((x == width - 1) || (row[x + 1] == Cell::cellTypeEmpty)) {
+					mask |= Cell::dirBit(Cell::dirEast);
+				}
+				// To the north
+				if ((!rowNorth) || (rowNorth[x] == Cell::cellTypeEmpty)) {
+					mask |= Cell::dirBit(Cell::dirNorth);
+				}
+				// To the south
+				if ((!rowSouth) || (rowSouth[x] == Cell::cellTypeEmpty)) {
+					mask |= Cell::dirBit(Cell::dirSouth);
+				}
+				walls[x] |= mask;
+			}
+		}
+	}
 
-					// To the east
-					if (x == width - 1) {
-						curCell->walls[Cell::dirEast] = true;
-					}
-					else {
-						if (cells[x + 1][y]->type == Cell::cellTypeEmpty) {
-							curCell->walls[Cell::dirEast] = true;
-						}
-					}
+	void Dungeon::generateDoorsScalar() {
+		const uint8_t wallsWestEast = Cell::dirBit(Cell::dirWest) | Cell::dirBit(Cell::dirEast);
+		const uint8_t wallsNorthSouth = Cell::dirBit(Cell::dirNorth) | Cell::dirBit(Cell::dirSouth);
+		for (int y = 1; y < height - 1; ++y) {
+			const uint8_t *row = &cellTypes[getCellIndex(0, y)];
+			const uint8_t *rowNorth = row - width;
+			const uint8_t *rowSouth = row + width;
+			const uint8_t *walls = &cellWalls[getCellIndex(0, y)];
+			uint8_t *doors = &cellDoors[getCellIndex(0, y)];
+			for (int x = 1; x < width - 1; ++x) {
+				// TODO : Code doesnt' take corridors alongside 
+				if (row[x] != Cell::cellTypeCorridor) {
+					continue;
+				}
 
-					// To the north
-					if (y == 0) {
-						curCell->walls[Cell::dirNorth] = true;
-					}
-					else {
-						if (cells[x][y - 1]->type == Cell::cellTypeEmpty) {
-							curCell->walls[Cell::dirNorth] = true;
-						}
-					}
+				// Check if cell has at least two opposite walls to each other (east and west or south and north)
+				// Then check against neighbors. If neighbor cell has less than two walls, a corridor usually ends into a room and a door needs to be placed
 
-					// To the south
-					if (y == height - 1) {
-						curCell->walls[Cell::dirSouth] = true;
-					}
-					else {
-						if (cells[x][y + 1]->type == Cell::cellTypeEmpty) {
-							curCell->walls[Cell::dirSouth] = true;
-						}
-					}
+				uint8_t mask = 0;
+				if ((walls[x] & wallsWestEast) == wallsWestEast) {
+					if ((rowNorth[x] != Cell::cellTypeEmpty) && (rowNorth[x] != Cell::cellTypeCorridor))
+						mask |= Cell::dirBit(Cell::dirNorth);
+					if ((rowSouth[x] != Cell::cellTypeEmpty) && (rowSouth[x] != Cell::cellTypeCorridor))
+						mask |= Cell::dirBit(Cell::dirSouth);
+				}
+
+				if ((walls[x] & wallsNorthSouth) == wallsNorthSouth) {
+					if ((row[x - 1] != Cell::cellTypeEmpty) && (row[x - 1] != Cell::cellTypeCorridor))
+						mask |= Cell::dirBit(Cell::dirWest);
+					if ((row[x + 1] != Cell::cellTypeEmpty) && (row[x + 1] != Cell::cellTypeCorridor))
+						mask |= Cell::dirBit(Cell::dirEast);
 				}
+
+				doors[x] |= mask;
 			}
 		}
 	}
 
-	void Dungeon::generateDoors() {
-		for (int x = 1; x < width-1; ++x) {
-			for (int y = 1; y < height-1; ++y) {
-				Cell *curCell = cells[x][y];
-				// TODO : Code doesnt' take corridors alongside 
-				if (curCell->type == Cell::cellTypeCorridor) {
+	/*
+		Bit parallel versions of the wall and door generation
+		Rows are converted into bit planes (see BitPlane.h), so all neighbour checks for 64 cells are done with a few
+		shifts and logical operations on one word. Results are the same as for the scalar versions
+	*/
+
+	// Bit planes of the cell types for three consecutive rows, moved down one row at a time
+	struct RowPlanes {
+		const Dungeon *dungeon;
+		uint32_t wordCount;
+		int y = -2;
+		std::vector<uint64_t> occupied[3];
+		std::vector<uint64_t> corridors[3];
+		std::vector<uint64_t> rooms[3];
+
+		RowPlanes(const Dungeon *dungeon) : dungeon(dungeon) {
+			wordCount = BitPlane::getWordCount(dungeon->width);
+			for (uint32_t i = 0; i < 3; i++) {
+				occupied[i].assign(wordCount, 0);
+				corridors[i].assign(wordCount, 0);
+				rooms[i].assign(wordCount, 0);
+			}
+		}
 
-					// Check if cell has at least two opposite walls to each other (east and west or south and north)
-					// Then check against neighbors. If neighbor cell has less than two walls, a corridor usually ends into a room and a door needs to be placed
+		// Index 0 is the row to the north, 1 the current row and 2 the row to the south (all zero outside of the grid)
+		void next() {
+			for (uint32_t i = 0; i < 2; i++) {
+				occupied[i].swap(occupied[i + 1]);
+				corridors[i].swap(corridors[i + 1]);
+				rooms[i].swap(rooms[i + 1]);
+			}
+			y++;
+			if (y + 1 < dungeon->height) {
+				const uint8_t *types = &dungeon->cellTypes[dungeon->getCellIndex(0, y + 1)];
+				BitPlane::packTypes(types, dungeon->width, occupied[2].data(), corridors[2].data(), rooms[2].data());
+			}
+			else {
+				std::fill(occupied[2].begin(), occupied[2].end(), 0);
+				std::fill(corridors[2].begin(), corridors[2].end(), 0);
+				std::fill(rooms[2].begin(), rooms[2].end(), 0);
+			}
+		}
 
-					if ((curCell->walls[Cell::dirWest]) && (curCell->walls[Cell::dirEast])) {
-						if ((cells[x][y - 1]->type != Cell::cellTypeEmpty) && (cells[x][y - 1]->type != Cell::cellTypeCorridor))
-							curCell->doors[Cell::dirNorth] = true;
-						if ((cells[x][y + 1]->type != Cell::cellTypeEmpty) && (cells[x][y + 1]->type != Cell::cellTypeCorridor))
-							curCell->doors[Cell::dirSouth] = true;
-					}
+		inline uint64_t wall(uint32_t k, int dir) const {
+			const uint64_t *row = occupied[1].data();
+			switch (dir) {
+			case Cell::dirNorth:
+				return row[k] & ~occupied[0][k];
+			case Cell::dirSouth:
+				return row[k] & ~occupied[2][k];
+			case Cell::dirWest:
+				return row[k] & ~BitPlane::westOf(row, k);
+			default:
+				return row[k] & ~BitPlane::eastOf(row, k, wordCount);
+			}
+		}
+	};
 
-					if ((curCell->walls[Cell::dirNorth]) && (curCell->walls[Cell::dirSouth])) {
-						if ((cells[x - 1][y]->type != Cell::cellTypeEmpty) && (cells[x - 1][y]->type != Cell::cellTypeCorridor))
-							curCell->doors[Cell::dirWest] = true;
-						if ((cells[x + 1][y]->type != Cell::cellTypeEmpty) && (cells[x + 1][y]->type != Cell::cellTypeCorridor))
-							curCell->doors[Cell::dirEast] = true;
+	void Dungeon::generateWalls() {
+		RowPlanes rows(this);
+		std::vector<uint64_t> wallPlanes[4];
+		for (auto &plane : wallPlanes) {
+			plane.resize(rows.wordCount);
+		}
+		const uint64_t *planes[4] = { wallPlanes[0].data(), wallPlanes[1].data(), wallPlanes[2].data(), wallPlanes[3].data() };
+
+		rows.next();
+		for (int y = 0; y < height; ++y) {
+			rows.next();
+			for (uint32_t k = 0; k < rows.wordCount; k++) {
+				for (int dir = 0; dir < 4; dir++) {
+					wallPlanes[dir][k] = rows.wall(k, dir);
+				}
+			}
+			BitPlane::unpackOr(planes, width, &cellWalls[getCellIndex(0, y)]);
+		}
+	}
+
+	/*
+		Note: The walls used for placing doors are derived from the cell types the same way as in generateWalls
+		instead of being read back from the wall masks
+	*/
+	void Dungeon::generateDoors() {
+		if ((width < 3) || (height < 3)) {
+			return;
+		}
+		RowPlanes rows(this);
+		// Doors are only placed on cells in the interior of the grid
+		std::vector<uint64_t> interior(rows.wordCount, ~0ULL);
+		interior[0] &= ~1ULL;
+		interior[(width - 1) / 64] &= ~(1ULL << ((width - 1) % 64));
+		std::vector<uint64_t> doorPlanes[4];
+		for (auto &plane : doorPlanes) {
+			plane.resize(rows.wordCount);
+		}
+		const uint64_t *planes[4] = { doorPlanes[0].data(), doorPlanes[1].data(), doorPlanes[2].data(), doorPlanes[3].data() };
+
+		rows.next();
+		rows.next();
+		for (int y = 1; y < height - 1; ++y) {
+			rows.next();
+			const uint64_t *roomsNorth = rows.rooms[0].data();
+			const uint64_t *rooms = rows.rooms[1].data();
+			const uint64_t *roomsSouth = rows.rooms[2].data();
+			for (uint32_t k = 0; k < rows.wordCount; k++) {
+				const uint64_t corridor = rows.corridors[1][k] & interior[k];
+				if (corridor == 0) {
+					for (uint32_t dir = 0; dir < 4; dir++) {
+						doorPlanes[dir][k] = 0;
 					}
+					continue;
+				}
+				// Corridor with walls to the west and east, door to a room to the north or south
+				const uint64_t wallsWestEast = corridor & rows.wall(k, Cell::dirWest) & rows.wall(k, Cell::dirEast);
+				doorPlanes[Cell::dirNorth][k] = wallsWestEast & roomsNorth[k];
+				doorPlanes[Cell::dirSouth][k] = wallsWestEast & roomsSouth[k];
+				// Corridor with walls to the north and south, door to a room to the west or east
+				const uint64_t wallsNorthSouth = corridor & rows.wall(k, Cell::dirNorth) & rows.wall(k, Cell::dirSouth);
+				doorPlanes[Cell::dirWest][k] = wallsNorthSouth & BitPlane::westOf(rooms, k);
+				doorPlanes[Cell::dirEast][k] = wallsNorthSouth & BitPlane::eastOf(rooms, k, rows.wordCount);
+			}
+			BitPlane::unpackOr(planes, width, &cellDoors[getCellIndex(0, y)]);
+		}
+	}
+
+	uint8_t Dungeon::getWallMask(int x, int y) const {
+		if (getCellType(x, y) == Cell::cellTypeEmpty) {
+			return 0;
+		}
+		uint8_t mask = 0;
+		if ((x == 0) || (getCellType(x - 1, y) == Cell::cellTypeEmpty)) {
+			mask |= Cell::dirBit(Cell::dirWest);
+		}
+		if ((x == width - 1) || (getCellType(x + 1, y) == Cell::cellTypeEmpty)) {
+			mask |= Cell::dirBit(Cell::dirEast);
+		}
+		if ((y == 0) || (getCellType(x, y - 1) == Cell::cellTypeEmpty)) {
+			mask |= Cell::dirBit(Cell::dirNorth);
+		}
+		if ((y == height - 1) || (getCellType(x, y + 1) == Cell::cellTypeEmpty)) {
+			mask |= Cell::dirBit(Cell::dirSouth);
+		}
+		return mask;
+	}
 
+	uint8_t Dungeon::getDoorMask(int x, int y) const {
+		if ((x < 1) || (y < 1) || (x >= width - 1) || (y >= height - 1) || (getCellType(x, y) != Cell::cellTypeCorridor)) {
+			return 0;
+		}
+		const uint8_t wallsWestEast = Cell::dirBit(Cell::dirWest) | Cell::dirBit(Cell::dirEast);
+		const uint8_t wallsNorthSouth = Cell::dirBit(Cell::dirNorth) | Cell::dirBit(Cell::dirSouth);
+		const uint8_t walls = getWallMask(x, y);
+		uint8_t mask = 0;
+		if ((walls & wallsWestEast) == wallsWestEast) {
+			if (getCellType(x, y - 1) == Cell::cellTypeRoom)
+				mask |= Cell::dirBit(Cell::dirNorth);
+			if (getCellType(x, y + 1) == Cell::cellTypeRoom)
+				mask |= Cell::dirBit(Cell::dirSouth);
+		}
+		if ((walls & wallsNorthSouth) == wallsNorthSouth) {
+			if (getCellType(x - 1, y) == Cell::cellTypeRoom)
+				mask |= Cell::dirBit(Cell::dirWest);
+			if (getCellType(x + 1, y) == Cell::cellTypeRoom)
+				mask |= Cell::dirBit(Cell::dirEast);
+		}
+		return mask;
+	}
+
+	void Dungeon::setCellTypes(int left, int top, int right, int bottom, uint8_t type) {
+		left = std::max(left, 0);
+		top = std::max(top, 0);
+		right = std::min(right, width - 1);
+		bottom = std::min(bottom, height - 1);
+		if ((left > right) || (top > bottom)) {
+			return;
+		}
+		bool changed = false;
+		for (int y = top; y <= bottom; y++) {
+			for (int x = left; x <= right; x++) {
+				const uint32_t index = getCellIndex(x, y);
+				if (cellTypes[index] != type) {
+					cellTypes[index] = type;
+					editedCells.push_back(index);
+					changed = true;
+				}
+			}
+		}
+		if (!changed) {
+			return;
+		}
+		// Walls and doors depend on the direct neighbours, so the tiles touching the expanded rectangle need to be updated
+		const int tileLeft = std::max(left - 1, 0) / dirtyTileSize;
+		const int tileTop = std::max(top - 1, 0) / dirtyTileSize;
+		const int tileRight = std::min(right + 1, width - 1) / dirtyTileSize;
+		const int tileBottom = std::min(bottom + 1, height - 1) / dirtyTileSize;
+		for (int ty = tileTop; ty <= tileBottom; ty++) {
+			for (int tx = tileLeft; tx <= tileRight; tx++) {
+				const uint32_t tile = ty * dirtyTilesX + tx;
+				if (!dirtyTiles[tile]) {
+					dirtyTiles[tile] = 1;
+					dirtyTileList.push_back(tile);
 				}
-				for (auto d : curCell->doors) {
-					if (d) {
-						curCell->hasDoor = true;
+			}
+		}
+	}
+
+	size_t Dungeon::updateDirtyRegions() {
+		changedCells.swap(editedCells);
+		editedCells.clear();
+		for (auto tile : dirtyTileList) {
+			const int tileX = (tile % dirtyTilesX) * dirtyTileSize;
+			const int tileY = (tile / dirtyTilesX) * dirtyTileSize;
+			for (int y = tileY; y < std::min(tileY + dirtyTileSize, height); y++) {
+				for (int x = tileX; x < std::min(tileX + dirtyTileSize, width); x++) {
+					const uint32_t index = getCellIndex(x, y);
+					const uint8_t walls = getWallMask(x, y);
+					const uint8_t doors = getDoorMask(x, y);
+					if ((cellWalls[index] != walls) || (cellDoors[index] != doors)) {
+						cellWalls[index] = walls;
+						cellDoors[index] = doors;
+						changedCells.push_back(index);
 					}
 				}
 			}
+			dirtyTiles[tile] = 0;
 		}
+		dirtyTileList.clear();
+		std::sort(changedCells.begin(), changedCells.end());
+		changedCells.erase(std::unique(changedCells.begin(), changedCells.end()), changedCells.end());
+		return changedCells.size();
 	}
 
 }
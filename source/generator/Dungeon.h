@@ -9,28 +9,98 @@
 #pragma once
 
 #include <vector>
+#include <stdint.h>
+#include <stdlib.h>
 #include "BspPartition.h"
+#include "CorridorRouter.h"
 #include "Cell.h"
+#include "Random.h"
 
 namespace dungeongenerator {
 
 	class Dungeon
 	{
 	private:
-		void getPartitions(BspPartition *bspPartition);
+		// Cells with a changed type since the last call to updateDirtyRegions
+		std::vector<uint32_t> editedCells;
 	public:
 		int width;
 		int height;
-		std::vector<BspPartition*> partitionList;
-		std::vector< std::vector<Cell*> > cells;
-		Dungeon(int w, int h);
+		// Seed for generation, the same seed always results in the same dungeon
+		uint64_t seed;
+		// Dungeon level random stream (partition streams are forked from this)
+		Random random;
+		// Number of threads used for generation (1 = serial), the result doesn't depend on this
+		uint32_t threadCount = 1;
+		// Partition tree, released and rebuilt (reusing its memory) with every call to generateRooms
+		BspTree partitions;
+		// Indices of the leaf partitions
+		std::vector<int32_t> partitionList;
+		// Corridor layouts (see generateCorridors)
+		static const int corridorRoutingStraight = 0;
+		static const int corridorRoutingCostField = 1;
+		int corridorRouting = corridorRoutingCostField;
+		CorridorRouter corridorRouter;
+		/*
+			Flat structure-of-arrays cell grid, stored row by row (index = y * width + x)
+			Walls and doors are stored as bit masks using Cell::dirBit
+		*/
+		std::vector<uint8_t> cellTypes;
+		std::vector<uint8_t> cellWalls;
+		std::vector<uint8_t> cellDoors;
+		/*
+			Incremental edits
+			Edits mark the tiles around the changed cells as dirty, walls and doors of dirty tiles are recomputed by
+			updateDirtyRegions, which also collects the cells that actually changed (for the renderer, map, etc.)
+		*/
+		static const int dirtyTileSize = 16;
+		int dirtyTilesX;
+		int dirtyTilesY;
+		std::vector<uint8_t> dirtyTiles;
+		std::vector<uint32_t> dirtyTileList;
+		// Indices of the cells that changed with the last call to updateDirtyRegions (sorted, no duplicates)
+		std::vector<uint32_t> changedCells;
+		Dungeon(int w, int h, uint64_t seed = 0);
 		~Dungeon();
-		Cell* getCell(int x, int y);
+		inline uint32_t getCellIndex(int x, int y) const { return y * width + x; }
+		inline uint8_t getCellType(int x, int y) const { return cellTypes[getCellIndex(x, y)]; }
+		inline void setCellType(int x, int y, uint8_t type) { cellTypes[getCellIndex(x, y)] = type; }
+		inline bool hasWall(int x, int y, int dir) const { return (cellWalls[getCellIndex(x, y)] & Cell::dirBit(dir)) != 0; }
+		inline bool hasDoor(int x, int y, int dir) const { return (cellDoors[getCellIndex(x, y)] & Cell::dirBit(dir)) != 0; }
+		inline bool hasDoor(int x, int y) const { return cellDoors[getCellIndex(x, y)] != 0; }
+		// Wall and door masks as derived from the current cell types
+		uint8_t getWallMask(int x, int y) const;
+		uint8_t getDoorMask(int x, int y) const;
+		// Size of the cell grid in bytes
+		size_t getCellMemorySize() const;
 		void generateRooms();
+		void generateRooms(uint64_t seed);
+		/*
+			Connects the rooms along the partition tree, every node is connected to its child rooms and its parent once
+			Corridors are either straight walks (x first, then y) or routed over a cost field preferring existing corridors
+		*/
+		void generateCorridors();
+		// Reference version of the straight corridors, connects every room's whole chain up to the root (upper levels are carved many times)
+		void generateCorridorsRecursive();
+		// Carves a corridor from the start to the destination cell (moving along x first), room cells are kept
+		void carveCorridor(int startX, int startY, int destX, int destY);
+		// Wall and door generation, processing 64 cells at once using bit planes
 		void generateWalls();
 		void generateDoors();
+		// Scalar reference versions of the above (one cell at a time)
+		void generateWallsScalar();
+		void generateDoorsScalar();
+		/*
+			Sets the type of all cells in the given rectangle (inclusive, clipped to the grid)
+			Walls and doors of the rectangle and its direct neighbours are updated with the next call to updateDirtyRegions
+		*/
+		void setCellTypes(int left, int top, int right, int bottom, uint8_t type);
+		// Recomputes walls and doors for all dirty tiles, returns the number of changed cells (see changedCells)
+		size_t updateDirtyRegions();
+		// Discards pending edits and the last change list (e.g. when the cells are replaced as a whole)
+		void clearEdits();
+		// Returns a random leaf partition with a room (valid until the dungeon is regenerated), NULL if there are no rooms
 		BspPartition* getRandomRoom();
 	};
 
 }
-
@@ -0,0 +1,304 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "DungeonFile.h"
+#include "BitPlane.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace dungeongenerator {
+
+	static_assert(sizeof(DungeonFile::Header) == 72, "Unexpected level file header size");
+	static_assert(sizeof(DungeonFile::PartitionEntry) == 36, "Unexpected level file partition entry size");
+
+	static inline uint64_t alignOffset(uint64_t offset) { return (offset + 7) & ~(uint64_t)7; }
+
+	DungeonFile::DungeonFile()
+	{
+	}
+
+	DungeonFile::~DungeonFile()
+	{
+		close();
+	}
+
+	bool DungeonFile::save(const Dungeon &dungeon, const std::string &fileName)
+	{
+		const std::vector<BspPartition> &nodes = dungeon.partitions.nodes;
+
+		Header fileHeader = {};
+		fileHeader.magic = magic;
+		fileHeader.version = version;
+		fileHeader.width = dungeon.width;
+		fileHeader.height = dungeon.height;
+		fileHeader.seed = dungeon.seed;
+		fileHeader.chunkSize = chunkSize;
+		fileHeader.chunksX = (dungeon.width + chunkSize - 1) / chunkSize;
+		fileHeader.chunksY = (dungeon.height + chunkSize - 1) / chunkSize;
+		fileHeader.partitionCount = (uint32_t)nodes.size();
+		fileHeader.partitionTableOffset = sizeof(Header);
+		fileHeader.chunkTableOffset = alignOffset(fileHeader.partitionTableOffset + nodes.size() * sizeof(PartitionEntry));
+		const size_t chunkCount = (size_t)fileHeader.chunksX * fileHeader.chunksY;
+
+		std::vector<uint8_t> buffer(fileHeader.chunkTableOffset + chunkCount * sizeof(uint64_t), 0);
+
+		PartitionEntry *entries = (PartitionEntry*)(buffer.data() + fileHeader.partitionTableOffset);
+		for (size_t i = 0; i < nodes.size(); i++) {
+			const BspPartition &node = nodes[i];
+			PartitionEntry &entry = entries[i];
+			entry.parent = node.parent;
+			entry.firstChild = node.firstChild;
+			entry.left = node.left;
+			entry.right = node.right;
+			entry.top = node.top;
+			entry.bottom = node.bottom;
+			entry.centerX = node.centerX;
+			entry.centerY = node.centerY;
+			entry.splitIn = node.splitIn;
+			entry.depth = node.depth;
+			entry.hasRoom = node.hasRoom ? 1 : 0;
+			fileHeader.roomCount += node.hasRoom ? 1 : 0;
+		}
+
+		// Chunks without any non-empty cells are left out
+		std::vector<uint64_t> planes(planeCount * chunkSize);
+		for (uint32_t chunkY = 0; chunkY < fileHeader.chunksY; chunkY++) {
+			for (uint32_t chunkX = 0; chunkX < fileHeader.chunksX; chunkX++) {
+				std::fill(planes.begin(), planes.end(), 0);
+				const int x = chunkX * chunkSize;
+				const int count = std::min(dungeon.width - x, chunkSize);
+				uint64_t occupied = 0;
+				for (int row = 0; row < chunkSize; row++) {
+					const int y = chunkY * chunkSize + row;
+					if (y >= dungeon.height) {
+						break;
+					}
+					const size_t index = dungeon.getCellIndex(x, y);
+					BitPlane::packBit(&dungeon.cellTypes[index], count, 0, &planes[planeCorridors * chunkSize + row]);
+					BitPlane::packBit(&dungeon.cellTypes[index], count, 1, &planes[planeRooms * chunkSize + row]);
+					for (uint32_t dir = 0; dir < 4; dir++) {
+						BitPlane::packBit(&dungeon.cellWalls[index], count, dir, &planes[(planeWalls + dir) * chunkSize + row]);
+						BitPlane::packBit(&dungeon.cellDoors[index], count, dir, &planes[(planeDoors + dir) * chunkSize + row]);
+					}
+					occupied |= planes[planeCorridors * chunkSize + row] | planes[planeRooms * chunkSize + row];
+				}
+				if (occupied == 0) {
+					continue;
+				}
+				const uint64_t offset = buffer.size();
+				buffer.resize(offset + chunkDataSize);
+				memcpy(buffer.data() + offset, planes.data(), chunkDataSize);
+				memcpy(buffer.data() + fileHeader.chunkTableOffset + ((size_t)chunkY * fileHeader.chunksX + chunkX) * sizeof(uint64_t), &offset, sizeof(offset));
+			}
+		}
+
+		fileHeader.fileSize = buffer.size();
+		memcpy(buffer.data(), &fileHeader, sizeof(fileHeader));
+
+		FILE *file = fopen(fileName.c_str(), "wb");
+		if (!file) {
+			return false;
+		}
+		const bool written = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+		return (fclose(file) == 0) && written;
+	}
+
+	bool DungeonFile::open(const std::string &fileName)
+	{
+		close();
+
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		HANDLE mapping = nullptr;
+		const void *view = nullptr;
+		if (GetFileSizeEx(file, &fileSize) && (fileSize.QuadPart > 0)) {
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping) {
+				view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			}
+		}
+		if (!view) {
+			if (mapping) {
+				CloseHandle(mapping);
+			}
+			CloseHandle(file);
+			return false;
+		}
+		fileHandle = file;
+		mappingHandle = mapping;
+		data = (const uint8_t*)view;
+		size = (size_t)fileSize.QuadPart;
+#else
+		const int file = ::open(fileName.c_str(), O_RDONLY);
+		if (file < 0) {
+			return false;
+		}
+		struct stat fileStat;
+		void *view = MAP_FAILED;
+		if ((fstat(file, &fileStat) == 0) && (fileStat.st_size > 0)) {
+			view = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		}
+		// The mapping stays valid after closing the descriptor
+		::close(file);
+		if (view == MAP_FAILED) {
+			return false;
+		}
+		data = (const uint8_t*)view;
+		size = (size_t)fileStat.st_size;
+#endif
+
+		// Validate everything that is accessed later on, so cell access doesn't need any checks
+		header = (const Header*)data;
+		bool valid = (size >= sizeof(Header)) &&
+			(header->magic == magic) &&
+			(header->version == version) &&
+			(header->fileSize == size) &&
+			(header->chunkSize == (uint32_t)chunkSize) &&
+			(header->width > 0) && (header->height > 0) &&
+			(header->chunksX == (uint32_t)((header->width + chunkSize - 1) / chunkSize)) &&
+			(header->chunksY == (uint32_t)((header->height + chunkSize - 1) / chunkSize)) &&
+			(header->partitionTableOffset % 8 == 0) &&
+			(header->partitionTableOffset + (uint64_t)header->partitionCount * sizeof(PartitionEntry) <= size) &&
+			(header->chunkTableOffset % 8 == 0) &&
+			(header->chunkTableOffset + (uint64_t)header->chunksX * header->chunksY * sizeof(uint64_t) <= size);
+		if (valid) {
+			partitions = (const PartitionEntry*)(data + header->partitionTableOffset);
+			chunkTable = (const uint64_t*)(data + header->chunkTableOffset);
+			// Children are always stored after their parent, which also keeps tree walks from looping
+			uint32_t roomCount = 0;
+			for (uint32_t i = 0; (valid) && (i < header->partitionCount); i++) {
+				const PartitionEntry &entry = partitions[i];
+				const int32_t firstChild = entry.firstChild;
+				if ((firstChild >= 0) && ((firstChild <= (int32_t)i) || ((uint32_t)firstChild + 4 > header->partitionCount))) {
+					valid = false;
+					break;
+				}
+				// Only the first node is the root, every other node's parent is stored before it and points back to it
+				const bool parentValid = (i == 0) ? (entry.parent == -1) :
+					((entry.parent >= 0) && (entry.parent < (int32_t)i) && (partitions[entry.parent].firstChild >= 0) &&
+					(i >= (uint32_t)partitions[entry.parent].firstChild) && (i < (uint32_t)partitions[entry.parent].firstChild + 4));
+				// Bounds are inclusive of the grid's width and height (see BspTree), room centers are used as cell positions
+				const bool boundsValid = (entry.left >= 0) && (entry.left <= entry.right) && (entry.right <= header->width) &&
+					(entry.top >= 0) && (entry.top <= entry.bottom) && (entry.bottom <= header->height) &&
+					(entry.centerX >= entry.left) && (entry.centerX <= entry.right) && (entry.centerY >= entry.top) && (entry.centerY <= entry.bottom) &&
+					((!entry.hasRoom) || ((entry.centerX < header->width) && (entry.centerY < header->height)));
+				valid = parentValid && boundsValid;
+				roomCount += entry.hasRoom ? 1 : 0;
+			}
+			valid &= (roomCount == header->roomCount);
+			for (size_t i = 0; (valid) && (i < (size_t)header->chunksX * header->chunksY); i++) {
+				if ((chunkTable[i] != 0) && ((chunkTable[i] % 8 != 0) || (chunkTable[i] + chunkDataSize > size))) {
+					valid = false;
+					break;
+				}
+			}
+		}
+		if (!valid) {
+			close();
+		}
+		return valid;
+	}
+
+	void DungeonFile::close()
+	{
+		if (data) {
+#if defined(_WIN32)
+			UnmapViewOfFile(data);
+			CloseHandle((HANDLE)mappingHandle);
+			CloseHandle((HANDLE)fileHandle);
+			mappingHandle = nullptr;
+			fileHandle = nullptr;
+#else
+			munmap((void*)data, size);
+#endif
+		}
+		data = nullptr;
+		size = 0;
+		header = nullptr;
+		partitions = nullptr;
+		chunkTable = nullptr;
+	}
+
+	bool DungeonFile::unpack(Dungeon &dungeon) const
+	{
+		if ((!isOpen()) || (dungeon.width != header->width) || (dungeon.height != header->height)) {
+			return false;
+		}
+
+		dungeon.seed = header->seed;
+		dungeon.random = Random(header->seed);
+		dungeon.clearEdits();
+		std::fill(dungeon.cellTypes.begin(), dungeon.cellTypes.end(), (uint8_t)Cell::cellTypeEmpty);
+		std::fill(dungeon.cellWalls.begin(), dungeon.cellWalls.end(), 0);
+		std::fill(dungeon.cellDoors.begin(), dungeon.cellDoors.end(), 0);
+
+		const uint64_t zero = 0;
+		for (uint32_t chunkY = 0; chunkY < header->chunksY; chunkY++) {
+			for (uint32_t chunkX = 0; chunkX < header->chunksX; chunkX++) {
+				const uint64_t offset = chunkTable[chunkY * header->chunksX + chunkX];
+				if (offset == 0) {
+					continue;
+				}
+				const uint64_t *planes = (const uint64_t*)(data + offset);
+				const int x = chunkX * chunkSize;
+				const int count = std::min(dungeon.width - x, chunkSize);
+				for (int row = 0; row < chunkSize; row++) {
+					const int y = chunkY * chunkSize + row;
+					if (y >= dungeon.height) {
+						break;
+					}
+					const size_t index = dungeon.getCellIndex(x, y);
+					const uint64_t *types[4] = { &planes[planeCorridors * chunkSize + row], &planes[planeRooms * chunkSize + row], &zero, &zero };
+					const uint64_t *walls[4];
+					const uint64_t *doors[4];
+					for (uint32_t dir = 0; dir < 4; dir++) {
+						walls[dir] = &planes[(planeWalls + dir) * chunkSize + row];
+						doors[dir] = &planes[(planeDoors + dir) * chunkSize + row];
+					}
+					BitPlane::unpackOr(types, count, &dungeon.cellTypes[index]);
+					BitPlane::unpackOr(walls, count, &dungeon.cellWalls[index]);
+					BitPlane::unpackOr(doors, count, &dungeon.cellDoors[index]);
+				}
+			}
+		}
+
+		// Partition tree (the random streams of the partitions are not stored, they are only used during generation)
+		dungeon.partitions.clear();
+		dungeon.partitions.nodes.reserve(header->partitionCount);
+		for (uint32_t i = 0; i < header->partitionCount; i++) {
+			const PartitionEntry &entry = partitions[i];
+			BspPartition node(entry.parent, entry.left, entry.top, entry.right, entry.bottom, entry.splitIn, entry.depth, Random(header->seed));
+			node.firstChild = entry.firstChild;
+			node.centerX = entry.centerX;
+			node.centerY = entry.centerY;
+			node.hasRoom = entry.hasRoom != 0;
+			dungeon.partitions.nodes.push_back(node);
+		}
+		dungeon.partitionList.clear();
+		dungeon.partitions.getLeaves(dungeon.partitionList);
+
+		return true;
+	}
+
+}
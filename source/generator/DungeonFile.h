@@ -0,0 +1,137 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include "Dungeon.h"
+#include "CellAccessor.h"
+
+namespace dungeongenerator {
+
+	/*
+		Binary level file
+
+		Layout (little endian, all offsets are relative to the start of the file and aligned to 8 bytes):
+		- Header
+		- Partition table (one entry per node of the partition tree, in tree order)
+		- Chunk table (one offset per chunk, row by row, zero for chunks without any non-empty cells)
+		- Chunk data: the cells of a chunk are stored as bit planes with one 64 bit word per row and plane
+		  (corridors, rooms, walls north/south/west/east, doors north/south/west/east)
+
+		Files are memory mapped and accessed in place, nothing is parsed or copied on load
+	*/
+	class DungeonFile : public CellAccessor
+	{
+	public:
+		static const uint32_t magic = 0x4e474e44; // "DNGN"
+		static const uint32_t version = 1;
+		// Chunks are 64x64 cells, so each row of a plane is a single word
+		static const int chunkSize = 64;
+		static const uint32_t planeCorridors = 0;
+		static const uint32_t planeRooms = 1;
+		static const uint32_t planeWalls = 2;
+		static const uint32_t planeDoors = 6;
+		static const uint32_t planeCount = 10;
+		static const size_t chunkDataSize = planeCount * chunkSize * sizeof(uint64_t);
+
+		struct Header {
+			uint32_t magic;
+			uint32_t version;
+			int32_t width;
+			int32_t height;
+			uint64_t seed;
+			uint32_t chunkSize;
+			uint32_t chunksX;
+			uint32_t chunksY;
+			uint32_t partitionCount;
+			uint32_t roomCount;
+			uint32_t reserved;
+			uint64_t partitionTableOffset;
+			uint64_t chunkTableOffset;
+			uint64_t fileSize;
+		};
+
+		struct PartitionEntry {
+			int32_t parent;
+			int32_t firstChild;
+			int32_t left;
+			int32_t right;
+			int32_t top;
+			int32_t bottom;
+			int32_t centerX;
+			int32_t centerY;
+			uint8_t splitIn;
+			uint8_t depth;
+			uint8_t hasRoom;
+			uint8_t reserved;
+		};
+
+	private:
+		const uint8_t *data = nullptr;
+		size_t size = 0;
+#if defined(_WIN32)
+		void *fileHandle = nullptr;
+		void *mappingHandle = nullptr;
+#endif
+		const uint64_t *chunkTable = nullptr;
+		// Returns the planes of the chunk containing the given cell or null for empty chunks and positions outside of the level
+		inline const uint64_t* getChunkPlanes(int x, int y) const {
+			if ((x < 0) || (y < 0) || (x >= header->width) || (y >= header->height)) {
+				return nullptr;
+			}
+			const uint64_t offset = chunkTable[(y / chunkSize) * header->chunksX + (x / chunkSize)];
+			return (offset != 0) ? (const uint64_t*)(data + offset) : nullptr;
+		}
+		// Gathers bit x of the given row from count consecutive planes
+		static inline uint8_t getBits(const uint64_t *planes, uint32_t first, uint32_t count, int x, int y) {
+			uint8_t bits = 0;
+			for (uint32_t n = 0; n < count; n++) {
+				bits |= (uint8_t)(((planes[(first + n) * chunkSize + (y % chunkSize)] >> (x % chunkSize)) & 1) << n);
+			}
+			return bits;
+		}
+	public:
+		// Header of the opened file (points into the mapped file)
+		const Header *header = nullptr;
+		const PartitionEntry *partitions = nullptr;
+
+		DungeonFile();
+		~DungeonFile();
+
+		// Writes the dungeon to a level file, returns false if the file could not be written
+		static bool save(const Dungeon &dungeon, const std::string &fileName);
+
+		// Maps the file into memory and validates header, offsets and the partition tree, returns false if the file can't be used
+		bool open(const std::string &fileName);
+		void close();
+		inline bool isOpen() const { return data != nullptr; }
+
+		// Cell access directly on the mapped file (positions outside of the level are empty)
+		uint8_t getCellType(int x, int y) override {
+			const uint64_t *planes = getChunkPlanes(x, y);
+			return planes ? getBits(planes, planeCorridors, 2, x, y) : (uint8_t)Cell::cellTypeEmpty;
+		}
+		uint8_t getCellWalls(int x, int y) override {
+			const uint64_t *planes = getChunkPlanes(x, y);
+			return planes ? getBits(planes, planeWalls, 4, x, y) : 0;
+		}
+		uint8_t getCellDoors(int x, int y) override {
+			const uint64_t *planes = getChunkPlanes(x, y);
+			return planes ? getBits(planes, planeDoors, 4, x, y) : 0;
+		}
+
+		/*
+			Unpacks the level into a dungeon of the same size (e.g. for editing)
+			Cells, walls, doors and the partition tree are restored, the dungeon's seed is set to the level's seed
+		*/
+		bool unpack(Dungeon &dungeon) const;
+	};
+
+}
@@ -0,0 +1,295 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "DungeonMesh.h"
+#include <math.h>
+#include <algorithm>
+#include "threadpool.hpp"
+
+namespace dungeongenerator {
+
+	const uint32_t DungeonMesh::textureSetCount;
+	const uint32_t DungeonMesh::faceFloor;
+	const uint32_t DungeonMesh::faceWallNorth;
+	const uint32_t DungeonMesh::faceWallSouth;
+	const uint32_t DungeonMesh::faceWallWest;
+	const uint32_t DungeonMesh::faceWallEast;
+	const uint32_t DungeonMesh::faceCeiling;
+
+	uint32_t DungeonMesh::addVertex(Scratch &scratch, Chunk &chunk, uint32_t face, float x, float y, float z) const
+	{
+		// Corners are on the cell borders, so twice the position is an integer
+		const uint64_t level = (y == ceilingY) ? 1 : 0;
+		const uint64_t key = ((uint64_t)face << 61) | (level << 60) | (((uint64_t)lroundf(x * 2.0f) & 0x3fffffff) << 30) | ((uint64_t)lroundf(z * 2.0f) & 0x3fffffff);
+		auto it = scratch.vertexMap.find(key);
+		if (it != scratch.vertexMap.end()) {
+			return it->second;
+		}
+
+		/*
+			Same normals and texture coordinates as the renderer's cell mesh, with the texture coordinates along the
+			face taken from the world position (u increases to the right when looking at the face)
+		*/
+		const float v = (y - floorY) / (ceilingY - floorY);
+		Vertex vertex = { { x, y, z }, { 0.0f, 0.0f, 0.0f }, { 0.0f, v, 1.0f } };
+		switch (face) {
+		case faceFloor:
+		case faceCeiling:
+			vertex.normal[1] = -1.0f;
+			vertex.uv[0] = x + 0.5f;
+			vertex.uv[1] = z + 0.5f;
+			vertex.uv[2] = (face == faceFloor) ? 0.0f : 2.0f;
+			break;
+		case faceWallNorth:
+			vertex.normal[2] = 1.0f;
+			vertex.uv[0] = 0.5f - x;
+			break;
+		case faceWallSouth:
+			vertex.normal[2] = -1.0f;
+			vertex.uv[0] = x + 0.5f;
+			break;
+		case faceWallWest:
+			vertex.normal[0] = 1.0f;
+			vertex.uv[0] = z + 0.5f;
+			break;
+		case faceWallEast:
+			vertex.normal[0] = -1.0f;
+			vertex.uv[0] = 0.5f - z;
+			break;
+		}
+		const uint32_t index = (uint32_t)chunk.vertices.size();
+		chunk.vertices.push_back(vertex);
+		scratch.vertexMap[key] = index;
+		return index;
+	}
+
+	void DungeonMesh::addQuad(Scratch &scratch, Chunk &chunk, uint32_t face, const float *p0, const float *p1, const float *p2, const float *p3) const
+	{
+		const uint32_t i0 = addVertex(scratch, chunk, face, p0[0], p0[1], p0[2]);
+		const uint32_t i1 = addVertex(scratch, chunk, face, p1[0], p1[1], p1[2]);
+		const uint32_t i2 = addVertex(scratch, chunk, face, p2[0], p2[1], p2[2]);
+		const uint32_t i3 = addVertex(scratch, chunk, face, p3[0], p3[1], p3[2]);
+		const uint32_t quad[6] = { i0, i1, i2, i0, i2, i3 };
+		chunk.indices.insert(chunk.indices.end(), quad, quad + 6);
+	}
+
+	void DungeonMesh::addFloors(Scratch &scratch, CellAccessor &cells, Chunk &chunk, uint32_t textureSet, bool ceiling) const
+	{
+		// Greedy merging into rectangles: grow to the right first, then down as long as the whole row is free
+		const int w = chunk.right - chunk.left;
+		const int h = chunk.bottom - chunk.top;
+		std::vector<uint8_t> &mask = scratch.mask;
+		std::vector<uint8_t> &used = scratch.used;
+		mask.assign(w * h, 0);
+		used.assign(w * h, 0);
+		for (int y = 0; y < h; y++) {
+			for (int x = 0; x < w; x++) {
+				const uint8_t cellType = cells.getCellType(chunk.left + x, chunk.top + y);
+				mask[y * w + x] = ((cellType != Cell::cellTypeEmpty) && (getTextureSet(cellType) == textureSet)) ? 1 : 0;
+			}
+		}
+		const uint32_t face = ceiling ? faceCeiling : faceFloor;
+		const float y = ceiling ? ceilingY : floorY;
+		for (int top = 0; top < h; top++) {
+			for (int left = 0; left < w; left++) {
+				if ((!mask[top * w + left]) || (used[top * w + left])) {
+					continue;
+				}
+				int right = left + 1;
+				while ((right < w) && (mask[top * w + right]) && (!used[top * w + right])) {
+					right++;
+				}
+				int bottom = top + 1;
+				while (bottom < h) {
+					bool free = true;
+					for (int x = left; x < right; x++) {
+						if ((!mask[bottom * w + x]) || (used[bottom * w + x])) {
+							free = false;
+							break;
+						}
+					}
+					if (!free) {
+						break;
+					}
+					bottom++;
+				}
+				for (int row = top; row < bottom; row++) {
+					std::fill(used.begin() + row * w + left, used.begin() + row * w + right, 1);
+				}
+				const float x0 = chunk.left + left - 0.5f;
+				const float x1 = chunk.left + right - 0.5f;
+				const float z0 = chunk.top + top - 0.5f;
+				const float z1 = chunk.top + bottom - 0.5f;
+				const float p0[3] = { x0, y, z0 };
+				const float p1[3] = { x0, y, z1 };
+				const float p2[3] = { x1, y, z1 };
+				const float p3[3] = { x1, y, z0 };
+				addQuad(scratch, chunk, face, p0, p1, p2, p3);
+				chunk.cellFaceCount += (right - left) * (bottom - top);
+			}
+		}
+	}
+
+	void DungeonMesh::addWalls(Scratch &scratch, CellAccessor &cells, Chunk &chunk, uint32_t textureSet, uint32_t face) const
+	{
+		// Runs along x for north and south walls, along y for west and east walls
+		static const int directions[] = { 0, Cell::dirNorth, Cell::dirSouth, Cell::dirWest, Cell::dirEast };
+		const int dir = directions[face];
+		const bool alongX = (face == faceWallNorth) || (face == faceWallSouth);
+		const float offset = ((face == faceWallNorth) || (face == faceWallWest)) ? -0.5f : 0.5f;
+		const int lineCount = alongX ? chunk.bottom - chunk.top : chunk.right - chunk.left;
+		const int lineLength = alongX ? chunk.right - chunk.left : chunk.bottom - chunk.top;
+		for (int line = 0; line < lineCount; line++) {
+			int runStart = -1;
+			for (int i = 0; i <= lineLength; i++) {
+				bool wall = false;
+				if (i < lineLength) {
+					const int x = alongX ? chunk.left + i : chunk.left + line;
+					const int y = alongX ? chunk.top + line : chunk.top + i;
+					const uint8_t cellType = cells.getCellType(x, y);
+					wall = (cellType != Cell::cellTypeEmpty) && (getTextureSet(cellType) == textureSet) && (cells.hasWall(x, y, dir));
+				}
+				if (wall) {
+					if (runStart < 0) {
+						runStart = i;
+					}
+					continue;
+				}
+				if (runStart < 0) {
+					continue;
+				}
+				// Wall from the start of the run to the end of the last cell
+				const float position = (alongX ? chunk.top : chunk.left) + line + offset;
+				const float start = (alongX ? chunk.left : chunk.top) + runStart - 0.5f;
+				const float end = (alongX ? chunk.left : chunk.top) + i - 0.5f;
+				float p[4][3];
+				for (uint32_t corner = 0; corner < 4; corner++) {
+					const float along = ((corner == 0) || (corner == 1)) ? start : end;
+					p[corner][0] = alongX ? along : position;
+					p[corner][1] = ((corner == 0) || (corner == 3)) ? floorY : ceilingY;
+					p[corner][2] = alongX ? position : along;
+				}
+				addQuad(scratch, chunk, face, p[0], p[1], p[2], p[3]);
+				chunk.cellFaceCount += i - runStart;
+				runStart = -1;
+			}
+		}
+	}
+
+	void DungeonMesh::buildChunk(Scratch &scratch, CellAccessor &cells, Chunk &chunk) const
+	{
+		chunk.vertices.clear();
+		chunk.indices.clear();
+		chunk.cellFaceCount = 0;
+		chunk.minX = chunk.minY = INT32_MAX;
+		chunk.maxX = chunk.maxY = INT32_MIN;
+		scratch.vertexMap.clear();
+		for (int y = chunk.top; y < chunk.bottom; y++) {
+			for (int x = chunk.left; x < chunk.right; x++) {
+				if (cells.getCellType(x, y) != Cell::cellTypeEmpty) {
+					chunk.minX = std::min(chunk.minX, x);
+					chunk.minY = std::min(chunk.minY, y);
+					chunk.maxX = std::max(chunk.maxX, x);
+					chunk.maxY = std::max(chunk.maxY, y);
+				}
+			}
+		}
+		for (uint32_t i = 0; i < textureSetCount; i++) {
+			chunk.firstIndex[i] = (uint32_t)chunk.indices.size();
+			addFloors(scratch, cells, chunk, i, false);
+			for (uint32_t face = faceWallNorth; face <= faceWallEast; face++) {
+				addWalls(scratch, cells, chunk, i, face);
+			}
+			const uint32_t firstCeilingIndex = (uint32_t)chunk.indices.size();
+			addFloors(scratch, cells, chunk, i, true);
+			chunk.indexCount[i] = (uint32_t)chunk.indices.size() - chunk.firstIndex[i];
+			chunk.ceilingIndexCount[i] = (uint32_t)chunk.indices.size() - firstCeilingIndex;
+		}
+	}
+
+	void DungeonMesh::buildChunks(CellAccessor &cells, const std::vector<uint8_t> &buildList, vks::ThreadPool *threadPool)
+	{
+		// Chunks are interleaved between the threads, so chunks of dense and sparse areas are spread evenly
+		const size_t threadCount = threadPool ? std::max(threadPool->threads.size(), (size_t)1) : 1;
+		auto buildBlock = [this, &cells, &buildList, threadCount](size_t t) {
+			Scratch scratch;
+			for (size_t i = t; i < chunks.size(); i += threadCount) {
+				if (buildList[i]) {
+					buildChunk(scratch, cells, chunks[i]);
+				}
+			}
+		};
+		if (threadPool) {
+			for (size_t t = 0; t < threadCount; t++) {
+				threadPool->threads[t]->addJob([buildBlock, t] { buildBlock(t); });
+			}
+			threadPool->wait();
+		}
+		else {
+			buildBlock(0);
+		}
+	}
+
+	void DungeonMesh::build(CellAccessor &cells, int width, int height, int chunkSize, vks::ThreadPool *threadPool)
+	{
+		this->width = width;
+		this->height = height;
+		this->chunkSize = chunkSize;
+		chunksX = (width + chunkSize - 1) / chunkSize;
+		chunksY = (height + chunkSize - 1) / chunkSize;
+		chunks.resize(chunksX * chunksY);
+		for (int y = 0; y < chunksY; y++) {
+			for (int x = 0; x < chunksX; x++) {
+				Chunk &chunk = getChunk(x, y);
+				chunk.left = x * chunkSize;
+				chunk.top = y * chunkSize;
+				chunk.right = std::min(chunk.left + chunkSize, width);
+				chunk.bottom = std::min(chunk.top + chunkSize, height);
+			}
+		}
+		buildChunks(cells, std::vector<uint8_t>(chunks.size(), 1), threadPool);
+	}
+
+	uint32_t DungeonMesh::update(CellAccessor &cells, const std::vector<uint32_t> &changedCells, vks::ThreadPool *threadPool)
+	{
+		std::vector<uint8_t> dirty(chunks.size(), 0);
+		for (auto index : changedCells) {
+			dirty[(index / width / chunkSize) * chunksX + (index % width) / chunkSize] = 1;
+		}
+		buildChunks(cells, dirty, threadPool);
+		return (uint32_t)std::count(dirty.begin(), dirty.end(), (uint8_t)1);
+	}
+
+	size_t DungeonMesh::getVertexCount() const
+	{
+		size_t count = 0;
+		for (auto &chunk : chunks) {
+			count += chunk.vertices.size();
+		}
+		return count;
+	}
+
+	size_t DungeonMesh::getIndexCount() const
+	{
+		size_t count = 0;
+		for (auto &chunk : chunks) {
+			count += chunk.indices.size();
+		}
+		return count;
+	}
+
+	size_t DungeonMesh::getMemorySize() const
+	{
+		size_t size = chunks.capacity() * sizeof(Chunk);
+		for (auto &chunk : chunks) {
+			size += chunk.vertices.capacity() * sizeof(Vertex) + chunk.indices.capacity() * sizeof(uint32_t);
+		}
+		return size;
+	}
+
+}
@@ -0,0 +1,122 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include "CellAccessor.h"
+
+namespace vks {
+	class ThreadPool;
+}
+
+namespace dungeongenerator {
+
+	/*
+		Static geometry of the dungeon merged into one indexed mesh per square chunk of cells
+
+		Only faces drawn by the per cell renderer are generated (floor and ceiling of non-empty cells, walls where a
+		cell has one). Floors and ceilings of each texture set are merged into rectangles, walls into runs along the
+		grid lines. Texture coordinates are derived from the world position, so merged faces tile the texture like
+		single cells (with a repeating sampler) and corners shared by coplanar faces share their vertex.
+
+		The indices of a chunk are grouped by texture set, ceilings come last within each group so they can be left
+		out (top down view). Vertices are in world space, cell (x, y) is centered on (x, 0, y), the same as the
+		renderer's cell mesh.
+	*/
+	class DungeonMesh
+	{
+	public:
+		static const uint32_t textureSetCount = 2;
+		// Face types, walls in the order of the renderer's cell mesh
+		static const uint32_t faceFloor = 0;
+		static const uint32_t faceWallNorth = 1;
+		static const uint32_t faceWallSouth = 2;
+		static const uint32_t faceWallWest = 3;
+		static const uint32_t faceWallEast = 4;
+		static const uint32_t faceCeiling = 5;
+
+		// Same layout as the renderer's cell vertices, uv.z is the texture array layer
+		struct Vertex {
+			float position[3];
+			float normal[3];
+			float uv[3];
+		};
+
+		struct Chunk {
+			// Covered cells (right and bottom are exclusive)
+			int32_t left;
+			int32_t top;
+			int32_t right;
+			int32_t bottom;
+			// Bounds of the non-empty cells (inclusive), only valid if the chunk has indices
+			int32_t minX;
+			int32_t minY;
+			int32_t maxX;
+			int32_t maxY;
+			std::vector<Vertex> vertices;
+			// Indices into the chunk's vertices
+			std::vector<uint32_t> indices;
+			// Index range of each texture set, the last ceilingIndexCount indices of a range are ceilings
+			uint32_t firstIndex[textureSetCount];
+			uint32_t indexCount[textureSetCount];
+			uint32_t ceilingIndexCount[textureSetCount];
+			// Number of cell faces merged into the chunk's quads
+			uint32_t cellFaceCount;
+		};
+
+	private:
+		// Temporary data for building a chunk, one per thread
+		struct Scratch {
+			// Vertices of the chunk being built by face type and position (see addVertex)
+			std::unordered_map<uint64_t, uint32_t> vertexMap;
+			std::vector<uint8_t> mask;
+			std::vector<uint8_t> used;
+		};
+		uint32_t addVertex(Scratch &scratch, Chunk &chunk, uint32_t face, float x, float y, float z) const;
+		// Adds a quad with corners p0 to p3 (x, y, z each)
+		void addQuad(Scratch &scratch, Chunk &chunk, uint32_t face, const float *p0, const float *p1, const float *p2, const float *p3) const;
+		void addFloors(Scratch &scratch, CellAccessor &cells, Chunk &chunk, uint32_t textureSet, bool ceiling) const;
+		void addWalls(Scratch &scratch, CellAccessor &cells, Chunk &chunk, uint32_t textureSet, uint32_t face) const;
+		void buildChunk(Scratch &scratch, CellAccessor &cells, Chunk &chunk) const;
+		// Builds the chunks flagged in buildList, distributed over the threads of the pool (if any)
+		void buildChunks(CellAccessor &cells, const std::vector<uint8_t> &buildList, vks::ThreadPool *threadPool);
+	public:
+		int width = 0;
+		int height = 0;
+		int chunkSize = 16;
+		int chunksX = 0;
+		int chunksY = 0;
+		// Height of the floor and the ceiling
+		float floorY = 0.0f;
+		float ceilingY = -1.0f;
+		// Row major, chunksX * chunksY
+		std::vector<Chunk> chunks;
+
+		// Texture set used for a cell type (rooms and corridors have different texture sets)
+		static inline uint32_t getTextureSet(uint8_t cellType) { return (cellType == Cell::cellTypeCorridor) ? 1 : 0; }
+		/*
+			Builds the chunks for the cells from (0, 0) to (width - 1, height - 1)
+			With a thread pool the chunks are built in parallel, cells are then read from multiple threads
+		*/
+		void build(CellAccessor &cells, int width, int height, int chunkSize, vks::ThreadPool *threadPool = nullptr);
+		/*
+			Rebuilds the chunks containing any of the given cells (indexed y * width + x), e.g. after edits
+			Returns the number of rebuilt chunks
+		*/
+		uint32_t update(CellAccessor &cells, const std::vector<uint32_t> &changedCells, vks::ThreadPool *threadPool = nullptr);
+		inline Chunk& getChunk(int chunkX, int chunkY) { return chunks[chunkY * chunksX + chunkX]; }
+		size_t getVertexCount() const;
+		size_t getIndexCount() const;
+		// Memory used by the meshes in bytes
+		size_t getMemorySize() const;
+	};
+
+}
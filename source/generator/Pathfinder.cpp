@@ -0,0 +1,421 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "Pathfinder.h"
+#include <stdlib.h>
+#include <algorithm>
+#include "threadpool.hpp"
+
+namespace dungeongenerator {
+
+	const uint32_t Pathfinder::invalid;
+	const uint16_t Pathfinder::unreachable;
+	const uint32_t Pathfinder::landmarkCount;
+
+	static const int neighbourOffsets[4][2] = { { 0, -1 }, { 0, 1 }, { -1, 0 }, { 1, 0 } };
+
+	struct OpenNodeCompare {
+		inline bool operator()(const Pathfinder::QueryContext::OpenNode &a, const Pathfinder::QueryContext::OpenNode &b) const {
+			return (a.f != b.f) ? (a.f > b.f) : (a.g < b.g);
+		}
+	};
+
+	void Pathfinder::fillDistances(uint32_t regionIndex, uint32_t cell, uint16_t *distances, std::vector<uint32_t> &queue) const
+	{
+		const Region &region = regions[regionIndex];
+		const int width = dungeon->width;
+		std::fill(distances, distances + region.width * region.height, unreachable);
+		queue.clear();
+		queue.push_back(cell);
+		distances[(cell / width - region.top) * region.width + (cell % width - region.left)] = 0;
+		for (size_t i = 0; i < queue.size(); i++) {
+			const int x = queue[i] % width;
+			const int y = queue[i] / width;
+			const uint16_t distance = distances[(y - region.top) * region.width + (x - region.left)] + 1;
+			for (auto &offset : neighbourOffsets) {
+				const int nx = x + offset[0];
+				const int ny = y + offset[1];
+				if ((nx < region.left) || (ny < region.top) || (nx >= region.left + region.width) || (ny >= region.top + region.height)) {
+					continue;
+				}
+				const uint32_t neighbour = dungeon->getCellIndex(nx, ny);
+				uint16_t &neighbourDistance = distances[(ny - region.top) * region.width + (nx - region.left)];
+				if ((cellRegion[neighbour] == regionIndex) && (neighbourDistance == unreachable)) {
+					neighbourDistance = distance;
+					queue.push_back(neighbour);
+				}
+			}
+		}
+	}
+
+	void Pathfinder::getNodeDistances(uint32_t node, uint32_t *distances) const
+	{
+		std::fill(distances, distances + nodes.size(), invalid);
+		std::vector<QueryContext::OpenNode> openList = { { 0, 0, node } };
+		distances[node] = 0;
+		while (!openList.empty()) {
+			std::pop_heap(openList.begin(), openList.end(), OpenNodeCompare());
+			const QueryContext::OpenNode open = openList.back();
+			openList.pop_back();
+			if (open.g > distances[open.node]) {
+				continue;
+			}
+			const Node &current = nodes[open.node];
+			for (uint32_t i = current.firstEdge; i < current.firstEdge + current.edgeCount; i++) {
+				const uint32_t g = open.g + edges[i].cost;
+				if (g < distances[edges[i].node]) {
+					distances[edges[i].node] = g;
+					openList.push_back({ g, g, edges[i].node });
+					std::push_heap(openList.begin(), openList.end(), OpenNodeCompare());
+				}
+			}
+		}
+	}
+
+	void Pathfinder::followDistances(uint32_t regionIndex, const uint16_t *distances, uint32_t cell, std::vector<uint32_t> &path) const
+	{
+		const Region &region = regions[regionIndex];
+		const int width = dungeon->width;
+		uint16_t distance = distances[(cell / width - region.top) * region.width + (cell % width - region.left)];
+		while (distance > 0) {
+			const int x = cell % width;
+			const int y = cell / width;
+			for (auto &offset : neighbourOffsets) {
+				const int nx = x + offset[0];
+				const int ny = y + offset[1];
+				if ((nx < region.left) || (ny < region.top) || (nx >= region.left + region.width) || (ny >= region.top + region.height)) {
+					continue;
+				}
+				const uint32_t neighbour = dungeon->getCellIndex(nx, ny);
+				if ((cellRegion[neighbour] == regionIndex) && (distances[(ny - region.top) * region.width + (nx - region.left)] == distance - 1)) {
+					cell = neighbour;
+					break;
+				}
+			}
+			path.push_back(cell);
+			distance--;
+		}
+	}
+
+	void Pathfinder::build(const Dungeon &dungeon)
+	{
+		this->dungeon = &dungeon;
+		const int width = dungeon.width;
+		const int height = dungeon.height;
+		cellRegion.assign((size_t)width * height, invalid);
+		regions.clear();
+		nodes.clear();
+		edges.clear();
+		flowFields.clear();
+
+		/*
+			Regions: connected cells of the same type within a leaf partition
+			Leaf partitions cover the grid without overlapping (right and bottom are exclusive), cells not covered
+			by any leaf (if any) are put into regions spanning the whole grid
+		*/
+		std::vector<uint32_t> stack;
+		auto addRegions = [&](int left, int top, int right, int bottom) {
+			for (int y = top; y < bottom; y++) {
+				for (int x = left; x < right; x++) {
+					const uint32_t cell = dungeon.getCellIndex(x, y);
+					const uint8_t cellType = dungeon.cellTypes[cell];
+					if ((cellType == Cell::cellTypeEmpty) || (cellRegion[cell] != invalid)) {
+						continue;
+					}
+					const uint32_t regionIndex = (uint32_t)regions.size();
+					int minX = x, minY = y, maxX = x, maxY = y;
+					cellRegion[cell] = regionIndex;
+					stack.push_back(cell);
+					while (!stack.empty()) {
+						const int cx = stack.back() % width;
+						const int cy = stack.back() / width;
+						stack.pop_back();
+						minX = std::min(minX, cx);
+						minY = std::min(minY, cy);
+						maxX = std::max(maxX, cx);
+						maxY = std::max(maxY, cy);
+						for (auto &offset : neighbourOffsets) {
+							const int nx = cx + offset[0];
+							const int ny = cy + offset[1];
+							if ((nx < left) || (ny < top) || (nx >= right) || (ny >= bottom)) {
+								continue;
+							}
+							const uint32_t neighbour = dungeon.getCellIndex(nx, ny);
+							if ((dungeon.cellTypes[neighbour] == cellType) && (cellRegion[neighbour] == invalid)) {
+								cellRegion[neighbour] = regionIndex;
+								stack.push_back(neighbour);
+							}
+						}
+					}
+					regions.push_back({ minX, minY, maxX - minX + 1, maxY - minY + 1, cellType, 0, 0 });
+				}
+			}
+		};
+		for (auto index : dungeon.partitionList) {
+			const BspPartition &partition = dungeon.partitions[index];
+			addRegions(std::max(partition.left, 0), std::max(partition.top, 0), std::min(partition.right, width), std::min(partition.bottom, height));
+		}
+		addRegions(0, 0, width, height);
+
+		// Nodes: cells with a neighbour in another region
+		std::vector<uint32_t> cellNode((size_t)width * height, invalid);
+		for (uint32_t regionIndex = 0; regionIndex < regions.size(); regionIndex++) {
+			Region &region = regions[regionIndex];
+			region.firstNode = (uint32_t)nodes.size();
+			for (int y = region.top; y < region.top + region.height; y++) {
+				for (int x = region.left; x < region.left + region.width; x++) {
+					const uint32_t cell = dungeon.getCellIndex(x, y);
+					if (cellRegion[cell] != regionIndex) {
+						continue;
+					}
+					bool boundary = false;
+					for (auto &offset : neighbourOffsets) {
+						const int nx = x + offset[0];
+						const int ny = y + offset[1];
+						if ((nx >= 0) && (ny >= 0) && (nx < width) && (ny < height)) {
+							const uint32_t neighbourRegion = cellRegion[dungeon.getCellIndex(nx, ny)];
+							boundary |= (neighbourRegion != invalid) && (neighbourRegion != regionIndex);
+						}
+					}
+					if (boundary) {
+						cellNode[cell] = (uint32_t)nodes.size();
+						nodes.push_back({ cell, regionIndex, 0, 0, 0 });
+					}
+				}
+			}
+			region.nodeCount = (uint32_t)nodes.size() - region.firstNode;
+		}
+
+		// Flow fields and edges
+		for (auto &node : nodes) {
+			const Region &region = regions[node.region];
+			node.flowField = flowFields.size();
+			flowFields.resize(flowFields.size() + region.width * region.height);
+			fillDistances(node.region, node.cell, &flowFields[node.flowField], stack);
+
+			node.firstEdge = (uint32_t)edges.size();
+			const int x = node.cell % width;
+			const int y = node.cell / width;
+			for (auto &offset : neighbourOffsets) {
+				const int nx = x + offset[0];
+				const int ny = y + offset[1];
+				if ((nx >= 0) && (ny >= 0) && (nx < width) && (ny < height)) {
+					const uint32_t neighbour = dungeon.getCellIndex(nx, ny);
+					if ((cellRegion[neighbour] != invalid) && (cellRegion[neighbour] != node.region)) {
+						edges.push_back({ cellNode[neighbour], 1 });
+					}
+				}
+			}
+			for (uint32_t i = region.firstNode; i < region.firstNode + region.nodeCount; i++) {
+				if (nodes[i].cell != node.cell) {
+					edges.push_back({ i, getFlowDistance(node, nodes[i].cell) });
+				}
+			}
+			node.edgeCount = (uint32_t)edges.size() - node.firstEdge;
+		}
+
+		/*
+			Landmarks: the first one is the node farthest away from the first node, every further one is the node
+			farthest away from all landmarks chosen so far (unreachable nodes are skipped)
+		*/
+		landmarks.clear();
+		landmarkDistances.assign(landmarkCount * nodes.size(), invalid);
+		if (!nodes.empty()) {
+			std::vector<uint32_t> minDistances(nodes.size());
+			std::vector<uint32_t> distances(nodes.size());
+			getNodeDistances(0, minDistances.data());
+			for (uint32_t l = 0; l < landmarkCount; l++) {
+				uint32_t landmark = 0;
+				for (uint32_t i = 0; i < nodes.size(); i++) {
+					if ((minDistances[i] != invalid) && (minDistances[i] > minDistances[landmark])) {
+						landmark = i;
+					}
+				}
+				landmarks.push_back(landmark);
+				getNodeDistances(landmark, distances.data());
+				for (uint32_t i = 0; i < nodes.size(); i++) {
+					landmarkDistances[i * landmarkCount + l] = distances[i];
+					minDistances[i] = std::min(minDistances[i], distances[i]);
+				}
+			}
+		}
+
+		// Scratch memory of existing contexts is sized for the previous graph
+		contexts.clear();
+	}
+
+	bool Pathfinder::findPath(int startX, int startY, int destX, int destY, std::vector<uint32_t> &path, QueryContext &context) const
+	{
+		path.clear();
+		const int width = dungeon->width;
+		const int height = dungeon->height;
+		if ((startX < 0) || (startY < 0) || (destX < 0) || (destY < 0) || (startX >= width) || (startY >= height) || (destX >= width) || (destY >= height)) {
+			return false;
+		}
+		const uint32_t start = dungeon->getCellIndex(startX, startY);
+		const uint32_t dest = dungeon->getCellIndex(destX, destY);
+		const uint32_t startRegion = cellRegion[start];
+		const uint32_t destRegion = cellRegion[dest];
+		if ((startRegion == invalid) || (destRegion == invalid)) {
+			return false;
+		}
+
+		// Start and destination in the same region: search within the region only
+		if (startRegion == destRegion) {
+			const Region &region = regions[destRegion];
+			context.distances.resize(region.width * region.height);
+			fillDistances(destRegion, dest, context.distances.data(), context.queue);
+			path.push_back(start);
+			followDistances(destRegion, context.distances.data(), start, path);
+			return true;
+		}
+
+		// A* over the abstract graph, the destination is a virtual node reached from the nodes of the destination region
+		const uint32_t goal = (uint32_t)nodes.size();
+		if (context.cost.size() != nodes.size() + 1) {
+			context.cost.assign(nodes.size() + 1, 0);
+			context.parent.assign(nodes.size() + 1, invalid);
+			context.visitStamp.assign(nodes.size() + 1, 0);
+			context.stamp = 0;
+		}
+		if (++context.stamp == 0) {
+			std::fill(context.visitStamp.begin(), context.visitStamp.end(), 0);
+			context.stamp = 1;
+		}
+		context.openList.clear();
+
+		// Landmark distances of the destination (through the nodes of its region)
+		const Region &targetRegion = regions[destRegion];
+		for (uint32_t l = 0; l < landmarkCount; l++) {
+			context.landmarkDistances[l] = invalid;
+		}
+		for (uint32_t i = targetRegion.firstNode; i < targetRegion.firstNode + targetRegion.nodeCount; i++) {
+			const uint16_t flowDistance = getFlowDistance(nodes[i], dest);
+			const uint32_t *distances = &landmarkDistances[i * landmarkCount];
+			for (uint32_t l = 0; l < landmarkCount; l++) {
+				if ((distances[l] != invalid) && (flowDistance != unreachable)) {
+					context.landmarkDistances[l] = std::min(context.landmarkDistances[l], distances[l] + flowDistance);
+				}
+			}
+		}
+
+		auto relax = [&](uint32_t node, uint32_t g, uint32_t parent) {
+			if ((context.visitStamp[node] == context.stamp) && (g >= context.cost[node])) {
+				return;
+			}
+			context.visitStamp[node] = context.stamp;
+			context.cost[node] = g;
+			context.parent[node] = parent;
+			uint32_t h = 0;
+			if (node != goal) {
+				const uint32_t cell = nodes[node].cell;
+				h = abs((int)(cell % width) - destX) + abs((int)(cell / width) - destY);
+				const uint32_t *distances = &landmarkDistances[node * landmarkCount];
+				for (uint32_t l = 0; l < landmarkCount; l++) {
+					const uint32_t a = distances[l];
+					const uint32_t b = context.landmarkDistances[l];
+					if ((a != invalid) && (b != invalid)) {
+						h = std::max(h, (a > b) ? a - b : b - a);
+					}
+				}
+			}
+			context.openList.push_back({ g + h, g, node });
+			std::push_heap(context.openList.begin(), context.openList.end(), OpenNodeCompare());
+		};
+
+		const Region &region = regions[startRegion];
+		for (uint32_t i = region.firstNode; i < region.firstNode + region.nodeCount; i++) {
+			relax(i, getFlowDistance(nodes[i], start), invalid);
+		}
+
+		bool found = false;
+		while (!context.openList.empty()) {
+			std::pop_heap(context.openList.begin(), context.openList.end(), OpenNodeCompare());
+			const QueryContext::OpenNode open = context.openList.back();
+			context.openList.pop_back();
+			if (open.g > context.cost[open.node]) {
+				continue;
+			}
+			if (open.node == goal) {
+				found = true;
+				break;
+			}
+			const Node &node = nodes[open.node];
+			if (node.region == destRegion) {
+				relax(goal, open.g + getFlowDistance(node, dest), open.node);
+			}
+			for (uint32_t i = node.firstEdge; i < node.firstEdge + node.edgeCount; i++) {
+				relax(edges[i].node, open.g + edges[i].cost, open.node);
+			}
+		}
+		if (!found) {
+			return false;
+		}
+
+		context.abstractPath.clear();
+		for (uint32_t node = context.parent[goal]; node != invalid; node = context.parent[node]) {
+			context.abstractPath.push_back(node);
+		}
+		std::reverse(context.abstractPath.begin(), context.abstractPath.end());
+
+		// Refine: follow the flow fields from node to node, neighbouring nodes in different regions are adjacent cells
+		path.push_back(start);
+		followFlowField(nodes[context.abstractPath[0]], start, path);
+		for (size_t i = 1; i < context.abstractPath.size(); i++) {
+			const Node &from = nodes[context.abstractPath[i - 1]];
+			const Node &to = nodes[context.abstractPath[i]];
+			if (from.region == to.region) {
+				followFlowField(to, from.cell, path);
+			}
+			else {
+				path.push_back(to.cell);
+			}
+		}
+		// The last node's flow field leads from the destination to the node, so this part is walked backwards
+		context.segment.clear();
+		context.segment.push_back(dest);
+		followFlowField(nodes[context.abstractPath.back()], dest, context.segment);
+		path.insert(path.end(), context.segment.rbegin() + 1, context.segment.rend());
+
+		return true;
+	}
+
+	void Pathfinder::findPaths(std::vector<Request> &requests, vks::ThreadPool *threadPool)
+	{
+		const size_t threadCount = threadPool ? std::max(threadPool->threads.size(), (size_t)1) : 1;
+		if (contexts.size() < threadCount) {
+			contexts.resize(threadCount);
+		}
+		if (!threadPool) {
+			for (auto &request : requests) {
+				findPath(request.startX, request.startY, request.destX, request.destY, request.path, contexts[0]);
+			}
+			return;
+		}
+		const size_t blockSize = (requests.size() + threadCount - 1) / threadCount;
+		for (size_t t = 0; t < threadCount; t++) {
+			const size_t first = std::min(t * blockSize, requests.size());
+			const size_t last = std::min(first + blockSize, requests.size());
+			QueryContext *context = &contexts[t];
+			threadPool->threads[t]->addJob([this, &requests, first, last, context] {
+				for (size_t i = first; i < last; i++) {
+					Request &request = requests[i];
+					findPath(request.startX, request.startY, request.destX, request.destY, request.path, *context);
+				}
+			});
+		}
+		threadPool->wait();
+	}
+
+	size_t Pathfinder::getMemorySize() const
+	{
+		return cellRegion.capacity() * sizeof(uint32_t) + regions.capacity() * sizeof(Region) + nodes.capacity() * sizeof(Node) +
+			edges.capacity() * sizeof(Edge) + flowFields.capacity() * sizeof(uint16_t) + landmarkDistances.capacity() * sizeof(uint32_t);
+	}
+
+}
@@ -0,0 +1,141 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include "Dungeon.h"
+
+namespace vks {
+	class ThreadPool;
+}
+
+namespace dungeongenerator {
+
+	/*
+		Hierarchical path finding on a dungeon (HPA*)
+
+		The leaf partitions of the dungeon are used as clusters. The non-empty cells of a leaf are split into regions
+		(connected room cells and connected corridor cells), so rooms and the corridor pieces leading to them are
+		separate regions that meet at doors.
+
+		Every cell next to a cell of another region is a node of the abstract graph. Nodes are connected to their
+		neighbours in other regions and to all other nodes of their own region. For each node a flow field
+		(distance of every cell of the region to the node) is built and cached, it gives the costs of the edges
+		within the region and is used to turn the abstract path back into cells.
+
+		The abstract search uses the larger of the Manhattan distance and a landmark bound (ALT) as its heuristic:
+		distances from a few landmark nodes to all other nodes are stored, by the triangle inequality
+		|d(landmark, n) - d(landmark, dest)| never overestimates the distance between n and dest. Corridors
+		rarely lead straight to the destination, so this cuts the number of expanded nodes a lot.
+
+		Queries only read the graph, so any number of queries can run in parallel (each thread with its own context).
+		The graph has to be rebuilt after the dungeon has been changed.
+	*/
+	class Pathfinder
+	{
+	public:
+		static const uint32_t invalid = 0xffffffff;
+		static const uint16_t unreachable = 0xffff;
+		static const uint32_t landmarkCount = 8;
+
+		struct Region {
+			// Bounding rectangle (the flow fields of the region's nodes cover this area)
+			int32_t left;
+			int32_t top;
+			int32_t width;
+			int32_t height;
+			uint8_t cellType;
+			uint32_t firstNode;
+			uint32_t nodeCount;
+		};
+
+		struct Node {
+			uint32_t cell;
+			uint32_t region;
+			uint32_t firstEdge;
+			uint32_t edgeCount;
+			size_t flowField;
+		};
+
+		struct Edge {
+			uint32_t node;
+			uint32_t cost;
+		};
+
+		struct Request {
+			int startX;
+			int startY;
+			int destX;
+			int destY;
+			// Cell indices from start to destination (both included), empty if there is no path
+			std::vector<uint32_t> path;
+		};
+
+		// Scratch memory of a single query, contexts can't be shared between threads
+		struct QueryContext {
+			struct OpenNode {
+				uint32_t f;
+				uint32_t g;
+				uint32_t node;
+			};
+			std::vector<OpenNode> openList;
+			std::vector<uint32_t> cost;
+			std::vector<uint32_t> parent;
+			std::vector<uint32_t> visitStamp;
+			uint32_t stamp = 0;
+			std::vector<uint32_t> abstractPath;
+			std::vector<uint16_t> distances;
+			std::vector<uint32_t> queue;
+			std::vector<uint32_t> segment;
+			uint32_t landmarkDistances[landmarkCount];
+		};
+
+	private:
+		const Dungeon *dungeon = nullptr;
+		std::vector<QueryContext> contexts;
+		// Distance of the cell to the node's cell, looked up in the node's flow field
+		inline uint16_t getFlowDistance(const Node &node, uint32_t cell) const {
+			const Region &region = regions[node.region];
+			const int x = cell % dungeon->width - region.left;
+			const int y = cell / dungeon->width - region.top;
+			return flowFields[node.flowField + y * region.width + x];
+		}
+		// Breadth first search from the given cell over all cells of its region, distances are stored in the region's rectangle
+		void fillDistances(uint32_t region, uint32_t cell, uint16_t *distances, std::vector<uint32_t> &queue) const;
+		// Distances from the given node to all nodes of the abstract graph (invalid for unreachable nodes)
+		void getNodeDistances(uint32_t node, uint32_t *distances) const;
+		// Appends the cells from the given cell down to distance zero (excluding the given cell)
+		void followDistances(uint32_t region, const uint16_t *distances, uint32_t cell, std::vector<uint32_t> &path) const;
+		// Appends the cells from the given cell down the flow field of the node (excluding the given cell, including the node's cell)
+		inline void followFlowField(const Node &node, uint32_t cell, std::vector<uint32_t> &path) const {
+			followDistances(node.region, &flowFields[node.flowField], cell, path);
+		}
+	public:
+		// Region of every cell, invalid for empty cells
+		std::vector<uint32_t> cellRegion;
+		std::vector<Region> regions;
+		std::vector<Node> nodes;
+		std::vector<Edge> edges;
+		std::vector<uint16_t> flowFields;
+		// Distances of all nodes to the landmarks (landmarkCount values per node)
+		std::vector<uint32_t> landmarks;
+		std::vector<uint32_t> landmarkDistances;
+
+		// Builds the abstract graph and the flow fields for the current state of the dungeon
+		void build(const Dungeon &dungeon);
+		// Finds a path between two cells, returns false if there is none (path is empty then)
+		bool findPath(int startX, int startY, int destX, int destY, std::vector<uint32_t> &path, QueryContext &context) const;
+		// Answers all requests, distributed over the threads of the pool if one is passed
+		void findPaths(std::vector<Request> &requests, vks::ThreadPool *threadPool = nullptr);
+		// Memory used by the graph and the flow fields in bytes
+		size_t getMemorySize() const;
+	};
+
+}
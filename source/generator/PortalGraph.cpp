@@ -0,0 +1,283 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "PortalGraph.h"
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+
+namespace dungeongenerator {
+
+	const uint32_t PortalGraph::invalid;
+
+	static const int neighbourOffsets[4][2] = { { 0, -1 }, { 0, 1 }, { -1, 0 }, { 1, 0 } };
+
+	static inline bool intersectRects(const PortalGraph::Rect &a, const PortalGraph::Rect &b, PortalGraph::Rect &result)
+	{
+		result.minX = std::max(a.minX, b.minX);
+		result.minY = std::max(a.minY, b.minY);
+		result.maxX = std::min(a.maxX, b.maxX);
+		result.maxY = std::min(a.maxY, b.maxY);
+		return (result.minX <= result.maxX) && (result.minY <= result.maxY);
+	}
+
+	void PortalGraph::addPortals(const Dungeon &dungeon, int dx, int dy)
+	{
+		// Lines run along y for portals between west and east neighbours and along x for north and south neighbours
+		const int lineCount = (dx != 0) ? dungeon.width - 1 : dungeon.height - 1;
+		const int lineLength = (dx != 0) ? dungeon.height : dungeon.width;
+		const uint8_t doorBit = Cell::dirBit((dx != 0) ? Cell::dirEast : Cell::dirSouth);
+		const uint8_t neighbourDoorBit = Cell::dirBit((dx != 0) ? Cell::dirWest : Cell::dirNorth);
+		for (int line = 0; line < lineCount; line++) {
+			int runStart = 0;
+			uint32_t runSectors[2] = { invalid, invalid };
+			bool runDoor = false;
+			for (int i = 0; i <= lineLength; i++) {
+				uint32_t a = invalid;
+				uint32_t b = invalid;
+				bool door = false;
+				if (i < lineLength) {
+					const int x = (dx != 0) ? line : i;
+					const int y = (dx != 0) ? i : line;
+					const uint32_t cell = dungeon.getCellIndex(x, y);
+					const uint32_t neighbour = dungeon.getCellIndex(x + dx, y + dy);
+					a = cellSector[cell];
+					b = cellSector[neighbour];
+					if ((a == b) || (b == invalid)) {
+						a = b = invalid;
+					}
+					door = ((dungeon.cellDoors[cell] & doorBit) != 0) || ((dungeon.cellDoors[neighbour] & neighbourDoorBit) != 0);
+				}
+				if ((a == runSectors[0]) && (b == runSectors[1])) {
+					runDoor |= door;
+					continue;
+				}
+				// Close the current run
+				if (runSectors[0] != invalid) {
+					const float position = line + 0.5f;
+					const float start = runStart - 0.5f;
+					const float end = i - 0.5f;
+					Portal portal;
+					portal.x0 = (dx != 0) ? position : start;
+					portal.z0 = (dx != 0) ? start : position;
+					portal.x1 = (dx != 0) ? position : end;
+					portal.z1 = (dx != 0) ? end : position;
+					portal.sectors[0] = runSectors[0];
+					portal.sectors[1] = runSectors[1];
+					portal.door = runDoor;
+					portals.push_back(portal);
+				}
+				runStart = i;
+				runSectors[0] = a;
+				runSectors[1] = b;
+				runDoor = door;
+			}
+		}
+	}
+
+	void PortalGraph::build(const Dungeon &dungeon)
+	{
+		width = dungeon.width;
+		height = dungeon.height;
+		cellSector.assign((size_t)width * height, invalid);
+		sectors.clear();
+		portals.clear();
+		sectorPortals.clear();
+
+		/*
+			Sectors: connected cells of the same type within a leaf partition
+			Leaf partitions cover the grid without overlapping (right and bottom are exclusive), cells not covered
+			by any leaf (if any) are put into sectors spanning the whole grid
+		*/
+		std::vector<uint32_t> stack;
+		auto addSectors = [&](int left, int top, int right, int bottom) {
+			for (int y = top; y < bottom; y++) {
+				for (int x = left; x < right; x++) {
+					const uint32_t cell = dungeon.getCellIndex(x, y);
+					const uint8_t cellType = dungeon.cellTypes[cell];
+					if ((cellType == Cell::cellTypeEmpty) || (cellSector[cell] != invalid)) {
+						continue;
+					}
+					const uint32_t sectorIndex = (uint32_t)sectors.size();
+					int minX = x, minY = y, maxX = x, maxY = y;
+					cellSector[cell] = sectorIndex;
+					stack.push_back(cell);
+					while (!stack.empty()) {
+						const int cx = stack.back() % width;
+						const int cy = stack.back() / width;
+						stack.pop_back();
+						minX = std::min(minX, cx);
+						minY = std::min(minY, cy);
+						maxX = std::max(maxX, cx);
+						maxY = std::max(maxY, cy);
+						for (auto &offset : neighbourOffsets) {
+							const int nx = cx + offset[0];
+							const int ny = cy + offset[1];
+							if ((nx < left) || (ny < top) || (nx >= right) || (ny >= bottom)) {
+								continue;
+							}
+							const uint32_t neighbour = dungeon.getCellIndex(nx, ny);
+							if ((dungeon.cellTypes[neighbour] == cellType) && (cellSector[neighbour] == invalid)) {
+								cellSector[neighbour] = sectorIndex;
+								stack.push_back(neighbour);
+							}
+						}
+					}
+					sectors.push_back({ minX, minY, maxX, maxY, cellType, 0, 0 });
+				}
+			}
+		};
+		for (auto index : dungeon.partitionList) {
+			const BspPartition &partition = dungeon.partitions[index];
+			addSectors(std::max(partition.left, 0), std::max(partition.top, 0), std::min(partition.right, width), std::min(partition.bottom, height));
+		}
+		addSectors(0, 0, width, height);
+
+		// Portals: runs of open faces between the same two sectors
+		addPortals(dungeon, 1, 0);
+		addPortals(dungeon, 0, 1);
+
+		for (auto &portal : portals) {
+			sectors[portal.sectors[0]].portalCount++;
+			sectors[portal.sectors[1]].portalCount++;
+		}
+		uint32_t firstPortal = 0;
+		for (auto &sector : sectors) {
+			sector.firstPortal = firstPortal;
+			firstPortal += sector.portalCount;
+			sector.portalCount = 0;
+		}
+		sectorPortals.resize(firstPortal);
+		for (uint32_t i = 0; i < portals.size(); i++) {
+			for (auto sectorIndex : portals[i].sectors) {
+				Sector &sector = sectors[sectorIndex];
+				sectorPortals[sector.firstPortal + sector.portalCount++] = i;
+			}
+		}
+
+		sectorStamps.assign(sectors.size(), 0);
+		sectorRects.resize(sectors.size());
+		queued.assign(sectors.size(), 0);
+		stamp = 0;
+		visibleSectors.clear();
+	}
+
+	bool PortalGraph::projectBox(const float *m, const float *boxMin, const float *boxMax, Rect &rect)
+	{
+		rect = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+		uint32_t behind = 0;
+		for (uint32_t i = 0; i < 8; i++) {
+			const float x = (i & 1) ? boxMax[0] : boxMin[0];
+			const float y = (i & 2) ? boxMax[1] : boxMin[1];
+			const float z = (i & 4) ? boxMax[2] : boxMin[2];
+			const float w = m[3] * x + m[7] * y + m[11] * z + m[15];
+			if (w <= 1e-5f) {
+				behind++;
+				continue;
+			}
+			const float ndcX = (m[0] * x + m[4] * y + m[8] * z + m[12]) / w;
+			const float ndcY = (m[1] * x + m[5] * y + m[9] * z + m[13]) / w;
+			rect.minX = std::min(rect.minX, ndcX);
+			rect.minY = std::min(rect.minY, ndcY);
+			rect.maxX = std::max(rect.maxX, ndcX);
+			rect.maxY = std::max(rect.maxY, ndcY);
+		}
+		if (behind == 8) {
+			return false;
+		}
+		const Rect screen = { -1.0f, -1.0f, 1.0f, 1.0f };
+		if (behind > 0) {
+			rect = screen;
+			return true;
+		}
+		return intersectRects(rect, screen, rect);
+	}
+
+	bool PortalGraph::traverse(const float *viewProjection, float eyeX, float eyeZ, float maxDistance)
+	{
+		visibleSectors.clear();
+		portalsPassed = 0;
+		if (++stamp == 0) {
+			std::fill(sectorStamps.begin(), sectorStamps.end(), 0);
+			stamp = 1;
+		}
+		const int cellX = (int)floorf(eyeX + 0.5f);
+		const int cellY = (int)floorf(eyeZ + 0.5f);
+		if ((cellX < 0) || (cellY < 0) || (cellX >= width) || (cellY >= height) || (cellSector[cellY * width + cellX] == invalid)) {
+			return false;
+		}
+
+		// Sectors are queued again whenever the rectangle they're seen through grows (if reached through several portals)
+		const uint32_t startSector = cellSector[cellY * width + cellX];
+		sectorStamps[startSector] = stamp;
+		sectorRects[startSector] = { -1.0f, -1.0f, 1.0f, 1.0f };
+		visibleSectors.push_back(startSector);
+		queue.clear();
+		queue.push_back(startSector);
+		queued[startSector] = 1;
+		for (size_t head = 0; head < queue.size(); head++) {
+			const uint32_t sectorIndex = queue[head];
+			queued[sectorIndex] = 0;
+			const Sector &sector = sectors[sectorIndex];
+			for (uint32_t i = 0; i < sector.portalCount; i++) {
+				const Portal &portal = portals[sectorPortals[sector.firstPortal + i]];
+				const uint32_t neighbour = (portal.sectors[0] == sectorIndex) ? portal.sectors[1] : portal.sectors[0];
+				// Portals are axis aligned, so the closest point is the clamped eye position
+				const float closestX = std::min(std::max(eyeX, std::min(portal.x0, portal.x1)), std::max(portal.x0, portal.x1));
+				const float closestZ = std::min(std::max(eyeZ, std::min(portal.z0, portal.z1)), std::max(portal.z0, portal.z1));
+				if ((closestX - eyeX) * (closestX - eyeX) + (closestZ - eyeZ) * (closestZ - eyeZ) > maxDistance * maxDistance) {
+					continue;
+				}
+				const float portalMin[3] = { std::min(portal.x0, portal.x1), minY, std::min(portal.z0, portal.z1) };
+				const float portalMax[3] = { std::max(portal.x0, portal.x1), maxY, std::max(portal.z0, portal.z1) };
+				Rect rect;
+				if ((!projectBox(viewProjection, portalMin, portalMax, rect)) || (!intersectRects(rect, sectorRects[sectorIndex], rect))) {
+					continue;
+				}
+				portalsPassed++;
+				Rect &neighbourRect = sectorRects[neighbour];
+				if (sectorStamps[neighbour] != stamp) {
+					sectorStamps[neighbour] = stamp;
+					neighbourRect = rect;
+					visibleSectors.push_back(neighbour);
+				}
+				else if ((rect.minX < neighbourRect.minX) || (rect.minY < neighbourRect.minY) || (rect.maxX > neighbourRect.maxX) || (rect.maxY > neighbourRect.maxY)) {
+					neighbourRect.minX = std::min(neighbourRect.minX, rect.minX);
+					neighbourRect.minY = std::min(neighbourRect.minY, rect.minY);
+					neighbourRect.maxX = std::max(neighbourRect.maxX, rect.maxX);
+					neighbourRect.maxY = std::max(neighbourRect.maxY, rect.maxY);
+				}
+				else {
+					continue;
+				}
+				if (!queued[neighbour]) {
+					queued[neighbour] = 1;
+					queue.push_back(neighbour);
+				}
+			}
+		}
+		return true;
+	}
+
+	bool PortalGraph::isBoxVisible(uint32_t cell, const float *boxMin, const float *boxMax, const float *viewProjection) const
+	{
+		const uint32_t sector = cellSector[cell];
+		if (!isSectorVisible(sector)) {
+			return false;
+		}
+		Rect rect;
+		return projectBox(viewProjection, boxMin, boxMax, rect) && intersectRects(rect, sectorRects[sector], rect);
+	}
+
+	size_t PortalGraph::getMemorySize() const
+	{
+		return cellSector.capacity() * sizeof(uint32_t) + sectors.capacity() * sizeof(Sector) + portals.capacity() * sizeof(Portal) +
+			sectorPortals.capacity() * sizeof(uint32_t) + sectorStamps.capacity() * sizeof(uint32_t) + sectorRects.capacity() * sizeof(Rect);
+	}
+
+}
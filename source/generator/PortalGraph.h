@@ -0,0 +1,111 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include "Dungeon.h"
+
+namespace dungeongenerator {
+
+	/*
+		Portal graph for occlusion culling
+
+		The non-empty cells of each leaf partition are split into sectors (the partition's room and the connected
+		corridor pieces), sectors are connected by portals: the open faces between cells of two sectors, merged into
+		straight runs. Portals between a room and a corridor are the doors found by Dungeon::generateDoors, corridors
+		running along a room or crossing partition borders give wider portals.
+
+		Each frame the graph is traversed from the viewer's sector. Every portal is projected to the screen and
+		clipped against the screen rectangle through which its sector is seen, sectors behind a portal are only seen
+		through the clipped rectangle. Cells of sectors that aren't reached or that don't overlap their sector's
+		rectangle can't be visible.
+
+		Positions are in world space, cell (x, y) is centered on (x, z = y). Matrices are column major (as in glm).
+	*/
+	class PortalGraph
+	{
+	public:
+		static const uint32_t invalid = 0xffffffff;
+
+		// Screen rectangle in normalized device coordinates
+		struct Rect {
+			float minX;
+			float minY;
+			float maxX;
+			float maxY;
+		};
+
+		struct Sector {
+			// Bounding rectangle (inclusive)
+			int32_t left;
+			int32_t top;
+			int32_t right;
+			int32_t bottom;
+			uint8_t cellType;
+			// Portals of the sector in sectorPortals
+			uint32_t firstPortal;
+			uint32_t portalCount;
+		};
+
+		// Opening between two sectors, a line on the cell grid from (x0, z0) to (x1, z1)
+		struct Portal {
+			float x0;
+			float z0;
+			float x1;
+			float z1;
+			uint32_t sectors[2];
+			bool door;
+		};
+
+	private:
+		std::vector<uint32_t> sectorStamps;
+		uint32_t stamp = 0;
+		std::vector<uint32_t> queue;
+		std::vector<uint8_t> queued;
+		// Adds the portals along one grid line, the neighbouring cell of (x, y) is (x + dx, y + dy)
+		void addPortals(const Dungeon &dungeon, int dx, int dy);
+	public:
+		int width = 0;
+		int height = 0;
+		// Vertical extent of the portals in world space
+		float minY = -2.5f;
+		float maxY = 2.5f;
+		// Sector of every cell, invalid for empty cells
+		std::vector<uint32_t> cellSector;
+		std::vector<Sector> sectors;
+		std::vector<Portal> portals;
+		// Portal indices of all sectors
+		std::vector<uint32_t> sectorPortals;
+		// Results of the last traversal, sectors that were reached and the rectangle they're seen through
+		std::vector<uint32_t> visibleSectors;
+		std::vector<Rect> sectorRects;
+		// Number of portals passed by the last traversal
+		uint32_t portalsPassed = 0;
+
+		// Builds the sectors and portals for the current state of the dungeon
+		void build(const Dungeon &dungeon);
+		/*
+			Finds the sectors visible from the given position, portals farther away than maxDistance are ignored
+			Returns false if the position isn't within a sector (nothing can be culled then)
+		*/
+		bool traverse(const float *viewProjection, float eyeX, float eyeZ, float maxDistance);
+		inline bool isSectorVisible(uint32_t sector) const { return (sector != invalid) && (sectorStamps[sector] == stamp); }
+		// Checks a box of a cell against the rectangle its sector is seen through (last traversal)
+		bool isBoxVisible(uint32_t cell, const float *boxMin, const float *boxMax, const float *viewProjection) const;
+		/*
+			Projects a box to the screen, returns false if it is completely outside of the screen
+			Boxes reaching behind the viewer cover the whole screen
+		*/
+		static bool projectBox(const float *viewProjection, const float *boxMin, const float *boxMax, Rect &rect);
+		// Memory used by the graph in bytes
+		size_t getMemorySize() const;
+	};
+
+}
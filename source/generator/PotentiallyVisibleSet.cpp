@@ -0,0 +1,267 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "PotentiallyVisibleSet.h"
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include "BitPlane.h"
+#include "threadpool.hpp"
+
+namespace dungeongenerator {
+
+	const int PotentiallyVisibleSet::maxRadius;
+
+	// Sample points within the source and the target cell (center and corners), relative to the cell's center
+	static const float sampleOffset = 0.45f;
+	static const uint32_t sampleCount = 5;
+	static const float samples[sampleCount][2] = {
+		{ 0.0f, 0.0f },
+		{ -sampleOffset, -sampleOffset }, { sampleOffset, -sampleOffset }, { -sampleOffset, sampleOffset }, { sampleOffset, sampleOffset }
+	};
+
+	bool PotentiallyVisibleSet::traceLine(const Dungeon &dungeon, float fromX, float fromY, float toX, float toY)
+	{
+		// Cell x covers [x, x + 1) after the shift
+		const float ax = fromX + 0.5f;
+		const float ay = fromY + 0.5f;
+		const float dx = toX - fromX;
+		const float dy = toY - fromY;
+		int x = (int)floorf(ax);
+		int y = (int)floorf(ay);
+		const int destX = (int)floorf(toX + 0.5f);
+		const int destY = (int)floorf(toY + 0.5f);
+		const int stepX = (dx > 0.0f) ? 1 : -1;
+		const int stepY = (dy > 0.0f) ? 1 : -1;
+		const float deltaX = (dx != 0.0f) ? fabsf(1.0f / dx) : FLT_MAX;
+		const float deltaY = (dy != 0.0f) ? fabsf(1.0f / dy) : FLT_MAX;
+		float tMaxX = (dx > 0.0f) ? (x + 1 - ax) * deltaX : ((dx < 0.0f) ? (ax - x) * deltaX : FLT_MAX);
+		float tMaxY = (dy > 0.0f) ? (y + 1 - ay) * deltaY : ((dy < 0.0f) ? (ay - y) * deltaY : FLT_MAX);
+		// Walk the cells crossed by the line, never stepping past the destination on either axis (rounding errors)
+		while ((x != destX) || (y != destY)) {
+			if ((y == destY) || ((x != destX) && (tMaxX < tMaxY))) {
+				x += stepX;
+				tMaxX += deltaX;
+			}
+			else {
+				y += stepY;
+				tMaxY += deltaY;
+			}
+			if (dungeon.getCellType(x, y) == Cell::cellTypeEmpty) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void PotentiallyVisibleSet::computeEntry(const Dungeon &dungeon, int x, int y, Entry &entry, std::vector<uint8_t> &data) const
+	{
+		entry = Entry{ (uint32_t)data.size(), 0, 0, 0, 1 };
+		if (dungeon.getCellType(x, y) == Cell::cellTypeEmpty) {
+			return;
+		}
+
+		/*
+			A traced line only ever steps towards the target, so a target can only be visible if it can be reached from
+			the cell by such steps over non-empty cells. This is computed for the four quadrants of the window first,
+			lines are only traced for the remaining candidates
+		*/
+		const int size = 2 * radius + 1;
+		uint8_t candidates[(2 * maxRadius + 1) * (2 * maxRadius + 1)];
+		memset(candidates, 0, size * size);
+		for (int sy = -1; sy <= 1; sy += 2) {
+			for (int sx = -1; sx <= 1; sx += 2) {
+				for (int oy = 0; abs(oy) <= radius; oy += sy) {
+					const int ty = y + oy;
+					if ((ty < 0) || (ty >= height)) {
+						break;
+					}
+					for (int ox = 0; abs(ox) <= radius; ox += sx) {
+						const int tx = x + ox;
+						if ((tx < 0) || (tx >= width) || (dungeon.getCellType(tx, ty) == Cell::cellTypeEmpty)) {
+							// Cells further along the line can still be reached from the next line
+							if ((tx < 0) || (tx >= width)) {
+								break;
+							}
+							continue;
+						}
+						const bool reached = ((ox == 0) && (oy == 0)) ||
+							((ox != 0) && (candidates[(oy + radius) * size + ox - sx + radius] & (1 << ((sy + 1) + (sx + 1) / 2)))) ||
+							((oy != 0) && (candidates[(oy - sy + radius) * size + ox + radius] & (1 << ((sy + 1) + (sx + 1) / 2))));
+						if (reached) {
+							candidates[(oy + radius) * size + ox + radius] |= (uint8_t)(1 << ((sy + 1) + (sx + 1) / 2));
+						}
+					}
+				}
+			}
+		}
+
+		// The viewer may stand anywhere within the cell, so cells slightly beyond the radius are included
+		const int maxDistance = (radius + 1) * (radius + 1);
+		uint64_t window[2 * maxRadius + 1];
+		uint64_t columns = 0;
+		int first = radius + 1;
+		int last = -radius - 1;
+		for (int oy = -radius; oy <= radius; oy++) {
+			const int ty = y + oy;
+			uint64_t bits = 0;
+			for (int ox = -radius; ox <= radius; ox++) {
+				const int tx = x + ox;
+				if ((!candidates[(oy + radius) * size + ox + radius]) || (ox * ox + oy * oy > maxDistance)) {
+					continue;
+				}
+				bool visible = (ox == 0) && (oy == 0);
+				for (uint32_t s = 0; (s < sampleCount) && (!visible); s++) {
+					for (uint32_t t = 0; (t < sampleCount) && (!visible); t++) {
+						visible = traceLine(dungeon, x + samples[s][0], y + samples[s][1], tx + samples[t][0], ty + samples[t][1]);
+					}
+				}
+				if (visible) {
+					bits |= 1ULL << (ox + radius);
+				}
+			}
+			window[oy + radius] = bits;
+			columns |= bits;
+			if (bits != 0) {
+				first = std::min(first, oy);
+				last = std::max(last, oy);
+			}
+		}
+		if (first > last) {
+			return;
+		}
+
+		// Only the columns between the leftmost and the rightmost visible cell are stored
+		uint32_t lastColumn = 63;
+		while (!((columns >> lastColumn) & 1)) {
+			lastColumn--;
+		}
+		entry.columnOffset = (uint8_t)BitPlane::getLowestBit(columns);
+		const uint32_t columnCount = lastColumn - entry.columnOffset + 1;
+		entry.rowSize = (columnCount <= 8) ? 1 : ((columnCount <= 16) ? 2 : ((columnCount <= 32) ? 4 : 8));
+		entry.rowOffset = (int8_t)first;
+		entry.rowCount = (uint8_t)(last - first + 1);
+		for (int oy = first; oy <= last; oy++) {
+			const uint64_t bits = window[oy + radius] >> entry.columnOffset;
+			const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&bits);
+			data.insert(data.end(), bytes, bytes + entry.rowSize);
+		}
+	}
+
+	void PotentiallyVisibleSet::compact()
+	{
+		std::vector<uint8_t> compacted;
+		compacted.reserve(usedData);
+		for (auto &entry : entries) {
+			const uint32_t dataOffset = (uint32_t)compacted.size();
+			compacted.insert(compacted.end(), rowData.begin() + entry.dataOffset, rowData.begin() + entry.dataOffset + entry.rowCount * entry.rowSize);
+			entry.dataOffset = dataOffset;
+		}
+		rowData.swap(compacted);
+	}
+
+	void PotentiallyVisibleSet::build(const Dungeon &dungeon, int radius, vks::ThreadPool *threadPool)
+	{
+		width = dungeon.width;
+		height = dungeon.height;
+		this->radius = std::max(std::min(radius, maxRadius), 0);
+		entries.assign((size_t)width * height, Entry{ 0, 0, 0, 0, 1 });
+		rowData.clear();
+
+		// Every thread computes a block of lines into its own rows list, the lists are concatenated afterwards
+		const size_t threadCount = threadPool ? std::max(threadPool->threads.size(), (size_t)1) : 1;
+		std::vector<std::vector<uint8_t>> threadRows(threadCount);
+		const int blockSize = (height + (int)threadCount - 1) / (int)threadCount;
+		auto computeBlock = [this, &dungeon, &threadRows, blockSize](size_t t) {
+			const int firstLine = std::min((int)t * blockSize, height);
+			const int lastLine = std::min(firstLine + blockSize, height);
+			for (int y = firstLine; y < lastLine; y++) {
+				for (int x = 0; x < width; x++) {
+					computeEntry(dungeon, x, y, entries[dungeon.getCellIndex(x, y)], threadRows[t]);
+				}
+			}
+		};
+		if (threadPool) {
+			for (size_t t = 0; t < threadCount; t++) {
+				threadPool->threads[t]->addJob([computeBlock, t] { computeBlock(t); });
+			}
+			threadPool->wait();
+		}
+		else {
+			computeBlock(0);
+		}
+
+		for (size_t t = 0; t < threadCount; t++) {
+			const uint32_t base = (uint32_t)rowData.size();
+			const int firstLine = std::min((int)t * blockSize, height);
+			const int lastLine = std::min(firstLine + blockSize, height);
+			for (uint32_t i = (uint32_t)firstLine * width; i < (uint32_t)lastLine * width; i++) {
+				entries[i].dataOffset += base;
+			}
+			rowData.insert(rowData.end(), threadRows[t].begin(), threadRows[t].end());
+		}
+		usedData = rowData.size();
+	}
+
+	size_t PotentiallyVisibleSet::update(const Dungeon &dungeon, const std::vector<uint32_t> &changedCells)
+	{
+		// A changed cell affects all cells that can see it or see past it, plus its neighbours (walls)
+		std::vector<uint8_t> marked(entries.size(), 0);
+		std::vector<uint32_t> cells;
+		const int range = radius + 2;
+		for (auto index : changedCells) {
+			const int cx = index % width;
+			const int cy = index / width;
+			for (int y = std::max(cy - range, 0); y <= std::min(cy + range, height - 1); y++) {
+				for (int x = std::max(cx - range, 0); x <= std::min(cx + range, width - 1); x++) {
+					const uint32_t cell = dungeon.getCellIndex(x, y);
+					if (!marked[cell]) {
+						marked[cell] = 1;
+						cells.push_back(cell);
+					}
+				}
+			}
+		}
+		for (auto cell : cells) {
+			Entry &entry = entries[cell];
+			usedData -= entry.rowCount * entry.rowSize;
+			computeEntry(dungeon, cell % width, cell / width, entry, rowData);
+			usedData += entry.rowCount * entry.rowSize;
+		}
+		if (rowData.size() > 2 * usedData) {
+			compact();
+		}
+		return cells.size();
+	}
+
+	bool PotentiallyVisibleSet::isVisible(int fromX, int fromY, int toX, int toY) const
+	{
+		const int ox = toX - fromX;
+		const int oy = toY - fromY;
+		if ((fromX < 0) || (fromY < 0) || (fromX >= width) || (fromY >= height) || (abs(ox) > radius) || (abs(oy) > radius)) {
+			return false;
+		}
+		return ((getRow(fromY * width + fromX, oy) >> (ox + radius)) & 1) != 0;
+	}
+
+	uint32_t PotentiallyVisibleSet::getVisibleCount(uint32_t cell) const
+	{
+		uint32_t count = 0;
+		const Entry &entry = entries[cell];
+		for (int i = 0; i < entry.rowCount; i++) {
+			count += BitPlane::getBitCount(getRow(cell, entry.rowOffset + i));
+		}
+		return count;
+	}
+
+	size_t PotentiallyVisibleSet::getMemorySize() const
+	{
+		return entries.capacity() * sizeof(Entry) + rowData.capacity();
+	}
+
+}
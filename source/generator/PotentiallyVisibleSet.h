@@ -0,0 +1,95 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include "Dungeon.h"
+
+namespace vks {
+	class ThreadPool;
+}
+
+namespace dungeongenerator {
+
+	/*
+		Precomputed cell to cell visibility (potentially visible sets)
+
+		For every non-empty cell the set of cells that can be seen from anywhere within that cell is stored. Only
+		cells within the given radius are considered, so the set of a cell is a square window centered on it, stored
+		as one bit row per line of the window (bit i stands for x = cellX - radius + i). Rows are compressed by
+		leaving out leading and trailing rows without visible cells and by storing only the columns between the
+		leftmost and rightmost visible cell, using one to eight bytes per row.
+
+		Empty cells are solid (their faces are the walls of the neighbouring cells), doors don't block the view. A cell
+		is visible if a line from one of a few sample points within the source cell to one of a few sample points
+		within the target cell only crosses non-empty cells.
+	*/
+	class PotentiallyVisibleSet
+	{
+	public:
+		// Largest supported radius (a row of the window has to fit into 64 bits)
+		static const int maxRadius = 31;
+
+		struct Entry {
+			// Offset of the first stored row in rowData
+			uint32_t dataOffset;
+			// Offset of the first stored row relative to the cell's row (-radius..radius)
+			int8_t rowOffset;
+			uint8_t rowCount;
+			// Stored rows start at this bit of the window row
+			uint8_t columnOffset;
+			// Size of a stored row in bytes (1, 2, 4 or 8)
+			uint8_t rowSize;
+		};
+
+	private:
+		// Bytes in use by entries, rows of replaced entries are only reclaimed when compacting
+		size_t usedData = 0;
+		// Traces a line between two points (in cell units, cells are centered on integer coordinates)
+		static bool traceLine(const Dungeon &dungeon, float fromX, float fromY, float toX, float toY);
+		// Appends the rows of the given cell's set to the data and sets up its entry
+		void computeEntry(const Dungeon &dungeon, int x, int y, Entry &entry, std::vector<uint8_t> &data) const;
+		void compact();
+	public:
+		int width = 0;
+		int height = 0;
+		int radius = 0;
+		// One entry per cell (indexed like the dungeon's cell grid), empty cells have no rows
+		std::vector<Entry> entries;
+		std::vector<uint8_t> rowData;
+
+		// Computes the sets for all cells of the dungeon, radius is clamped to maxRadius
+		void build(const Dungeon &dungeon, int radius, vks::ThreadPool *threadPool = nullptr);
+		/*
+			Recomputes the sets of all cells within the radius of the given cells (e.g. Dungeon::changedCells after an edit)
+			Returns the number of recomputed cells
+		*/
+		size_t update(const Dungeon &dungeon, const std::vector<uint32_t> &changedCells);
+		// Visible cells of the row at the given offset from the cell (-radius..radius), bit i stands for x = cellX - radius + i
+		inline uint64_t getRow(uint32_t cell, int offset) const {
+			const Entry &entry = entries[cell];
+			const int row = offset - entry.rowOffset;
+			if ((row < 0) || (row >= entry.rowCount)) {
+				return 0;
+			}
+			// Stored little endian (as in BitPlane)
+			uint64_t bits = 0;
+			memcpy(&bits, &rowData[entry.dataOffset + row * entry.rowSize], entry.rowSize);
+			return bits << entry.columnOffset;
+		}
+		bool isVisible(int fromX, int fromY, int toX, int toY) const;
+		// Number of cells visible from the given cell
+		uint32_t getVisibleCount(uint32_t cell) const;
+		// Memory used by the entries and rows in bytes
+		size_t getMemorySize() const;
+	};
+
+}
@@ -0,0 +1,56 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+namespace dungeongenerator {
+
+	/*
+		Counter based random number stream
+		Each value is a hash of (seed, stream, counter), so streams don't share any state and can be
+		forked into independent sub streams (e.g. one per partition subtree). The same seed always
+		yields the same sequence, regardless of evaluation order or the number of threads used
+	*/
+	class Random
+	{
+	private:
+		uint64_t key;
+		uint64_t counter = 0;
+
+		// SplitMix64 finalizer
+		static inline uint64_t mix(uint64_t v) {
+			v = (v ^ (v >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			v = (v ^ (v >> 27)) * 0x94d049bb133111ebULL;
+			return v ^ (v >> 31);
+		}
+	public:
+		Random(uint64_t seed = 0, uint64_t stream = 0) {
+			key = mix(mix(seed + 0x9e3779b97f4a7c15ULL) ^ (stream * 0xd1b54a32d192ed03ULL + 1));
+		}
+
+		// Returns the next 32 bit value of this stream
+		inline uint32_t next() {
+			return (uint32_t)(mix(key + (counter++) * 0x9e3779b97f4a7c15ULL) >> 32);
+		}
+
+		// Returns a value in [0, n), zero for empty ranges
+		inline int range(int n) {
+			return (n > 0) ? (int)(next() % (uint32_t)n) : 0;
+		}
+
+		// Returns an independent sub stream identified by id
+		inline Random fork(uint64_t id) const {
+			Random child;
+			child.key = mix(key ^ mix(id + 0x632be59bd9b4e019ULL));
+			return child;
+		}
+	};
+
+}
@@ -0,0 +1,59 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "Walkthrough.h"
+#include <stdlib.h>
+#include <limits.h>
+
+namespace dungeongenerator {
+
+	void Walkthrough::build(const Dungeon &dungeon, const Pathfinder &pathfinder, int startX, int startY)
+	{
+		path.clear();
+		rooms.clear();
+		unreachableRooms = 0;
+
+		std::vector<int32_t> remaining;
+		for (auto index : dungeon.partitionList) {
+			if (dungeon.partitions[index].hasRoom) {
+				remaining.push_back(index);
+			}
+		}
+
+		Pathfinder::QueryContext context;
+		std::vector<uint32_t> segment;
+		int x = startX;
+		int y = startY;
+		path.push_back(dungeon.getCellIndex(x, y));
+		while (!remaining.empty()) {
+			size_t nearest = 0;
+			int nearestDistance = INT_MAX;
+			for (size_t i = 0; i < remaining.size(); i++) {
+				const BspPartition &room = dungeon.partitions[remaining[i]];
+				const int distance = abs(room.centerX - x) + abs(room.centerY - y);
+				if (distance < nearestDistance) {
+					nearest = i;
+					nearestDistance = distance;
+				}
+			}
+			const BspPartition &room = dungeon.partitions[remaining[nearest]];
+			if (pathfinder.findPath(x, y, room.centerX, room.centerY, segment, context)) {
+				// The segment starts with the current cell
+				path.insert(path.end(), segment.begin() + 1, segment.end());
+				rooms.push_back(remaining[nearest]);
+				x = room.centerX;
+				y = room.centerY;
+			}
+			else {
+				unreachableRooms++;
+			}
+			remaining.erase(remaining.begin() + nearest);
+		}
+	}
+
+}
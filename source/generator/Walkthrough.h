@@ -0,0 +1,40 @@
+/*
+* Random dungeon generator
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include "Dungeon.h"
+#include "Pathfinder.h"
+
+namespace dungeongenerator {
+
+	/*
+		Scripted walk through a dungeon that visits every room, e.g. for reproducible benchmarks
+
+		Starting at the given cell, the walk always continues to the center of the nearest room not visited yet
+		(Manhattan distance between the centers, ties go to the room that comes first in the partition list) along
+		the path found by the path finder. The walk only depends on the dungeon and the start, so the same seed
+		always gives the same walk.
+	*/
+	class Walkthrough
+	{
+	public:
+		// Cells of the walk (indexed y * width + x) starting with the start cell, consecutive cells are neighbours
+		std::vector<uint32_t> path;
+		// Partitions of the visited rooms in the order they are visited
+		std::vector<int32_t> rooms;
+		// Rooms whose center can't be reached from the start
+		uint32_t unreachableRooms = 0;
+
+		// The path finder's graph has to be up to date with the dungeon
+		void build(const Dungeon &dungeon, const Pathfinder &pathfinder, int startX, int startY);
+	};
+
+}
@@ -11,6 +11,8 @@
 #include <string.h>
 #include <assert.h>
 #include <vector>
+#include <memory>
+#include <sstream>
 #include <omp.h>
 
 #define GLM_FORCE_RADIANS
@@ -25,8 +27,17 @@
 #include "VulkanTexture.hpp"
 #include "VulkanModel.hpp"
 #include "frustum.hpp"
+#include "threadpool.hpp"
 
 #include "generator/Dungeon.h"
+#include "generator/ChunkedDungeon.h"
+#include "generator/PotentiallyVisibleSet.h"
+#include "generator/PortalGraph.h"
+#include "generator/CellHierarchy.h"
+#include "generator/DungeonMesh.h"
+#include "generator/BitPlane.h"
+#include "generator/Pathfinder.h"
+#include "generator/Walkthrough.h"
 #include "Player.h"
 
 #define ENABLE_VALIDATION false
@@ -53,9 +64,9 @@ struct TextureSet {
 	vks::Texture2DArray color;
 	VkDescriptorSet descriptorSet;
 
-	void load(std::string name, vks::VulkanDevice *device, VkQueue queue) {
+	void load(std::string name, vks::VulkanDevice *device, VkQueue queue, VkSamplerAddressMode addressMode) {
 		std::string folder("./../data/texturesets/");
-		color.loadFromFile(folder + name + ".ktx", VK_FORMAT_R8G8B8A8_UNORM, device, queue);
+		color.loadFromFile(folder + name + ".ktx", VK_FORMAT_R8G8B8A8_UNORM, device, queue, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, addressMode);
 	}
 
 	void createDescriptorSet(VkDevice device, VkDescriptorPool pool, VkDescriptorSetLayout setLayout) {
@@ -70,14 +81,22 @@ struct TextureSet {
 };
 
 struct DungeonMap {
-	VkCommandBuffer commandBuffer;
-	bool update = true;
-	vks::Buffer uniformBuffer;
+	/*
+		Everything that changes while the map is displayed has one copy per frame in flight, the index buffer and the
+		command buffer of a frame slot are rebuilt when it's used next after the uncovered cells changed
+	*/
+	struct Frame {
+		VkCommandBuffer commandBuffer;
+		bool update = true;
+		vks::Buffer uniformBuffer;
+		vks::Buffer indexBuffer;
+		VkDescriptorSet descriptorSet;
+		uint32_t indexCountTiles = 0;
+		uint32_t indexCountLines = 0;
+	};
+	std::array<Frame, VulkanExampleBase::maxFramesInFlight> frames;
 	vks::Buffer vertexBuffer;
-	vks::Buffer indexBuffer;
 	uint32_t vertexOffsetLines = 0;
-	uint32_t indexCountTiles = 0;
-	uint32_t indexCountLines = 0;
 	struct Uniforms {
 		glm::mat4 projection;
 		glm::mat4 model;
@@ -87,23 +106,71 @@ struct DungeonMap {
 	VkPipeline pipeline;
 	VkPipeline pipelineWalls;
 	VkDescriptorSetLayout descriptorSetLayout;
-	VkDescriptorSet descriptorSet;
 	dungeongenerator::Dungeon *dungeon;
+	// Fog of war, one bit per dungeon cell stored as bit rows (see BitPlane)
+	std::vector<uint64_t> uncovered;
+	uint32_t uncoveredWordCount = 0;
 	Player *player;
 	float rotation = 0.0f;
 	float aspectRatio = 1.0f;
 	bool display = false;
+	// Timestamps of the map draws are written for this stage (if set)
+	vks::FrameProfiler *profiler = nullptr;
+	uint32_t profilerStage = 0;
+
+	void resetFogOfWar() {
+		uncoveredWordCount = dungeongenerator::BitPlane::getWordCount(dungeon->width);
+		uncovered.assign(uncoveredWordCount * dungeon->height, 0);
+		invalidate();
+	}
 
-	void updateUniforms() {
+	// Flags the index buffers and command buffers of all frame slots for rebuilding
+	void invalidate() {
+		for (auto &frame : frames) {
+			frame.update = true;
+		}
+	}
+
+	inline bool isUncovered(uint32_t x, uint32_t y) const {
+		return ((uncovered[y * uncoveredWordCount + x / 64] >> (x % 64)) & 1) != 0;
+	}
+
+	// Uncovers the cells of a row, bit i stands for x = left + i (cells outside of the dungeon must not be set)
+	void uncover(int32_t left, int32_t y, uint64_t bits) {
+		if (left < 0) {
+			bits >>= -left;
+			left = 0;
+		}
+		if (bits == 0) {
+			return;
+		}
+		uint64_t *row = &uncovered[y * uncoveredWordCount];
+		const uint32_t k = left / 64;
+		const uint32_t shift = left % 64;
+		const uint64_t low = bits << shift;
+		const uint64_t high = (shift > 0) ? bits >> (64 - shift) : 0;
+		uint64_t uncoveredBits = low & ~row[k];
+		row[k] |= low;
+		if ((high != 0) && (k + 1 < uncoveredWordCount)) {
+			uncoveredBits |= high & ~row[k + 1];
+			row[k + 1] |= high;
+		}
+		if (uncoveredBits != 0) {
+			invalidate();
+		}
+	}
+
+	void updateUniforms(uint32_t frame) {
 		const float scale = 32.0f;
 		uniforms.projection = glm::ortho(-scale, scale, -scale * aspectRatio, scale * aspectRatio, -1.0f, 1.0f);
 		uniforms.model = glm::mat4(1.0f);
 		uniforms.model = glm::rotate(uniforms.model, glm::radians(-rotation), glm::vec3(0.0f, 0.0f, 1.0f));
 		uniforms.model = glm::translate(uniforms.model, glm::vec3(-player->position.x, -player->position.z, 0.0f));
-		memcpy(uniformBuffer.mapped, &uniforms, sizeof(uniforms));
+		memcpy(frames[frame].uniformBuffer.mapped, &uniforms, sizeof(uniforms));
 	}
 
-	void updateBuffers() {
+	void updateBuffers(uint32_t frame) {
+		vks::Buffer &indexBuffer = frames[frame].indexBuffer;
 		struct Vertex {
 			float position[3];
 			float color[3];
@@ -117,7 +184,7 @@ struct DungeonMap {
 			const float d = 0.45f;
 			// Tiles
 			for (uint32_t x = 0; x < dungeon->width; x++) {
-				for (uint32_t y = 0; y < dungeon->width; y++) {
+				for (uint32_t y = 0; y < dungeon->height; y++) {
 					vertices.push_back({ { -d + x, -d + y, 0.0f }, COLOR_WHITE });
 					vertices.push_back({ {  d + x, -d + y, 0.0f }, COLOR_WHITE });
 					vertices.push_back({ { -d + x,  d + y, 0.0f }, COLOR_WHITE });
@@ -130,7 +197,7 @@ struct DungeonMap {
 			vertexOffsetLines = static_cast<uint32_t>(vertices.size());
 			const float wd = 0.5f;
 			for (uint32_t x = 0; x < dungeon->width; x++) {
-				for (uint32_t y = 0; y < dungeon->width; y++) {
+				for (uint32_t y = 0; y < dungeon->height; y++) {
 					// N
 					vertices.push_back({ { x - wd, y - wd, 0.0f }, COLOR_WHITE });
 					vertices.push_back({ { x + wd, y - wd, 0.0f }, COLOR_WHITE });
@@ -161,8 +228,8 @@ struct DungeonMap {
 			uint32_t idx = 0;
 			std::vector<uint32_t> indices;
 			for (uint32_t x = 0; x < dungeon->width; x++) {
-				for (uint32_t y = 0; y < dungeon->width; y++) {
-					if (dungeon->getCell(x, y)->uncovered) {
+				for (uint32_t y = 0; y < dungeon->height; y++) {
+					if (isUncovered(x, y)) {
 						for (uint32_t i = 0; i < 6; i++) {
 							indices.push_back(idx + i);
 						}
@@ -170,25 +237,24 @@ struct DungeonMap {
 					idx += 6;
 				}
 			}
-			indexCountTiles = static_cast<uint32_t>(indices.size());
+			const uint32_t indexCountTiles = static_cast<uint32_t>(indices.size());
 			idx = vertexOffsetLines;
 			for (uint32_t x = 0; x < dungeon->width; x++) {
-				for (uint32_t y = 0; y < dungeon->width; y++) {
-					dungeongenerator::Cell *cell = dungeon->getCell(x, y);
-					if (cell->uncovered) {
-						if (cell->walls[dungeongenerator::Cell::dirNorth]) {
+				for (uint32_t y = 0; y < dungeon->height; y++) {
+					if (isUncovered(x, y)) {
+						if (dungeon->hasWall(x, y, dungeongenerator::Cell::dirNorth)) {
 							indices.push_back(idx + 0);
 							indices.push_back(idx + 1);
 						}
-						if (cell->walls[dungeongenerator::Cell::dirSouth]) {
+						if (dungeon->hasWall(x, y, dungeongenerator::Cell::dirSouth)) {
 							indices.push_back(idx + 2);
 							indices.push_back(idx + 3);
 						}
-						if (cell->walls[dungeongenerator::Cell::dirEast]) {
+						if (dungeon->hasWall(x, y, dungeongenerator::Cell::dirEast)) {
 							indices.push_back(idx + 4);
 							indices.push_back(idx + 5);
 						}
-						if (cell->walls[dungeongenerator::Cell::dirWest]) {
+						if (dungeon->hasWall(x, y, dungeongenerator::Cell::dirWest)) {
 							indices.push_back(idx + 6);
 							indices.push_back(idx + 7);
 						}
@@ -196,7 +262,8 @@ struct DungeonMap {
 					idx += 8;
 				}
 			}
-			indexCountLines = static_cast<uint32_t>(indices.size()) - indexCountTiles;
+			frames[frame].indexCountTiles = indexCountTiles;
+			frames[frame].indexCountLines = static_cast<uint32_t>(indices.size()) - indexCountTiles;
 			VkDeviceSize indexBufferSize = indices.size() * sizeof(uint32_t);
 			if (indexBufferSize > 0) {
 				VK_CHECK_RESULT(globals.device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &indexBuffer, indexBufferSize, indices.data()));
@@ -207,7 +274,12 @@ struct DungeonMap {
 		}
 	}
 
-	void updateCommandBuffer(VkRenderPass renderpass, glm::vec2 screensize) {
+	void updateCommandBuffer(uint32_t frame, VkRenderPass renderpass, glm::vec2 screensize) {
+		const VkCommandBuffer commandBuffer = frames[frame].commandBuffer;
+		const vks::Buffer &indexBuffer = frames[frame].indexBuffer;
+		const uint32_t indexCountTiles = frames[frame].indexCountTiles;
+		const uint32_t indexCountLines = frames[frame].indexCountLines;
+
 		VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
 		inheritanceInfo.renderPass = renderpass;
 		inheritanceInfo.framebuffer = VK_NULL_HANDLE;
@@ -224,11 +296,15 @@ struct DungeonMap {
 		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
 		VkDeviceSize offsets[1] = { 0 };
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frames[frame].descriptorSet, 0, nullptr);
 
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
 		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
 
+		if (profiler) {
+			profiler->writeTimestamp(commandBuffer, frame, profilerStage, false);
+		}
+
 		if (indexCountTiles > 0) {
 			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
 			vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
@@ -240,27 +316,542 @@ struct DungeonMap {
 			vkCmdDrawIndexed(commandBuffer, indexCountLines, 1, indexCountTiles, 0, 0);
 		}
 
+		if (profiler) {
+			profiler->writeTimestamp(commandBuffer, frame, profilerStage, true);
+		}
+
 		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 
-		update = false;
+		frames[frame].update = false;
+	}
+
+	// Only changes to cells already uncovered are visible on the map
+	void applyChanges(const std::vector<uint32_t> &changedCells) {
+		for (auto index : changedCells) {
+			if (isUncovered(index % dungeon->width, index / dungeon->width)) {
+				invalidate();
+				return;
+			}
+		}
+	}
+};
+
+/*
+	Instanced rendering of the culled cells
+	Every face of the visible cells is added to one of the batches by face type (index range of the cell's vertex buffer)
+	and texture set, each batch is drawn with a single instanced draw. The per instance data (cell position and texture
+	array layer) is written to a host visible buffer whenever the visible cells change
+*/
+struct CellInstances {
+	static const uint32_t faceTypeCount = 6;
+	static const uint32_t textureSetCount = 2;
+	// Matches the per instance input of deferred_instanced.vert
+	struct Instance {
+		float position[3];
+		float layer;
+	};
+	// Indexed by texture set and face type (floor, walls in the order of INDEX_OFFSET_*, ceiling)
+	std::vector<Instance> batches[textureSetCount][faceTypeCount];
+	uint32_t firstInstances[textureSetCount][faceTypeCount];
+	uint32_t instanceCount = 0;
+	uint32_t drawCount = 0;
+	// Maximum number of instances in the buffer
+	uint32_t capacity = 0;
+	vks::Buffer instanceBuffer;
+
+	void prepareBuffer(uint32_t maxCells) {
+		capacity = maxCells * faceTypeCount;
+		VK_CHECK_RESULT(globals.device->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&instanceBuffer,
+			capacity * sizeof(Instance)));
+		VK_CHECK_RESULT(instanceBuffer.map());
+	}
+
+	void clear() {
+		for (auto &textureSetBatches : batches) {
+			for (auto &batch : textureSetBatches) {
+				batch.clear();
+			}
+		}
+	}
+
+	void addCell(dungeongenerator::CellAccessor *cells, int32_t x, int32_t y, bool ceiling) {
+		const uint8_t cellType = cells->getCellType(x, y);
+		if (cellType == dungeongenerator::Cell::cellTypeEmpty) {
+			return;
+		}
+		const uint32_t textureSet = (cellType == dungeongenerator::Cell::cellTypeCorridor) ? 1 : 0;
+		// Texture array layers: floor, walls, ceiling
+		batches[textureSet][0].push_back({ { (float)x, 0.0f, (float)y }, 0.0f });
+		const int walls[4] = { dungeongenerator::Cell::dirNorth, dungeongenerator::Cell::dirSouth, dungeongenerator::Cell::dirWest, dungeongenerator::Cell::dirEast };
+		for (uint32_t i = 0; i < 4; i++) {
+			if (cells->hasWall(x, y, walls[i])) {
+				batches[textureSet][i + 1].push_back({ { (float)x, 0.0f, (float)y }, 1.0f });
+			}
+		}
+		if (ceiling) {
+			batches[textureSet][5].push_back({ { (float)x, 0.0f, (float)y }, 2.0f });
+		}
+	}
+
+	// Copies all batches to the instance buffer (must not be in use by the GPU)
+	void upload() {
+		Instance *instances = (Instance*)instanceBuffer.mapped;
+		instanceCount = 0;
+		drawCount = 0;
+		for (uint32_t i = 0; i < textureSetCount; i++) {
+			for (uint32_t face = 0; face < faceTypeCount; face++) {
+				const std::vector<Instance> &batch = batches[i][face];
+				assert(instanceCount + batch.size() <= capacity);
+				firstInstances[i][face] = instanceCount;
+				if (!batch.empty()) {
+					memcpy(instances + instanceCount, batch.data(), batch.size() * sizeof(Instance));
+					instanceCount += static_cast<uint32_t>(batch.size());
+					drawCount++;
+				}
+			}
+		}
+	}
+
+	// Draws all batches with the given texture sets, pipeline, cell vertex and index buffers have to be bound
+	void recordDraws(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkDescriptorSet modelDescriptorSet, const VkDescriptorSet *textureSets) {
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffer.buffer, offsets);
+		for (uint32_t i = 0; i < textureSetCount; i++) {
+			std::array<VkDescriptorSet, 2> descriptorSets = { modelDescriptorSet, textureSets[i] };
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0, nullptr);
+			for (uint32_t face = 0; face < faceTypeCount; face++) {
+				const uint32_t count = static_cast<uint32_t>(batches[i][face].size());
+				if (count > 0) {
+					vkCmdDrawIndexed(commandBuffer, 6, count, face * 6, 0, firstInstances[i][face]);
+				}
+			}
+		}
+	}
+
+	void destroy() {
+		instanceBuffer.destroy();
 	}
+};
 
-	bool checkVisibility(glm::ivec2 from, glm::ivec2 to) {
-		float difX = to.x - from.x;
-		float difY = to.y - from.y;
-		float dist = abs(difX) + abs(difY);
+/*
+	Static dungeon geometry merged per chunk (enabled via "-mergedmesh")
+	The visible faces of each chunk are baked into one mesh (see dungeongenerator::DungeonMesh), all chunks share one
+	vertex and one index buffer. Chunks are culled as a whole and drawn with one draw per texture set
+*/
+struct MergedMesh {
+	bool enabled = false;
+	dungeongenerator::DungeonMesh mesh;
+	vks::Buffer vertexBuffer;
+	vks::Buffer indexBuffer;
+	// Offsets of each chunk's vertices and indices in the shared buffers
+	std::vector<int32_t> vertexOffsets;
+	std::vector<uint32_t> firstIndices;
+	// Chunks passing the culling tests (last recording)
+	std::vector<uint32_t> visibleChunks;
+
+	// Uploads the meshes of all chunks to device local buffers (replacing previous buffers)
+	void upload(VkQueue queue) {
+		std::vector<dungeongenerator::DungeonMesh::Vertex> vertices;
+		std::vector<uint32_t> indices;
+		vertices.reserve(mesh.getVertexCount());
+		indices.reserve(mesh.getIndexCount());
+		vertexOffsets.resize(mesh.chunks.size());
+		firstIndices.resize(mesh.chunks.size());
+		for (size_t i = 0; i < mesh.chunks.size(); i++) {
+			const dungeongenerator::DungeonMesh::Chunk &chunk = mesh.chunks[i];
+			vertexOffsets[i] = static_cast<int32_t>(vertices.size());
+			firstIndices[i] = static_cast<uint32_t>(indices.size());
+			vertices.insert(vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+			indices.insert(indices.end(), chunk.indices.begin(), chunk.indices.end());
+		}
+		// The previous buffers may still be in use
+		vkQueueWaitIdle(queue);
+		destroy();
+		if (indices.empty()) {
+			return;
+		}
 
-		float dx = difX / dist;
-		float dy = difY / dist;
+		struct {
+			vks::Buffer *buffer;
+			VkBufferUsageFlags usage;
+			VkDeviceSize size;
+			void *data;
+		} uploads[2] = {
+			{ &vertexBuffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertices.size() * sizeof(dungeongenerator::DungeonMesh::Vertex), vertices.data() },
+			{ &indexBuffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices.size() * sizeof(uint32_t), indices.data() },
+		};
+		for (auto &upload : uploads) {
+			vks::Buffer stagingBuffer;
+			VK_CHECK_RESULT(globals.device->createBuffer(
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&stagingBuffer,
+				upload.size,
+				upload.data));
+			VK_CHECK_RESULT(globals.device->createBuffer(
+				upload.usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				upload.buffer,
+				upload.size));
+			VkCommandBuffer copyCmd = globals.device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			VkBufferCopy copyRegion = {};
+			copyRegion.size = upload.size;
+			vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, upload.buffer->buffer, 1, &copyRegion);
+			globals.device->flushCommandBuffer(copyCmd, queue, true);
+			stagingBuffer.destroy();
+		}
+	}
+
+	// Collects the chunks with faces within the draw distance that pass the frustum test
+	void cull(const vks::Frustum &frustum, const glm::vec3 &eye, float maxDistance) {
+		visibleChunks.clear();
+		for (uint32_t i = 0; i < mesh.chunks.size(); i++) {
+			const dungeongenerator::DungeonMesh::Chunk &chunk = mesh.chunks[i];
+			if (chunk.indices.empty()) {
+				continue;
+			}
+			const glm::vec2 nearest = glm::clamp(glm::vec2(eye.x, eye.z), glm::vec2(chunk.minX, chunk.minY), glm::vec2(chunk.maxX, chunk.maxY));
+			if (glm::length(glm::vec3(nearest.x, 0.0f, nearest.y) - eye) > maxDistance) {
+				continue;
+			}
+			const glm::vec3 center = glm::vec3(chunk.minX + chunk.maxX, 0.0f, chunk.minY + chunk.maxY) * 0.5f;
+			const glm::vec3 extent = glm::vec3(chunk.maxX - chunk.minX + 1, 5.0f, chunk.maxY - chunk.minY + 1) * 0.5f;
+			if (frustum.checkBox(center, extent) & 1) {
+				visibleChunks.push_back(i);
+			}
+		}
+	}
 
-		for (uint32_t i = 0; i <= ceil(dist); i++) {
-			uint32_t x = floor(from.x + dx * i);
-			uint32_t y = floor(from.y + dy * i);
-			if (dungeon->getCell(x, y)->type == dungeongenerator::Cell::cellTypeEmpty) {
-				return false;
+	// Draws the visible chunks from firstChunk to firstChunk + chunkCount with the given texture sets, pipeline has to be bound
+	void recordDraws(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkDescriptorSet modelDescriptorSet, const VkDescriptorSet *textureSets, bool ceiling, uint32_t firstChunk, uint32_t chunkCount) {
+		if (chunkCount == 0) {
+			return;
+		}
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+		// Vertices are in world space
+		const glm::vec3 position = glm::vec3(0.0f);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec3), &position);
+		for (uint32_t i = 0; i < dungeongenerator::DungeonMesh::textureSetCount; i++) {
+			std::array<VkDescriptorSet, 2> descriptorSets = { modelDescriptorSet, textureSets[i] };
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0, nullptr);
+			for (uint32_t j = firstChunk; j < firstChunk + chunkCount; j++) {
+				const uint32_t index = visibleChunks[j];
+				const dungeongenerator::DungeonMesh::Chunk &chunk = mesh.chunks[index];
+				const uint32_t indexCount = chunk.indexCount[i] - (ceiling ? 0 : chunk.ceilingIndexCount[i]);
+				if (indexCount > 0) {
+					vkCmdDrawIndexed(commandBuffer, indexCount, 1, firstIndices[index] + chunk.firstIndex[i], vertexOffsets[index], 0);
+				}
 			}
 		}
-		return true;
+	}
+
+	void destroy() {
+		vertexBuffer.destroy();
+		indexBuffer.destroy();
+	}
+};
+
+/*
+	GPU driven rendering of the single dungeon's cells (enabled via "-gpuculling")
+	All cells are stored in a buffer, a compute shader culls them against the draw distance and the view frustum and
+	writes one indexed indirect draw per visible face. Draws are split by texture set and their number is taken from a
+	count buffer (vkCmdDrawIndexedIndirectCount), so the command buffer is only recorded once and the CPU cost per
+	frame doesn't depend on the size of the dungeon
+*/
+struct GpuCulling {
+	static const uint32_t textureSetCount = 2;
+	// Matches the cell struct of cull.comp (std430), the position is also used as per instance vertex data
+	struct Cell {
+		float position[4];
+		uint32_t faceMask;
+		uint32_t textureSet;
+		uint32_t padding[2];
+	};
+	// Matches the count buffer of cull.comp
+	struct Counts {
+		uint32_t drawCounts[textureSetCount];
+		uint32_t visibleCells;
+	};
+	struct Uniforms {
+		glm::vec4 frustumPlanes[6];
+		// xyz = eye position, w = draw distance
+		glm::vec4 eye;
+		uint32_t cellCount;
+		uint32_t maxDraws;
+		uint32_t skipCeiling;
+	} uniforms;
+	// Requested on the command line, enabled if the device supports it
+	bool requested = false;
+	bool enabled = false;
+	// Device extension providing vkCmdDrawIndexedIndirectCount (the AMD and KHR versions have the same signature)
+	const char *drawIndirectCountExtension = nullptr;
+	PFN_vkCmdDrawIndexedIndirectCountAMD cmdDrawIndexedIndirectCount = nullptr;
+	vks::Buffer cellBuffer;
+	vks::Buffer drawBuffer;
+	vks::Buffer countBuffer;
+	// Counts copied at the end of culling, one slot per frame in flight (statistics)
+	vks::Buffer readbackBuffer;
+	// Uniforms and descriptor sets per frame in flight
+	std::array<vks::Buffer, VulkanExampleBase::maxFramesInFlight> uniformBuffers;
+	VkDescriptorSetLayout descriptorSetLayout;
+	std::array<VkDescriptorSet, VulkanExampleBase::maxFramesInFlight> descriptorSets;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+	dungeongenerator::Dungeon *dungeon;
+
+	// Selects the draw indirect count extension, returns false if the device doesn't support GPU culling
+	bool checkDeviceSupport(VkPhysicalDevice physicalDevice, const VkPhysicalDeviceFeatures &features) {
+		if ((!features.drawIndirectFirstInstance) || (!features.multiDrawIndirect)) {
+			return false;
+		}
+		uint32_t extensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+		const char *candidates[] = { "VK_KHR_draw_indirect_count", VK_AMD_DRAW_INDIRECT_COUNT_EXTENSION_NAME };
+		for (auto candidate : candidates) {
+			for (auto &extension : extensions) {
+				if (strcmp(extension.extensionName, candidate) == 0) {
+					drawIndirectCountExtension = candidate;
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	Cell getCell(int32_t x, int32_t y) const {
+		Cell cell = { { (float)x, 0.0f, (float)y, 1.0f }, 0, 0, { 0, 0 } };
+		const uint8_t cellType = dungeon->getCellType(x, y);
+		if (cellType == dungeongenerator::Cell::cellTypeEmpty) {
+			return cell;
+		}
+		// Floor and ceiling, walls in the order of the index buffer (see INDEX_OFFSET_*)
+		cell.faceMask = 1 | (1 << 5);
+		const uint8_t walls[4] = { dungeongenerator::Cell::dirNorth, dungeongenerator::Cell::dirSouth, dungeongenerator::Cell::dirWest, dungeongenerator::Cell::dirEast };
+		for (uint32_t i = 0; i < 4; i++) {
+			if (dungeon->hasWall(x, y, walls[i])) {
+				cell.faceMask |= 1 << (i + 1);
+			}
+		}
+		cell.textureSet = (cellType == dungeongenerator::Cell::cellTypeCorridor) ? 1 : 0;
+		return cell;
+	}
+
+	// Draws are limited to the cells within maxDistance (see cull.comp)
+	void prepareBuffers(uint32_t maxDistance) {
+		const uint32_t cellCount = static_cast<uint32_t>(dungeon->cellTypes.size());
+		std::vector<Cell> cells(cellCount);
+		for (int32_t y = 0; y < dungeon->height; y++) {
+			for (int32_t x = 0; x < dungeon->width; x++) {
+				cells[dungeon->getCellIndex(x, y)] = getCell(x, y);
+			}
+		}
+		// Host visible, so edits can be written directly
+		VK_CHECK_RESULT(globals.device->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&cellBuffer,
+			cellCount * sizeof(Cell),
+			cells.data()));
+		VK_CHECK_RESULT(cellBuffer.map());
+		// Only cells within the draw distance are drawn, that's at most a square of 2 * distance + 1 cells with six faces each
+		const uint32_t maxCells = std::min((2 * maxDistance + 1) * (2 * maxDistance + 1), cellCount);
+		uniforms.cellCount = cellCount;
+		uniforms.maxDraws = maxCells * 6;
+		VK_CHECK_RESULT(globals.device->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&drawBuffer,
+			textureSetCount * uniforms.maxDraws * sizeof(VkDrawIndexedIndirectCommand)));
+		VK_CHECK_RESULT(globals.device->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&countBuffer,
+			sizeof(Counts)));
+		// The count buffer is reset by the next frame while the host may still read, so each frame copies its counts to its own slot
+		VK_CHECK_RESULT(globals.device->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&readbackBuffer,
+			VulkanExampleBase::maxFramesInFlight * sizeof(Counts)));
+		VK_CHECK_RESULT(readbackBuffer.map());
+		memset(readbackBuffer.mapped, 0, VulkanExampleBase::maxFramesInFlight * sizeof(Counts));
+		for (auto &uniformBuffer : uniformBuffers) {
+			VK_CHECK_RESULT(globals.device->createBuffer(
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&uniformBuffer,
+				sizeof(uniforms)));
+			VK_CHECK_RESULT(uniformBuffer.map());
+		}
+	}
+
+	// The cell buffer is shared by all frames in flight, they have to be finished
+	void updateCells(const std::vector<uint32_t> &changedCells) {
+		Cell *cells = (Cell*)cellBuffer.mapped;
+		for (auto index : changedCells) {
+			cells[index] = getCell(index % dungeon->width, index / dungeon->width);
+		}
+	}
+
+	void updateUniforms(const vks::Frustum &frustum, const glm::vec3 &eye, float maxDistance, bool skipCeiling) {
+		for (uint32_t i = 0; i < 6; i++) {
+			uniforms.frustumPlanes[i] = frustum.planes[i];
+		}
+		uniforms.eye = glm::vec4(eye, maxDistance);
+		uniforms.skipCeiling = skipCeiling ? 1 : 0;
+	}
+
+	// Copies the uniforms to the buffer of a frame slot (must not be in use by the GPU)
+	void uploadUniforms(uint32_t frame) {
+		memcpy(uniformBuffers[frame].mapped, &uniforms, sizeof(uniforms));
+	}
+
+	// Culling has to be recorded outside of the render pass
+	void recordCulling(VkCommandBuffer commandBuffer, uint32_t frame) {
+		// Previous frame's draws and count copy have to be done before the buffers are written again
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+		vkCmdFillBuffer(commandBuffer, countBuffer.buffer, 0, sizeof(Counts), 0);
+
+		VkBufferMemoryBarrier barrier = vks::initializers::bufferMemoryBarrier();
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.buffer = countBuffer.buffer;
+		barrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[frame], 0, nullptr);
+		vkCmdDispatch(commandBuffer, (uniforms.cellCount + 63) / 64, 1, 1);
+
+		// Draws and counts are read as indirect parameters, counts are also copied for the statistics
+		std::array<VkBufferMemoryBarrier, 2> barriers;
+		barriers[0] = barrier;
+		barriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barriers[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		barriers[1] = barriers[0];
+		barriers[1].buffer = drawBuffer.buffer;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+
+		VkBufferCopy copyRegion = {};
+		copyRegion.dstOffset = frame * sizeof(Counts);
+		copyRegion.size = sizeof(Counts);
+		vkCmdCopyBuffer(commandBuffer, countBuffer.buffer, readbackBuffer.buffer, 1, &copyRegion);
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		barrier.buffer = readbackBuffer.buffer;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+
+	// Draws the culled faces with the given texture sets, pipeline, cell vertex and index buffers have to be bound
+	void recordDraws(VkCommandBuffer commandBuffer, VkPipelineLayout graphicsPipelineLayout, VkDescriptorSet modelDescriptorSet, const VkDescriptorSet *textureSets) {
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 1, 1, &cellBuffer.buffer, offsets);
+		for (uint32_t i = 0; i < textureSetCount; i++) {
+			std::array<VkDescriptorSet, 2> descriptorSets = { modelDescriptorSet, textureSets[i] };
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelineLayout, 0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0, nullptr);
+			cmdDrawIndexedIndirectCount(commandBuffer, drawBuffer.buffer, i * uniforms.maxDraws * sizeof(VkDrawIndexedIndirectCommand), countBuffer.buffer, i * sizeof(uint32_t), uniforms.maxDraws, sizeof(VkDrawIndexedIndirectCommand));
+		}
+	}
+
+	// Results of the last frame recorded for the frame slot, valid once that frame has finished on the GPU
+	const Counts &getCounts(uint32_t frame) const {
+		return ((const Counts*)readbackBuffer.mapped)[frame];
+	}
+
+	void destroy(VkDevice device) {
+		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+		cellBuffer.destroy();
+		drawBuffer.destroy();
+		countBuffer.destroy();
+		readbackBuffer.destroy();
+		for (auto &uniformBuffer : uniformBuffers) {
+			uniformBuffer.destroy();
+		}
+	}
+};
+
+/*
+	Drives the player along a scripted walk (see dungeongenerator::Walkthrough) one cell at a time, the player turns
+	until it faces the next cell of the path and then moves forward
+	The walk starts over from the first cell once the end has been reached
+*/
+struct ScriptedWalk {
+	bool active = false;
+	// Cells of the walk (indexed y * width + x)
+	std::vector<uint32_t> path;
+	int32_t width = 0;
+	uint32_t roomCount = 0;
+	// Next cell of the path to move to
+	size_t next = 1;
+	uint64_t cellsWalked = 0;
+	uint32_t completedWalks = 0;
+	// Seconds per frame used for benchmark runs, so the walk always takes the same frames
+	float timeStep = 0.1f;
+
+	// Cell in front of the player if it was turned by the given angle (see Player::getTargetCell)
+	static glm::ivec2 getForwardCell(const Player &player, float turn) {
+		const float angle = glm::radians(player.rotation.y + turn);
+		return glm::ivec2(round(player.position.x + sin(angle)), round(player.position.z - cos(angle)));
+	}
+
+	/*
+		Starts the next turn or move of the player, must only be called while the player doesn't move or turn
+		Returns true if the player was put onto the path (back to the start of the walk or after leaving the path)
+	*/
+	bool step(Player &player) {
+		if (next >= path.size()) {
+			player.setPosition(glm::vec3((float)(path[0] % width), 0.5f, (float)(path[0] / width)));
+			player.setRotation(glm::vec3(0.0f));
+			next = 1;
+			completedWalks++;
+			return true;
+		}
+		const glm::ivec2 target = glm::ivec2(path[next] % width, path[next] / width);
+		// The player was moved off the path (e.g. by user input)
+		const glm::ivec2 cell = glm::ivec2(round(player.position.x), round(player.position.z));
+		if (abs(target.x - cell.x) + abs(target.y - cell.y) != 1) {
+			player.setPosition(glm::vec3((float)target.x, 0.5f, (float)target.y));
+			next++;
+			return true;
+		}
+		if (getForwardCell(player, 0.0f) == target) {
+			player.move(glm::vec3(0.0f, 0.0f, 1.0f), true);
+			next++;
+			cellsWalked++;
+			return false;
+		}
+		// Turning around takes two turns
+		player.rotate((getForwardCell(player, -90.0f) == target) ? -90.0f : 90.0f, true);
+		return false;
+	}
+
+	/*
+		Number of frames one round of the walk takes with the fixed time step (simulated with a copy of the player)
+		Includes the frame step() spends on putting the player back onto the first cell, so the walk repeats with this period
+	*/
+	uint32_t getFrameCount(Player player) const {
+		ScriptedWalk walk = *this;
+		walk.next = 1;
+		walk.completedWalks = 0;
+		uint32_t frames = 0;
+		bool moving = false;
+		while (walk.completedWalks == 0) {
+			if (!moving) {
+				walk.step(player);
+			}
+			moving = player.update(timeStep);
+			frames++;
+		}
+		return frames;
 	}
 };
 
@@ -271,6 +862,43 @@ public:
 	bool animate = true;
 
 	uint32_t cellsVisible;
+	// Cells passing the frustum test (before portal culling)
+	uint32_t cellsInFrustum;
+	// Culling results for each row of the draw distance window, filled in parallel (see buildDeferredCommandBuffer)
+	std::vector<uint64_t> frustumRows;
+	std::vector<uint64_t> visibleRows;
+	// Cells of the single dungeon passing the frustum test and whether they passed the visibility tests too
+	std::vector<uint32_t> culledCells;
+	std::vector<uint8_t> culledCellsVisible;
+	/*
+		Result of culling for a view, the deferred pass only has to be re-recorded if it changes (the matrices are
+		read from the uniform buffers)
+	*/
+	struct VisibleSet {
+		bool valid = false;
+		// Ceilings are left out for the top down view
+		bool ceiling = true;
+		// Visible cells per row, bit i of row j stands for cell (origin.x + i, origin.y + j)
+		glm::ivec2 origin = glm::ivec2(0);
+		std::vector<uint64_t> rows;
+		// Visible chunks of the merged mesh
+		std::vector<uint32_t> chunks;
+		bool operator==(const VisibleSet &other) const {
+			return valid && other.valid && (ceiling == other.ceiling) && (origin == other.origin) && (rows == other.rows) && (chunks == other.chunks);
+		}
+	} visibleSet;
+	// Number of times the deferred pass was recorded and re-recording was skipped as the visible set didn't change
+	uint64_t deferredRecords = 0;
+	uint64_t deferredRecordsAvoided = 0;
+	// Stages timed by the frame profiler (see VulkanExampleBase::profiler)
+	struct {
+		uint32_t culling;
+		uint32_t recording;
+		uint32_t deferredPass;
+		uint32_t composition;
+		uint32_t mapOverlay;
+	} profilerStages;
+	// A row of cells within the draw distance has to fit into 64 bits (see buildDeferredCommandBuffer)
 	uint32_t maxDrawDistance = 16;
 
 	vks::Frustum frustum;
@@ -307,15 +935,18 @@ public:
 		glm::vec4 viewPos;
 	} uboFragmentLights;
 
+	// Per frame uniform buffers are part of the frame resources (see Frame)
 	struct {
 		vks::Buffer vsFullScreen;
-		vks::Buffer vsOffscreen;
-		vks::Buffer fsLights;
 	} uniformBuffers;
 
 	struct {
 		VkPipeline composition;
 		VkPipeline offscreen;
+		// Cell position from per instance data instead of a push constant (GPU culling)
+		VkPipeline offscreenIndirect;
+		// World space vertices of the merged chunk meshes
+		VkPipeline offscreenMerged;
 	} pipelines;
 
 	struct {
@@ -324,11 +955,9 @@ public:
 	} pipelineLayouts;
 
 	struct {
-		VkDescriptorSet model;
 		VkDescriptorSet floor;
 	} descriptorSets;
 
-	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
 	struct {
@@ -350,34 +979,161 @@ public:
 		FrameBufferAttachment depth;
 		VkRenderPass renderPass;
 		VkSampler sampler;
-		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
 		VkSemaphore semaphore;
 	} deferredPass;
 
-	VkCommandBuffer compositionCB = VK_NULL_HANDLE;
-	VkCommandBuffer renderCB = VK_NULL_HANDLE;
-
-	dungeongenerator::Dungeon *dungeon;
+	dungeongenerator::Dungeon *dungeon = nullptr;
+	// Unbounded world made of chunks that are generated while walking (enabled via "-chunked"), replaces the single dungeon
+	dungeongenerator::ChunkedDungeon *chunkedDungeon = nullptr;
+	// Cell access used for movement and culling, independent of the dungeon type
+	dungeongenerator::CellAccessor *cells = nullptr;
+	// Accessor for the single dungeon (cells points to it)
+	std::unique_ptr<dungeongenerator::DungeonAccessor> dungeonAccessor;
 	DungeonMap dungeonMap;
+	// Cells visible from each cell of the single dungeon (within the draw distance), used for culling and the fog of war
+	dungeongenerator::PotentiallyVisibleSet visibility;
+	// Rooms and corridors connected by doors, cells are only drawn if they can be seen through the portals leading to them
+	dungeongenerator::PortalGraph portalGraph;
+	// Bounds of the cells below each partition of the single dungeon, lets frustum culling skip whole partitions
+	dungeongenerator::CellHierarchy cellHierarchy;
+	// Compute shader culling and indirect draws for the single dungeon (enabled via "-gpuculling")
+	GpuCulling gpuCulling;
+
+	/*
+		Worker threads for building the visibility data and the merged meshes at startup and for recording the deferred
+		pass every time it's rebuilt
+		Command pools must not be used by more than one thread at a time, so each thread records its part of the
+		deferred pass into a secondary command buffer from its own pool. The primary command buffer executes them in
+		thread order
+	*/
+	vks::ThreadPool threadPool;
+	uint32_t numThreads;
+	struct RecordingThread {
+		VkCommandPool commandPool;
+		VkCommandBuffer commandBuffer;
+		// Faces of the visible cells of the thread's rows batched by face type and texture set (CPU culling)
+		CellInstances cellInstances;
+		// False if the thread had nothing to draw (command buffer is not executed)
+		bool recorded;
+	};
+
+	/*
+		Command buffers, uniform buffers and descriptor sets that are recorded or written while earlier frames may
+		still be executing, one set per frame in flight (indexed by currentFrame)
+		A frame's resources are only touched after prepareFrame has waited for the previous frame of the same slot
+	*/
+	struct Frame {
+		// Offscreen rendering of the scene to the G-Buffer
+		VkCommandBuffer deferredCB = VK_NULL_HANDLE;
+		// Set if the deferred pass has to be re-recorded before the slot's next submission (e.g. the view changed)
+		bool deferredOutdated = true;
+		// Visible set the deferred pass was last recorded for
+		VisibleSet recordedSet;
+		VkCommandBuffer compositionCB = VK_NULL_HANDLE;
+		VkCommandBuffer renderCB = VK_NULL_HANDLE;
+		struct {
+			vks::Buffer vsOffscreen;
+			vks::Buffer fsLights;
+		} uniformBuffers;
+		struct {
+			VkDescriptorSet model;
+			VkDescriptorSet composition;
+		} descriptorSets;
+		std::vector<RecordingThread> recordingThreads;
+	};
+	std::array<Frame, maxFramesInFlight> frames;
+	// Merged static geometry of the single dungeon's chunks (enabled via "-mergedmesh")
+	MergedMesh mergedMesh;
+	// Walk through all rooms of the single dungeon (enabled via "-walkthrough")
+	ScriptedWalk walk;
+	// Set while the player is moving or turning
+	bool playerMoving = false;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Vulkan Dungeon Crawler";
 		enableTextOverlay = true;
 
-		srand(time(NULL));
+		// Random seed unless a fixed one is passed via "-seed", benchmark runs always use the same dungeon
+		uint64_t seed = benchmark.active ? 0 : time(NULL);
+		bool chunked = false;
+		for (size_t i = 0; i < args.size(); i++) {
+			if ((args[i] == std::string("-seed")) && (args.size() > i + 1)) {
+				char* endptr;
+				uint64_t s = strtoull(args[i + 1], &endptr, 10);
+				if (endptr != args[i + 1]) { seed = s; };
+			}
+			if (args[i] == std::string("-chunked")) {
+				chunked = true;
+			}
+			if (args[i] == std::string("-gpuculling")) {
+				gpuCulling.requested = true;
+			}
+			if (args[i] == std::string("-mergedmesh")) {
+				mergedMesh.enabled = true;
+			}
+			if (args[i] == std::string("-walkthrough")) {
+				walk.active = true;
+			}
+		}
 
-		dungeon = new dungeongenerator::Dungeon(64, 64);
-		dungeon->generateRooms();
-		dungeon->generateWalls();
-		dungeon->generateDoors();
+		numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+		threadPool.setThreadCount(numThreads);
 
-		dungeongenerator::BspPartition* startingRoom = dungeon->getRandomRoom();
+		glm::ivec2 startPosition;
+		if (chunked) {
+			chunkedDungeon = new dungeongenerator::ChunkedDungeon(seed);
+			chunkedDungeon->getRoomCenter(0, 0, startPosition.x, startPosition.y);
+			cells = chunkedDungeon;
+		}
+		else {
+			dungeon = new dungeongenerator::Dungeon(64, 64, seed);
+			dungeon->generateRooms();
+			dungeon->generateCorridors();
+			dungeon->generateWalls();
+			dungeon->generateDoors();
+			dungeongenerator::BspPartition* startingRoom = dungeon->getRandomRoom();
+			if (!startingRoom) {
+				vks::tools::exitFatal("The dungeon doesn't contain any rooms to start in!", "Fatal error");
+			}
+			startPosition = glm::ivec2(startingRoom->centerX, startingRoom->centerY);
+			dungeonAccessor.reset(new dungeongenerator::DungeonAccessor(dungeon));
+			cells = dungeonAccessor.get();
+			visibility.build(*dungeon, (int)maxDrawDistance, &threadPool);
+			portalGraph.build(*dungeon);
+			cellHierarchy.build(*dungeon);
+			gpuCulling.dungeon = dungeon;
+		}
+		// GPU culling and merged meshes are only implemented for the single dungeon, GPU culling takes precedence
+		gpuCulling.requested &= (dungeon != nullptr);
+		mergedMesh.enabled &= (dungeon != nullptr) && (!gpuCulling.requested);
+		if (mergedMesh.enabled) {
+			mergedMesh.mesh.build(*cells, dungeon->width, dungeon->height, 16, &threadPool);
+		}
 
-		player.setDungeon(dungeon);
+		player.setCellAccessor(cells);
 		player.setPerspective(60.0f, (float)width / (float)height, 0.1f, 1024.0f);
 		player.setRotation(glm::vec3(0.0f, 0.0f, 0.0f));
-		player.setPosition(glm::vec3(startingRoom->centerX, 0.5f, startingRoom->centerY));
+		player.setPosition(glm::vec3(startPosition.x, 0.5f, startPosition.y));
+
+		walk.active &= (dungeon != nullptr);
+		if (walk.active) {
+			dungeongenerator::Pathfinder pathfinder;
+			pathfinder.build(*dungeon);
+			dungeongenerator::Walkthrough walkthrough;
+			walkthrough.build(*dungeon, pathfinder, startPosition.x, startPosition.y);
+			walk.path = walkthrough.path;
+			walk.width = dungeon->width;
+			walk.roomCount = static_cast<uint32_t>(walkthrough.rooms.size());
+			/*
+				The warm up run starts the walk, so the measured frames begin somewhere within a round of the walk
+				Measuring at least one whole period still renders every frame of the walk
+			*/
+			if (benchmark.active) {
+				const uint32_t frameCount = walk.getFrameCount(player);
+				benchmark.framesPerIteration = std::max((frameCount + benchmark.iterationCount - 1) / benchmark.iterationCount, 1u);
+			}
+		}
 
 		// White
 		uboFragmentLights.lights[0].position = glm::vec4(player.position, 0.0f) + glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
@@ -422,12 +1178,26 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayouts.composition, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.offscreen, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-		uniformBuffers.vsOffscreen.destroy();
 		uniformBuffers.vsFullScreen.destroy();
-		uniformBuffers.fsLights.destroy();
-		vkFreeCommandBuffers(device, cmdPool, 1, &deferredPass.commandBuffer);
+		for (auto &frame : frames) {
+			frame.uniformBuffers.vsOffscreen.destroy();
+			frame.uniformBuffers.fsLights.destroy();
+			vkFreeCommandBuffers(device, cmdPool, 1, &frame.deferredCB);
+			for (auto &thread : frame.recordingThreads) {
+				thread.cellInstances.destroy();
+				vkDestroyCommandPool(device, thread.commandPool, nullptr);
+			}
+		}
 		vkDestroyRenderPass(device, deferredPass.renderPass, nullptr);
 		vkDestroySemaphore(device, deferredPass.semaphore, nullptr);
+		if (gpuCulling.enabled) {
+			vkDestroyPipeline(device, pipelines.offscreenIndirect, nullptr);
+			gpuCulling.destroy(device);
+		}
+		else if (mergedMesh.enabled) {
+			vkDestroyPipeline(device, pipelines.offscreenMerged, nullptr);
+			mergedMesh.destroy();
+		}
 	}
 
 	// Enable physical device features required for this example				
@@ -436,6 +1206,18 @@ public:
 		if (deviceFeatures.samplerAnisotropy) {
 			enabledFeatures.samplerAnisotropy = VK_TRUE;
 		}
+		// GPU culling passes the cell index as the first instance of the indirect draws and takes the draw count from a buffer
+		if (gpuCulling.requested) {
+			gpuCulling.enabled = gpuCulling.checkDeviceSupport(physicalDevice, deviceFeatures);
+			if (gpuCulling.enabled) {
+				enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+				enabledFeatures.multiDrawIndirect = VK_TRUE;
+				enabledExtensions.push_back(gpuCulling.drawIndirectCountExtension);
+			}
+			else {
+				std::cerr << "GPU culling not supported by the device (needs multi draw indirect, first instance and draw indirect count), using CPU culling" << std::endl;
+			}
+		}
 	};
 
 	/*
@@ -675,10 +1457,11 @@ public:
 
 		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		// The depth attachment is shared by all frames in flight, so the depth clear and writes also wait for the previous frame's depth writes
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 		dependencies[1].srcSubpass = 0;
@@ -733,99 +1516,157 @@ public:
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &deferredPass.sampler));
 	}
 
+	// Load the chunks around the player
+	void updateChunks() {
+		chunkedDungeon->update((int32_t)round(player.position.x), (int32_t)round(player.position.z), maxDrawDistance + 1);
+	}
+
 	/*
-		Pre-build secondary command buffers for each cell
+		Apply pending dungeon edits: update walls and doors of the edited area and rebuild only what depends on the changed cells
 	*/
-	// TODO: Move into cell class
-	void generateCellCommandBuffers() {
-		for (uint32_t x = 0; x < dungeon->width; x++) {
-			for (uint32_t y = 0; y < dungeon->height; y++) {
-				dungeongenerator::Cell *cell = dungeon->cells[x][y];
+	void applyDungeonChanges() {
+		if (dungeon->updateDirtyRegions() == 0) {
+			return;
+		}
+		dungeonMap.applyChanges(dungeon->changedCells);
+		visibility.update(*dungeon, dungeon->changedCells);
+		if (gpuCulling.enabled) {
+			// The culling shader reads the cells directly, the command buffers stay the same
+			waitForFrames();
+			gpuCulling.updateCells(dungeon->changedCells);
+			return;
+		}
+		if (mergedMesh.enabled) {
+			mergedMesh.mesh.update(*cells, dungeon->changedCells, &threadPool);
+			mergedMesh.upload(queue);
+		}
+		portalGraph.build(*dungeon);
+		cellHierarchy.build(*dungeon);
+		// Instances and chunk draws are gathered when recording, so the command buffers have to be recorded even if
+		// the visible set stays the same
+		for (auto &frame : frames) {
+			frame.recordedSet.valid = false;
+		}
+		invalidateDeferredCommandBuffers();
+	}
 
-//				glm::vec3 pos = glm::vec3(x * 1.0f - dungeon->width * 0.5f, 0.0, y * 1.0f - dungeon->height * 0.5f);
-				glm::vec3 pos = glm::vec3((float)x, 0.0f, (float)y);
+	// The visible set of every frame slot is updated before the slot is submitted next
+	void invalidateDeferredCommandBuffers()
+	{
+		for (auto &frame : frames) {
+			frame.deferredOutdated = true;
+		}
+	}
 
-				if (cell->type == dungeongenerator::Cell::cellTypeEmpty) {
-					continue;
-				}
+	/*
+		Update the culling parameters for the GPU and uncover the fog of war
+	*/
+	void updateGpuCulling()
+	{
+		vks::FrameProfiler::CpuScope profilerScope(profiler, profilerStages.culling);
+		frustum.update(player.matrices.projection * player.matrices.view);
+		gpuCulling.updateUniforms(frustum, player.position, (float)maxDrawDistance, topdown);
+		uncoverPotentiallyVisibleCells();
+	}
 
-				/*
-					Secondary command buffer for scene display
-				*/
-				{
-					VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
-					inheritanceInfo.renderPass = deferredPass.renderPass;
-					inheritanceInfo.framebuffer = deferredPass.frameBuffer;
+	/*
+		Uncover the cells around the player that can be seen from the player's cell, used if cells aren't culled one
+		by one on the CPU (the fog of war isn't limited to the frustum then)
+	*/
+	void uncoverPotentiallyVisibleCells()
+	{
+		const glm::ivec2 playerCell = glm::ivec2(round(player.position.x), round(player.position.z));
+		if ((playerCell.x < 0) || (playerCell.y < 0) || (playerCell.x >= dungeon->width) || (playerCell.y >= dungeon->height)) {
+			return;
+		}
+		const uint32_t playerIndex = dungeon->getCellIndex(playerCell.x, playerCell.y);
+		const int32_t range = (int32_t)maxDrawDistance;
+		for (int32_t y = std::max(playerCell.y - range, 0); y <= std::min(playerCell.y + range, dungeon->height - 1); y++) {
+			dungeonMap.uncover(playerCell.x - range, y, visibility.getRow(playerIndex, y - playerCell.y));
+		}
+	}
+
+	/*
+		Build the command buffer for GPU driven rendering of the scene to the offscreen frame buffer attachments
+		Doesn't depend on the view, so it's only recorded once per frame slot
+	*/
+	void buildGpuDrivenCommandBuffer()
+	{
+		VkCommandBuffer deferredCB = frames[currentFrame].deferredCB;
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
-					VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
-					vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &cell->commandBuffer);
+		std::array<VkClearValue, 4> clearValues;
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		clearValues[3].depthStencil = { 1.0f, 0 };
 
-					VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
-					commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
-					commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = deferredPass.renderPass;
+		renderPassBeginInfo.framebuffer = deferredPass.frameBuffer;
+		renderPassBeginInfo.renderArea.extent.width = deferredPass.width;
+		renderPassBeginInfo.renderArea.extent.height = deferredPass.height;
+		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+		renderPassBeginInfo.pClearValues = clearValues.data();
 
-					vkBeginCommandBuffer(cell->commandBuffer, &commandBufferBeginInfo);
+		VK_CHECK_RESULT(vkBeginCommandBuffer(deferredCB, &cmdBufInfo));
 
-					VkViewport viewport = vks::initializers::viewport((float)deferredPass.width, (float)deferredPass.height, 0.0f, 1.0f);
-					vkCmdSetViewport(cell->commandBuffer, 0, 1, &viewport);
+		if (vks::debugmarker::active) {
+			vks::debugmarker::beginRegion(deferredCB, "Dungeon (GPU culling)", glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+		}
 
-					VkRect2D scissor = vks::initializers::rect2D(deferredPass.width, deferredPass.height, 0, 0);
-					vkCmdSetScissor(cell->commandBuffer, 0, 1, &scissor);
+		profiler.writeTimestamp(deferredCB, currentFrame, profilerStages.culling, false);
+		gpuCulling.recordCulling(deferredCB, currentFrame);
+		profiler.writeTimestamp(deferredCB, currentFrame, profilerStages.culling, true);
 
-					vkCmdBindPipeline(cell->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
+		profiler.writeTimestamp(deferredCB, currentFrame, profilerStages.deferredPass, false);
+		vkCmdBeginRenderPass(deferredCB, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-					VkDeviceSize offsets[1] = { 0 };
+		VkViewport viewport = vks::initializers::viewport((float)deferredPass.width, (float)deferredPass.height, 0.0f, 1.0f);
+		vkCmdSetViewport(deferredCB, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(deferredPass.width, deferredPass.height, 0, 0);
+		vkCmdSetScissor(deferredCB, 0, 1, &scissor);
 
-					std::vector<VkDescriptorSet> bindDescSets = {
-						descriptorSets.model,
-						textureSets.default.descriptorSet,
-					};
-					vkCmdBindDescriptorSets(cell->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.offscreen, 0, static_cast<uint32_t>(bindDescSets.size()), bindDescSets.data(), 0, nullptr);
-					vkCmdBindVertexBuffers(cell->commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
-					vkCmdBindIndexBuffer(cell->commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdBindPipeline(deferredCB, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreenIndirect);
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(deferredCB, 0, 1, &vertexBuffer.buffer, offsets);
+		vkCmdBindIndexBuffer(deferredCB, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+		// Same texture set order as GpuCulling::Cell::textureSet
+		const VkDescriptorSet cellTextureSets[GpuCulling::textureSetCount] = { textureSets.default.descriptorSet, textureSets.corridor.descriptorSet };
+		gpuCulling.recordDraws(deferredCB, pipelineLayouts.offscreen, frames[currentFrame].descriptorSets.model, cellTextureSets);
 
-					if (cell->type != dungeongenerator::Cell::cellTypeEmpty) {
-						if (cell->type == dungeongenerator::Cell::cellTypeCorridor) {
-							bindDescSets[1] = textureSets.corridor.descriptorSet;
-							vkCmdBindDescriptorSets(cell->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.offscreen, 0, static_cast<uint32_t>(bindDescSets.size()), bindDescSets.data(), 0, nullptr);
-						}
-						else {
-							bindDescSets[1] = textureSets.default.descriptorSet;
-							vkCmdBindDescriptorSets(cell->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.offscreen, 0, static_cast<uint32_t>(bindDescSets.size()), bindDescSets.data(), 0, nullptr);
-						}
-						vkCmdPushConstants(cell->commandBuffer, pipelineLayouts.offscreen, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec3), &pos);
-						vkCmdDrawIndexed(cell->commandBuffer, 6, 1, INDEX_OFFSET_FLOOR, 0, 0);
-						if (cell->walls[cell->dirNorth]) {
-							vkCmdDrawIndexed(cell->commandBuffer, 6, 1, INDEX_OFFSET_WALL_NORTH, 0, 0);
-						}
-						if (cell->walls[cell->dirSouth]) {
-							vkCmdDrawIndexed(cell->commandBuffer, 6, 1, INDEX_OFFSET_WALL_SOUTH, 0, 0);
-						}
-						if (cell->walls[cell->dirEast]) {
-							vkCmdDrawIndexed(cell->commandBuffer, 6, 1, INDEX_OFFSET_WALL_EAST, 0, 0);
-						}
-						if (cell->walls[cell->dirWest]) {
-							vkCmdDrawIndexed(cell->commandBuffer, 6, 1, INDEX_OFFSET_WALL_WEST, 0, 0);
-						}
-						if (!topdown) {
-							vkCmdDrawIndexed(cell->commandBuffer, 6, 1, INDEX_OFFSET_CEILING, 0, 0);
-						}
-					}
+		vkCmdEndRenderPass(deferredCB);
+		profiler.writeTimestamp(deferredCB, currentFrame, profilerStages.deferredPass, true);
 
-					vkEndCommandBuffer(cell->commandBuffer);
-				}
-			}
+		if (vks::debugmarker::active) {
+			vks::debugmarker::endRegion(deferredCB);
 		}
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(deferredCB));
 	}
 
 	/*
-		Build command buffer for rendering the scene to the offscreen frame buffer attachments
+		Cull the merged chunk meshes as a whole against the draw distance and the frustum
 	*/
-	void buildDeferredCommandBuffer()
+	void cullMergedChunks()
+	{
+		frustum.update(player.matrices.projection * player.matrices.view);
+		mergedMesh.cull(frustum, player.position, (float)maxDrawDistance);
+		uncoverPotentiallyVisibleCells();
+
+		visibleSet.valid = true;
+		visibleSet.ceiling = !topdown;
+		visibleSet.chunks = mergedMesh.visibleChunks;
+	}
+
+	/*
+		Build the command buffer for rendering the visible merged chunk meshes to the offscreen frame buffer attachments
+	*/
+	void buildMergedMeshCommandBuffer()
 	{
+		VkCommandBuffer deferredCB = frames[currentFrame].deferredCB;
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
-		// Clear values for all attachments written in the fragment sahder
 		std::array<VkClearValue, 4> clearValues;
 		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
 		clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
@@ -840,73 +1681,270 @@ public:
 		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassBeginInfo.pClearValues = clearValues.data();
 
-		VK_CHECK_RESULT(vkBeginCommandBuffer(deferredPass.commandBuffer, &cmdBufInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(deferredCB, &cmdBufInfo));
 
 		if (vks::debugmarker::active) {
-			vks::debugmarker::beginRegion(deferredPass.commandBuffer, "Dungeon", glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+			vks::debugmarker::beginRegion(deferredCB, "Dungeon (merged chunks)", glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+		}
+
+		profiler.writeTimestamp(deferredCB, currentFrame, profilerStages.deferredPass, false);
+		vkCmdBeginRenderPass(deferredCB, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+		// Visible chunks are split into one block per thread
+		const uint32_t chunkCount = static_cast<uint32_t>(visibleSet.chunks.size());
+		const uint32_t chunksPerThread = (chunkCount + numThreads - 1) / numThreads;
+		for (uint32_t t = 0; t < numThreads; t++) {
+			threadPool.threads[t]->addJob([=] {
+				RecordingThread &thread = frames[currentFrame].recordingThreads[t];
+				const uint32_t firstChunk = std::min(t * chunksPerThread, chunkCount);
+				const uint32_t count = std::min(chunksPerThread, chunkCount - firstChunk);
+				thread.recorded = (count > 0);
+				if (!thread.recorded) {
+					return;
+				}
+				VkCommandBuffer commandBuffer = beginRecordingThread(thread);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreenMerged);
+				// Same texture set order as dungeongenerator::DungeonMesh::getTextureSet
+				const VkDescriptorSet meshTextureSets[dungeongenerator::DungeonMesh::textureSetCount] = { textureSets.default.descriptorSet, textureSets.corridor.descriptorSet };
+				mergedMesh.recordDraws(commandBuffer, pipelineLayouts.offscreen, frames[currentFrame].descriptorSets.model, meshTextureSets, visibleSet.ceiling, firstChunk, count);
+				VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+			});
 		}
+		threadPool.wait();
+		executeRecordingThreads(deferredCB);
 
-		vkCmdBeginRenderPass(deferredPass.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		vkCmdEndRenderPass(deferredCB);
+		profiler.writeTimestamp(deferredCB, currentFrame, profilerStages.deferredPass, true);
 
-		// Render dungeon cells
+		if (vks::debugmarker::active) {
+			vks::debugmarker::endRegion(deferredCB);
+		}
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(deferredCB));
+	}
+
+	/*
+		Cull the cells within the draw distance for the current view and uncover the fog of war
+	*/
+	void cullCells()
+	{
 		cellsVisible = 0;
+		cellsInFrustum = 0;
 
-		frustum.update(player.matrices.projection * player.matrices.view);
+		const glm::mat4 viewProjection = player.matrices.projection * player.matrices.view;
+		frustum.update(viewProjection);
 
-		std::vector<VkCommandBuffer> commandBuffers;
-		#pragma omp parallel for
-		for (int32_t x = 0; x < dungeon->width; x++) {
-			for (int32_t y = 0; y < dungeon->height; y++) {
-				if ((dungeon->cells[x][y]->type != dungeongenerator::Cell::cellTypeEmpty)) {
+		// The top down view looks over the walls, so portals don't hide anything there
+		const bool portalCulling = (dungeon != nullptr) && (!topdown) && (portalGraph.traverse(&viewProjection[0][0], player.position.x, player.position.z, (float)maxDrawDistance));
+
+		// Chunks within the draw distance must be loaded before the cells are accessed from multiple threads
+		if (chunkedDungeon) {
+			updateChunks();
+		}
+
+		/*
+			Only cells within the draw distance around the player are drawn, the results are kept per row of the draw
+			distance window as bit masks (bit i stands for x = left + i)
+			The single dungeon is culled through the cell hierarchy, which rejects or accepts whole partitions against
+			the frustum and the draw distance. Cells passing the frustum test are then checked against the player cell's
+			potentially visible set (except for the top down view, which looks over the walls) and the rectangle their
+			room or corridor is seen through (portal culling). The fog of war uncovers the visible cells of the set
+			The chunked world tests all cells of the window, each row is culled by one thread that only writes that
+			row's results
+			The rows are gathered in order so the instances of each batch are always sorted by cell (y first, then x)
+		*/
+		const glm::ivec2 playerCell = glm::ivec2(round(player.position.x), round(player.position.z));
+		const int32_t range = (int32_t)maxDrawDistance;
+		const int32_t left = playerCell.x - range;
+		const bool hasVisibility = (dungeon != nullptr) && (playerCell.x >= 0) && (playerCell.y >= 0) && (playerCell.x < dungeon->width) && (playerCell.y < dungeon->height);
+		const uint32_t playerIndex = hasVisibility ? dungeon->getCellIndex(playerCell.x, playerCell.y) : 0;
+		const uint64_t windowBits = ~0ULL >> (63 - 2 * range);
+
+		frustumRows.assign(2 * range + 1, 0);
+		visibleRows.assign(2 * range + 1, 0);
+
+		if (dungeon) {
+			culledCells.clear();
+			cellHierarchy.cull(&frustum.planes[0].x, &player.position.x, (float)maxDrawDistance, culledCells);
+			culledCellsVisible.resize(culledCells.size());
+
+			#pragma omp parallel for
+			for (int32_t i = 0; i < (int32_t)culledCells.size(); i++) {
+				const int32_t x = culledCells[i] % dungeon->width;
+				const int32_t y = culledCells[i] / dungeon->width;
+				bool visible = (!hasVisibility) || (topdown) || ((visibility.getRow(playerIndex, y - playerCell.y) >> (x - left)) & 1);
+				if ((visible) && (portalCulling)) {
+					const glm::vec3 boxMin = glm::vec3((float)x - 0.5f, -2.5f, (float)y - 0.5f);
+					const glm::vec3 boxMax = glm::vec3((float)x + 0.5f, 2.5f, (float)y + 0.5f);
+					visible = portalGraph.isBoxVisible(culledCells[i], &boxMin.x, &boxMax.x, &viewProjection[0][0]);
+				}
+				culledCellsVisible[i] = visible ? 1 : 0;
+			}
+
+			// Cells within the draw distance are always inside of the window
+			for (size_t i = 0; i < culledCells.size(); i++) {
+				const int32_t x = culledCells[i] % dungeon->width;
+				const int32_t y = culledCells[i] / dungeon->width;
+				const uint64_t bit = 1ULL << (x - left);
+				frustumRows[y - playerCell.y + range] |= bit;
+				if (culledCellsVisible[i]) {
+					visibleRows[y - playerCell.y + range] |= bit;
+				}
+			}
+		}
+		else {
+			#pragma omp parallel for
+			for (int32_t y = playerCell.y - range; y <= playerCell.y + range; y++) {
+				uint64_t frustumBits = 0;
+				for (uint64_t bits = windowBits; bits != 0; bits &= bits - 1) {
+					const uint32_t bit = dungeongenerator::BitPlane::getLowestBit(bits);
+					const int32_t x = left + (int32_t)bit;
+					if (cells->getCellType(x, y) == dungeongenerator::Cell::cellTypeEmpty) {
+						continue;
+					}
 					glm::vec3 pos = glm::vec3((float)x, 0.0f, (float)y);
 					glm::vec3 cpos = player.position;
 					if (std::abs(glm::length(pos - cpos)) > maxDrawDistance) {
 						continue;
 					}
-					dungeongenerator::Cell *cell = dungeon->cells[x][y];
 					uint32_t frustumCheck = frustum.checkBox(pos, glm::vec3(0.5f, 2.5f, 0.5f));
 					if (!(frustumCheck & 1)) {
 						continue;
 					}
-
-					#pragma omp critical
-					{
-						if (!cell->uncovered) {
-							glm::ivec2 start = glm::ivec2(round(player.position.x), round(player.position.z));
-							if (dungeonMap.checkVisibility(start, glm::ivec2(x, y))) {
-								cell->uncovered = true;
-								dungeonMap.update = true;
-							}
-						}
-						if (cell->commandBuffer != VK_NULL_HANDLE) {
-							commandBuffers.push_back(cell->commandBuffer);
-							cellsVisible++;
-						}
-					}
+					frustumBits |= 1ULL << bit;
 				}
+				frustumRows[y - playerCell.y + range] = frustumBits;
+				visibleRows[y - playerCell.y + range] = frustumBits;
+			}
+		}
+
+		for (int32_t row = 0; row <= 2 * range; row++) {
+			const int32_t y = playerCell.y - range + row;
+			cellsInFrustum += dungeongenerator::BitPlane::getBitCount(frustumRows[row]);
+			// Fog of war is only kept for the single dungeon
+			if (hasVisibility) {
+				dungeonMap.uncover(left, y, visibleRows[row] & visibility.getRow(playerIndex, y - playerCell.y));
 			}
+			cellsVisible += dungeongenerator::BitPlane::getBitCount(visibleRows[row]);
+		}
+
+		visibleSet.valid = true;
+		visibleSet.ceiling = !topdown;
+		visibleSet.origin = glm::ivec2(left, playerCell.y - range);
+		visibleSet.rows = visibleRows;
+	}
+
+	// Culls the cells or chunks for the current view into visibleSet
+	void updateVisibleSet()
+	{
+		if (mergedMesh.enabled) {
+			cullMergedChunks();
+		}
+		else {
+			cullCells();
+		}
+	}
+
+	/*
+		Build command buffer for rendering the scene to the offscreen frame buffer attachments
+		Except for GPU driven rendering the visible set has to be up to date (see updateVisibleSet)
+	*/
+	void buildDeferredCommandBuffer()
+	{
+		if (gpuCulling.enabled) {
+			buildGpuDrivenCommandBuffer();
+			return;
+		}
+		if (mergedMesh.enabled) {
+			buildMergedMeshCommandBuffer();
+			return;
+		}
+
+		VkCommandBuffer deferredCB = frames[currentFrame].deferredCB;
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+		// Clear values for all attachments written in the fragment sahder
+		std::array<VkClearValue, 4> clearValues;
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		clearValues[2].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		clearValues[3].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = deferredPass.renderPass;
+		renderPassBeginInfo.framebuffer = deferredPass.frameBuffer;
+		renderPassBeginInfo.renderArea.extent.width = deferredPass.width;
+		renderPassBeginInfo.renderArea.extent.height = deferredPass.height;
+		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+		renderPassBeginInfo.pClearValues = clearValues.data();
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(deferredCB, &cmdBufInfo));
+
+		if (vks::debugmarker::active) {
+			vks::debugmarker::beginRegion(deferredCB, "Dungeon", glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
 		}
 
-		if (commandBuffers.size() > 0) {
-			vkCmdExecuteCommands(deferredPass.commandBuffer, commandBuffers.size(), commandBuffers.data());
+		profiler.writeTimestamp(deferredCB, currentFrame, profilerStages.deferredPass, false);
+		vkCmdBeginRenderPass(deferredCB, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+		/*
+			Each thread gathers the instances of a block of consecutive rows into its own instance buffer and records
+			their draws into its secondary command buffer, so the draws are still executed in row order
+		*/
+		const int32_t rowCount = static_cast<int32_t>(visibleSet.rows.size());
+		const int32_t rowsPerThread = (rowCount + (int32_t)numThreads - 1) / (int32_t)numThreads;
+		for (uint32_t t = 0; t < numThreads; t++) {
+			threadPool.threads[t]->addJob([=] {
+				RecordingThread &thread = frames[currentFrame].recordingThreads[t];
+				CellInstances &cellInstances = thread.cellInstances;
+				cellInstances.clear();
+				for (int32_t row = (int32_t)t * rowsPerThread; row < std::min(((int32_t)t + 1) * rowsPerThread, rowCount); row++) {
+					const int32_t y = visibleSet.origin.y + row;
+					for (uint64_t bits = visibleSet.rows[row]; bits != 0; bits &= bits - 1) {
+						cellInstances.addCell(cells, visibleSet.origin.x + (int32_t)dungeongenerator::BitPlane::getLowestBit(bits), y, visibleSet.ceiling);
+					}
+				}
+				cellInstances.upload();
+				thread.recorded = (cellInstances.instanceCount > 0);
+				if (!thread.recorded) {
+					return;
+				}
+				VkCommandBuffer commandBuffer = beginRecordingThread(thread);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
+				VkDeviceSize offsets[1] = { 0 };
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
+				vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+				// Same texture set order as CellInstances::addCell
+				const VkDescriptorSet cellTextureSets[CellInstances::textureSetCount] = { textureSets.default.descriptorSet, textureSets.corridor.descriptorSet };
+				cellInstances.recordDraws(commandBuffer, pipelineLayouts.offscreen, frames[currentFrame].descriptorSets.model, cellTextureSets);
+				VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+			});
 		}
+		threadPool.wait();
+		executeRecordingThreads(deferredCB);
 
-		vkCmdEndRenderPass(deferredPass.commandBuffer);
+		vkCmdEndRenderPass(deferredCB);
+		profiler.writeTimestamp(deferredCB, currentFrame, profilerStages.deferredPass, true);
 
 		if (vks::debugmarker::active) {
-			vks::debugmarker::endRegion(deferredPass.commandBuffer);
+			vks::debugmarker::endRegion(deferredCB);
 		}
 
-		VK_CHECK_RESULT(vkEndCommandBuffer(deferredPass.commandBuffer));
+		VK_CHECK_RESULT(vkEndCommandBuffer(deferredCB));
 	}
 
 	void loadAssets()
 	{
-		textureSets.default.load("default", vulkanDevice, queue);
+		// Merged faces span several texture repeats, single cell faces stay within the texture
+		const VkSamplerAddressMode addressMode = mergedMesh.enabled ? VK_SAMPLER_ADDRESS_MODE_REPEAT : VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		textureSets.default.load("default", vulkanDevice, queue, addressMode);
 	}
 
 	void buildCommandBuffers()
 	{
+		Frame &frame = frames[currentFrame];
+		VkCommandBuffer &compositionCB = frame.compositionCB;
+		VkCommandBuffer &renderCB = frame.renderCB;
 		if (compositionCB == VK_NULL_HANDLE) {
 			compositionCB = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY, false);
 
@@ -924,9 +1962,11 @@ public:
 			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 			vkCmdSetScissor(compositionCB, 0, 1, &scissor);
 			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindDescriptorSets(compositionCB, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.composition, 0, 1, &descriptorSet, 0, NULL);
+			vkCmdBindDescriptorSets(compositionCB, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.composition, 0, 1, &frame.descriptorSets.composition, 0, NULL);
 			vkCmdBindPipeline(compositionCB, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
+			profiler.writeTimestamp(compositionCB, currentFrame, profilerStages.composition, false);
 			vkCmdDraw(compositionCB, 4, 1, 0, 0);
+			profiler.writeTimestamp(compositionCB, currentFrame, profilerStages.composition, true);
 			VK_CHECK_RESULT(vkEndCommandBuffer(compositionCB));
 		}
 
@@ -957,7 +1997,7 @@ public:
 			if (vks::debugmarker::active) {
 				vks::debugmarker::beginRegion(renderCB, "Map overlay", glm::vec4(0.0f, 1.0f, 0.0f, 1.0f));
 			}
-			vkCmdExecuteCommands(renderCB, 1, &dungeonMap.commandBuffer);
+			vkCmdExecuteCommands(renderCB, 1, &dungeonMap.frames[currentFrame].commandBuffer);
 			if (vks::debugmarker::active) {
 				vks::debugmarker::endRegion(renderCB);
 			}
@@ -1043,14 +2083,32 @@ public:
 			pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
 			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &dungeonMap.pipelineLayout));
 		}
+		/*
+			GPU culling compute pipeline layout
+		*/
+		if (gpuCulling.enabled) {
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			};
+			VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &gpuCulling.descriptorSetLayout));
+			VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&gpuCulling.descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &gpuCulling.pipelineLayout));
+		}
 	}
 
 	void setupDescriptorSets()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
+			// Composition, scene, map and GPU culling per frame in flight
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5 * maxFramesInFlight),
 			// TODO: Number of combined image samplers from no. of loaded texture presets
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 64),
+			// GPU culling
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * maxFramesInFlight),
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 128);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -1059,7 +2117,8 @@ public:
 			G-Buffer composition
 		*/
 		// Image descriptors for the offscreen color attachments
-		{
+		for (auto &frame : frames) {
+			VkDescriptorSet &descriptorSet = frame.descriptorSets.composition;
 			VkDescriptorSetAllocateInfo allocInfo =
 				vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
 			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
@@ -1074,7 +2133,7 @@ public:
 				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texDescriptorPosition),
 				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &texDescriptorNormal),
 				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &texDescriptorAlbedo),
-				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.fsLights.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &frame.uniformBuffers.fsLights.descriptor),
 			};
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 		}
@@ -1083,14 +2142,16 @@ public:
 			Scene rendering
 		*/
 		{
-			VkDescriptorSetAllocateInfo allocInfo =
-				vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.uniformBuffers, 1);
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.model));
 			// Uniform buffers
-			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-				vks::initializers::writeDescriptorSet(descriptorSets.model, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.vsOffscreen.descriptor),
-			};
-			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+			for (auto &frame : frames) {
+				VkDescriptorSetAllocateInfo allocInfo =
+					vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.uniformBuffers, 1);
+				VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &frame.descriptorSets.model));
+				std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+					vks::initializers::writeDescriptorSet(frame.descriptorSets.model, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &frame.uniformBuffers.vsOffscreen.descriptor),
+				};
+				vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+			}
 			// Texture sets
 			textureSets.default.createDescriptorSet(device, descriptorPool, descriptorSetLayouts.textureSet);
 			textureSets.corridor.createDescriptorSet(device, descriptorPool, descriptorSetLayouts.textureSet);
@@ -1100,11 +2161,27 @@ public:
 			UI
 		*/
 		// Map
-		{
+		for (auto &frame : dungeonMap.frames) {
 			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &dungeonMap.descriptorSetLayout, 1);
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &dungeonMap.descriptorSet));
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &frame.descriptorSet));
 			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-				vks::initializers::writeDescriptorSet(dungeonMap.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &dungeonMap.uniformBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(frame.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &frame.uniformBuffer.descriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+		}
+
+		/*
+			GPU culling
+		*/
+		for (uint32_t i = 0; (gpuCulling.enabled) && (i < maxFramesInFlight); i++) {
+			VkDescriptorSet &descriptorSet = gpuCulling.descriptorSets[i];
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &gpuCulling.descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &gpuCulling.cellBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &gpuCulling.drawBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &gpuCulling.countBuffer.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &gpuCulling.uniformBuffers[i].descriptor),
 			};
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 		}
@@ -1165,7 +2242,7 @@ public:
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.composition));
 
 		// Deferred offscreen rendering pipeline
-		shaderStages[0] = loadShader(getAssetPath() + "shaders/deferred.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[0] = loadShader(getAssetPath() + "shaders/deferred_instanced.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getAssetPath() + "shaders/deferred.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		// Vertex bindings an attributes
 		// Binding description
@@ -1183,7 +2260,17 @@ public:
 		vertexInputState.pVertexBindingDescriptions = vertexInputBindings.data();
 		vertexInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributes.size());
 		vertexInputState.pVertexAttributeDescriptions = vertexInputAttributes.data();
-		pipelineCreateInfo.pVertexInputState = &vertexInputState;
+		// Faces are drawn instanced, the cell position and texture layer are per instance vertex data (binding 1)
+		std::vector<VkVertexInputBindingDescription> instancedInputBindings = vertexInputBindings;
+		instancedInputBindings.push_back(vks::initializers::vertexInputBindingDescription(1, sizeof(CellInstances::Instance), VK_VERTEX_INPUT_RATE_INSTANCE));
+		std::vector<VkVertexInputAttributeDescription> instancedInputAttributes = vertexInputAttributes;
+		instancedInputAttributes.push_back(vks::initializers::vertexInputAttributeDescription(1, 3, VK_FORMAT_R32G32B32A32_SFLOAT, 0));	// Cell position, texture layer
+		VkPipelineVertexInputStateCreateInfo instancedInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+		instancedInputState.vertexBindingDescriptionCount = static_cast<uint32_t>(instancedInputBindings.size());
+		instancedInputState.pVertexBindingDescriptions = instancedInputBindings.data();
+		instancedInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(instancedInputAttributes.size());
+		instancedInputState.pVertexAttributeDescriptions = instancedInputAttributes.data();
+		pipelineCreateInfo.pVertexInputState = &instancedInputState;
 		pipelineCreateInfo.renderPass = deferredPass.renderPass;
 		pipelineCreateInfo.layout = pipelineLayouts.offscreen;
 		std::array<VkPipelineColorBlendAttachmentState, 3> blendAttachmentStates = {
@@ -1194,6 +2281,34 @@ public:
 		colorBlendState.attachmentCount = static_cast<uint32_t>(blendAttachmentStates.size());
 		colorBlendState.pAttachments = blendAttachmentStates.data();
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.offscreen));
+		pipelineCreateInfo.pVertexInputState = &vertexInputState;
+
+		// Merged chunk meshes: per vertex data only, the cell position push constant is zero
+		if (mergedMesh.enabled) {
+			shaderStages[0] = loadShader(getAssetPath() + "shaders/deferred.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.offscreenMerged));
+		}
+
+		// GPU culling: same as the offscreen pipeline with the cell positions as per instance vertex data (binding 1)
+		if (gpuCulling.enabled) {
+			std::vector<VkVertexInputBindingDescription> indirectInputBindings = vertexInputBindings;
+			indirectInputBindings.push_back(vks::initializers::vertexInputBindingDescription(1, sizeof(GpuCulling::Cell), VK_VERTEX_INPUT_RATE_INSTANCE));
+			std::vector<VkVertexInputAttributeDescription> indirectInputAttributes = vertexInputAttributes;
+			indirectInputAttributes.push_back(vks::initializers::vertexInputAttributeDescription(1, 3, VK_FORMAT_R32G32B32_SFLOAT, 0));	// Cell position
+			VkPipelineVertexInputStateCreateInfo indirectInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+			indirectInputState.vertexBindingDescriptionCount = static_cast<uint32_t>(indirectInputBindings.size());
+			indirectInputState.pVertexBindingDescriptions = indirectInputBindings.data();
+			indirectInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(indirectInputAttributes.size());
+			indirectInputState.pVertexAttributeDescriptions = indirectInputAttributes.data();
+			shaderStages[0] = loadShader(getAssetPath() + "shaders/deferred_indirect.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			pipelineCreateInfo.pVertexInputState = &indirectInputState;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.offscreenIndirect));
+			pipelineCreateInfo.pVertexInputState = &vertexInputState;
+
+			VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(gpuCulling.pipelineLayout, 0);
+			computePipelineCreateInfo.stage = loadShader(getAssetPath() + "shaders/cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &gpuCulling.pipeline));
+		}
 
 		/*
 			Dungeon map rendering
@@ -1241,31 +2356,34 @@ public:
 			&uniformBuffers.vsFullScreen,
 			sizeof(uboVS)));
 
-		// Deferred vertex shader
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.vsOffscreen,
-			sizeof(uboOffscreenVS)));
+		// Buffers changing every frame are written while earlier frames are in flight, so there's one per frame slot
+		for (uint32_t i = 0; i < maxFramesInFlight; i++) {
+			// Deferred vertex shader
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&frames[i].uniformBuffers.vsOffscreen,
+				sizeof(uboOffscreenVS)));
 
-		// Deferred fragment shader
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.fsLights,
-			sizeof(uboFragmentLights)));
+			// Deferred fragment shader
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&frames[i].uniformBuffers.fsLights,
+				sizeof(uboFragmentLights)));
 
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&dungeonMap.uniformBuffer,
-			sizeof(dungeonMap.uniforms)));
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&dungeonMap.frames[i].uniformBuffer,
+				sizeof(dungeonMap.uniforms)));
 
-		// Map persistent
+			// Map persistent
+			VK_CHECK_RESULT(frames[i].uniformBuffers.vsOffscreen.map());
+			VK_CHECK_RESULT(frames[i].uniformBuffers.fsLights.map());
+			VK_CHECK_RESULT(dungeonMap.frames[i].uniformBuffer.map());
+		}
 		VK_CHECK_RESULT(uniformBuffers.vsFullScreen.map());
-		VK_CHECK_RESULT(uniformBuffers.vsOffscreen.map());
-		VK_CHECK_RESULT(uniformBuffers.fsLights.map());
-		VK_CHECK_RESULT(dungeonMap.uniformBuffer.map());
 
 		// Update
 		updateUniformBuffersScreen();
@@ -1280,13 +2398,12 @@ public:
 		memcpy(uniformBuffers.vsFullScreen.mapped, &uboVS, sizeof(uboVS));
 	}
 
+	// Uniform data changing every frame is copied to the current frame's buffers in draw()
 	void updateUniformBufferDeferredMatrices()
 	{
 		uboOffscreenVS.projection = player.matrices.projection;
 		uboOffscreenVS.view = player.matrices.view;
 		uboOffscreenVS.model = glm::mat4(1.0f);
-
-		memcpy(uniformBuffers.vsOffscreen.mapped, &uboOffscreenVS, sizeof(uboOffscreenVS));
 	}
 
 	// Update fragment shader light position uniform block
@@ -1344,70 +2461,220 @@ public:
 
 		// Current view position
 		uboFragmentLights.viewPos = glm::vec4(player.position, 0.0f);
-
-		memcpy(uniformBuffers.fsLights.mapped, &uboFragmentLights, sizeof(uboFragmentLights));
 	}
 
 	void draw()
 	{
+		// Waits for the previous frame of the current slot, its buffers and command buffers can be changed after this
 		VulkanExampleBase::prepareFrame();
+		Frame &frame = frames[currentFrame];
+
+		memcpy(frame.uniformBuffers.vsOffscreen.mapped, &uboOffscreenVS, sizeof(uboOffscreenVS));
+		memcpy(frame.uniformBuffers.fsLights.mapped, &uboFragmentLights, sizeof(uboFragmentLights));
+		if (gpuCulling.enabled) {
+			// Counts of the slot's previous frame, only distance and frustum culling are done on the GPU
+			cellsVisible = gpuCulling.getCounts(currentFrame).visibleCells;
+			cellsInFrustum = cellsVisible;
+			gpuCulling.uploadUniforms(currentFrame);
+		}
+		if (frame.deferredOutdated) {
+			if (gpuCulling.enabled) {
+				vks::FrameProfiler::CpuScope profilerScope(profiler, profilerStages.recording);
+				buildDeferredCommandBuffer();
+			}
+			else {
+				// Moving or turning often doesn't change the visible set (e.g. while animating between two cells)
+				{
+					vks::FrameProfiler::CpuScope profilerScope(profiler, profilerStages.culling);
+					updateVisibleSet();
+				}
+				if (visibleSet == frame.recordedSet) {
+					deferredRecordsAvoided++;
+				}
+				else {
+					vks::FrameProfiler::CpuScope profilerScope(profiler, profilerStages.recording);
+					buildDeferredCommandBuffer();
+					frame.recordedSet = visibleSet;
+					deferredRecords++;
+				}
+			}
+			frame.deferredOutdated = false;
+		}
+
 		{
+			vks::FrameProfiler::CpuScope profilerScope(profiler, profilerStages.deferredPass);
 			submitInfo.pWaitSemaphores = &semaphores.presentComplete;
 			submitInfo.pSignalSemaphores = &deferredPass.semaphore;
-			submitInfo.pCommandBuffers = &deferredPass.commandBuffer;
+			submitInfo.pCommandBuffers = &frame.deferredCB;
 			submitInfo.commandBufferCount = 1;
 			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		}
 
 		{
 			if (dungeonMap.display) {
+				vks::FrameProfiler::CpuScope profilerScope(profiler, profilerStages.mapOverlay);
 				dungeonMap.rotation = player.rotation.y;
 				dungeonMap.aspectRatio = (float)height / (float)width;
-				dungeonMap.updateUniforms();
-				if (dungeonMap.update) {
-					dungeonMap.updateBuffers();
-					dungeonMap.updateCommandBuffer(renderPass, glm::vec2(width,height));
+				dungeonMap.updateUniforms(currentFrame);
+				if (dungeonMap.frames[currentFrame].update) {
+					dungeonMap.updateBuffers(currentFrame);
+					dungeonMap.updateCommandBuffer(currentFrame, renderPass, glm::vec2(width,height));
 				}
 			}
-			buildCommandBuffers();
+			{
+				vks::FrameProfiler::CpuScope profilerScope(profiler, profilerStages.recording);
+				buildCommandBuffers();
+			}
+			vks::FrameProfiler::CpuScope profilerScope(profiler, profilerStages.composition);
 			submitInfo.pWaitSemaphores = &deferredPass.semaphore;
 			submitInfo.pSignalSemaphores = &semaphores.renderComplete;
-			submitInfo.pCommandBuffers = &renderCB;
+			submitInfo.pCommandBuffers = &frame.renderCB;
 			submitInfo.commandBufferCount = 1;
 			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 		}
+		// Doesn't wait for the GPU, the next frame is recorded while this one is still executing
 		VulkanExampleBase::submitFrame();
 	}
 
+	/*
+		Buffers and the draw function for GPU culling, culling runs on the graphics queue
+	*/
+	void prepareGpuCulling()
+	{
+		if (!gpuCulling.enabled) {
+			return;
+		}
+		if ((vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].queueFlags & VK_QUEUE_COMPUTE_BIT) == 0) {
+			std::cerr << "Graphics queue doesn't support compute, using CPU culling" << std::endl;
+			gpuCulling.enabled = false;
+			return;
+		}
+		const char *functionName = (strcmp(gpuCulling.drawIndirectCountExtension, VK_AMD_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0) ? "vkCmdDrawIndexedIndirectCountAMD" : "vkCmdDrawIndexedIndirectCountKHR";
+		gpuCulling.cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountAMD>(vkGetDeviceProcAddr(device, functionName));
+		assert(gpuCulling.cmdDrawIndexedIndirectCount);
+		gpuCulling.prepareBuffers(maxDrawDistance);
+	}
+
+	/*
+		Create a command pool and a secondary command buffer for each worker thread (for one frame slot)
+	*/
+	void prepareRecordingThreads(Frame &frame)
+	{
+		frame.recordingThreads.resize(numThreads);
+		// Each thread gathers the instances of a block of rows of the draw distance window
+		const uint32_t rowCount = 2 * maxDrawDistance + 1;
+		const uint32_t rowsPerThread = (rowCount + numThreads - 1) / numThreads;
+		for (auto &thread : frame.recordingThreads) {
+			VkCommandPoolCreateInfo cmdPoolInfo = {};
+			cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
+			// The whole pool is reset before recording
+			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &thread.commandPool));
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(thread.commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &thread.commandBuffer));
+			thread.recorded = false;
+			if (!mergedMesh.enabled) {
+				thread.cellInstances.prepareBuffer(rowsPerThread * rowCount);
+			}
+		}
+	}
+
+	/*
+		Reset the thread's command pool and begin its secondary command buffer for the deferred pass
+		Called from the thread that records into it
+	*/
+	VkCommandBuffer beginRecordingThread(RecordingThread &thread)
+	{
+		VK_CHECK_RESULT(vkResetCommandPool(device, thread.commandPool, 0));
+
+		VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
+		inheritanceInfo.renderPass = deferredPass.renderPass;
+		inheritanceInfo.framebuffer = deferredPass.frameBuffer;
+
+		// Not one time submit, the frame slot's deferred command buffer is resubmitted as long as the visible set doesn't change
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		cmdBufInfo.pInheritanceInfo = &inheritanceInfo;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(thread.commandBuffer, &cmdBufInfo));
+
+		VkViewport viewport = vks::initializers::viewport((float)deferredPass.width, (float)deferredPass.height, 0.0f, 1.0f);
+		vkCmdSetViewport(thread.commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(deferredPass.width, deferredPass.height, 0, 0);
+		vkCmdSetScissor(thread.commandBuffer, 0, 1, &scissor);
+
+		return thread.commandBuffer;
+	}
+
+	// Execute the current frame's secondary command buffers of all threads that recorded anything, in thread order
+	void executeRecordingThreads(VkCommandBuffer commandBuffer)
+	{
+		std::vector<VkCommandBuffer> commandBuffers;
+		for (auto &thread : frames[currentFrame].recordingThreads) {
+			if (thread.recorded) {
+				commandBuffers.push_back(thread.commandBuffer);
+			}
+		}
+		if (!commandBuffers.empty()) {
+			vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+		}
+	}
+
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
 
+		// CPU times are culling, recording and submitting (deferred pass, composition and map overlay), GPU times are
+		// taken around the commands of each stage
+		profilerStages.culling = profiler.addStage("culling");
+		profilerStages.recording = profiler.addStage("recording");
+		profilerStages.deferredPass = profiler.addStage("deferred pass");
+		profilerStages.composition = profiler.addStage("composition");
+		profilerStages.mapOverlay = profiler.addStage("map overlay");
+
 		globals.device = vulkanDevice;
 
 		loadAssets();
 		preparedeferredPassfer();
 		prepareUniformBuffers();
+		prepareGpuCulling();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSets();
 		buildVertexBuffers();
 
-		dungeonMap.commandBuffer = VulkanExampleBase::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY, false);
-		dungeonMap.dungeon = this->dungeon;
+		// The map is only available for the single dungeon, its buffers are built when it's displayed
+		for (auto &frame : dungeonMap.frames) {
+			frame.commandBuffer = VulkanExampleBase::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY, false);
+		}
 		dungeonMap.player = &this->player;
-		dungeonMap.updateBuffers();
-		
-		generateCellCommandBuffers();
+		dungeonMap.profiler = &profiler;
+		dungeonMap.profilerStage = profilerStages.mapOverlay;
+		if (dungeon) {
+			dungeonMap.dungeon = this->dungeon;
+			dungeonMap.resetFogOfWar();
+		}
+
+		if (mergedMesh.enabled) {
+			mergedMesh.upload(queue);
+		}
+		for (auto &frame : frames) {
+			frame.deferredCB = VulkanExampleBase::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+			if (!gpuCulling.enabled) {
+				prepareRecordingThreads(frame);
+			}
+		}
 
 		buildCommandBuffers();
 
-		deferredPass.commandBuffer = VulkanExampleBase::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
 		VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
 		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &deferredPass.semaphore));
 
-		buildDeferredCommandBuffer();
+		// The deferred pass of each frame slot is recorded when the slot is used first
+		if (gpuCulling.enabled) {
+			updateGpuCulling();
+		}
 
 		prepared = true;
 	}
@@ -1425,7 +2692,11 @@ public:
 		}
 #endif
 
-		if (player.update(frameTimer)) {
+		if ((walk.active) && (!playerMoving) && (walk.step(player))) {
+			viewChanged();
+		}
+		playerMoving = player.update(((walk.active) && (benchmark.active)) ? walk.timeStep : frameTimer);
+		if (playerMoving) {
 			viewChanged();
 		}
 		updateUniformBufferDeferredLights();
@@ -1433,10 +2704,30 @@ public:
 
 	virtual void viewChanged()
 	{
-		buildDeferredCommandBuffer();
+		// The GPU driven command buffers don't depend on the view
+		if (gpuCulling.enabled) {
+			updateGpuCulling();
+		}
+		else {
+			invalidateDeferredCommandBuffers();
+		}
 		updateUniformBufferDeferredMatrices();
 	}
 
+	// Dig out the cell in front of the player (grid border stays solid)
+	void digCell()
+	{
+		if (!dungeon) {
+			return;
+		}
+		glm::ivec2 target = player.getTargetCell(glm::vec3(0.0f, 0.0f, 1.0f));
+		if ((target.x < 1) || (target.y < 1) || (target.x >= dungeon->width - 1) || (target.y >= dungeon->height - 1)) {
+			return;
+		}
+		dungeon->setCellTypes(target.x, target.y, target.x, target.y, dungeongenerator::Cell::cellTypeCorridor);
+		applyDungeonChanges();
+	}
+
 	virtual void keyPressed(uint32_t keyCode)
 	{
 		bool updateReq = false;
@@ -1466,7 +2757,10 @@ public:
 				updateReq = true;
 				break;
 			case KEY_M:
-				dungeonMap.display = !dungeonMap.display;
+				dungeonMap.display = !dungeonMap.display && (dungeon != nullptr);
+				break;
+			case KEY_SPACE:
+				digCell();
 				break;
 		}
 		if (updateReq) {
@@ -1485,7 +2779,44 @@ public:
 
 	virtual void getOverlayText(VulkanTextOverlay *textOverlay)
 	{
-		textOverlay->addText(std::to_string(cellsVisible), 5.0f, 85.0f, VulkanTextOverlay::alignLeft);
+		if (mergedMesh.enabled) {
+			textOverlay->addText("chunks: " + std::to_string(mergedMesh.visibleChunks.size()) + " visible / " + std::to_string(mergedMesh.mesh.chunks.size()), 5.0f, 85.0f, VulkanTextOverlay::alignLeft);
+		}
+		else {
+			textOverlay->addText("cells: " + std::to_string(cellsVisible) + " visible / " + std::to_string(cellsInFrustum) + " in frustum", 5.0f, 85.0f, VulkanTextOverlay::alignLeft);
+		}
+		if (!gpuCulling.enabled) {
+			textOverlay->addText("re-records: " + std::to_string(deferredRecords) + " / " + std::to_string(deferredRecordsAvoided) + " avoided", 5.0f, 105.0f, VulkanTextOverlay::alignLeft);
+		}
+		// Stage times averaged over the profiler's history
+		float y = 135.0f;
+		for (uint32_t stage = 0; stage < profiler.stageNames.size(); stage++) {
+			const double cpuTime = profiler.getAverage(stage, false);
+			const double gpuTime = profiler.getAverage(stage, true);
+			if ((cpuTime < 0.0) && (gpuTime < 0.0)) {
+				continue;
+			}
+			std::stringstream ss;
+			ss << std::fixed << std::setprecision(3) << profiler.stageNames[stage] << ": cpu " << std::max(cpuTime, 0.0) << " ms";
+			if (gpuTime >= 0.0) {
+				ss << ", gpu " << gpuTime << " ms";
+			}
+			textOverlay->addText(ss.str(), 5.0f, y, VulkanTextOverlay::alignLeft);
+			y += 20.0f;
+		}
+	}
+
+	virtual void getBenchmarkCounters(vks::Benchmark &benchmark)
+	{
+		if (!gpuCulling.enabled) {
+			benchmark.addCounter("deferred pass re-records", deferredRecords);
+			benchmark.addCounter("deferred pass re-records avoided", deferredRecordsAvoided);
+		}
+		if (walk.active) {
+			benchmark.addCounter("walkthrough rooms", walk.roomCount);
+			benchmark.addCounter("walkthrough cells walked", walk.cellsWalked);
+			benchmark.addCounter("walkthrough completed walks", walk.completedWalks);
+		}
 	}
 };
 
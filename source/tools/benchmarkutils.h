@@ -0,0 +1,65 @@
+/*
+* Helpers shared by the dungeon generator benchmark tools
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include <algorithm>
+
+#include "../generator/Dungeon.h"
+
+// Runs func once and returns its duration in ms
+template <typename F>
+double timeStage(F func)
+{
+	auto tStart = std::chrono::high_resolution_clock::now();
+	func();
+	auto tEnd = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+}
+
+// Runs func the given number of times and returns the best duration in ms
+template <typename F>
+double timeRuns(uint32_t runs, F func)
+{
+	double best = 0.0;
+	for (uint32_t i = 0; i < runs; i++) {
+		const double tDiff = timeStage(func);
+		best = (i == 0) ? tDiff : std::min(best, tDiff);
+	}
+	return best;
+}
+
+// Fills a dungeon of arbitrary size by tiling a generated layout (full generation of huge grids would dominate the benchmarks)
+inline void fillDungeon(dungeongenerator::Dungeon &dungeon, const dungeongenerator::Dungeon &tile)
+{
+	for (int y = 0; y < dungeon.height; y++) {
+		for (int x = 0; x < dungeon.width; x++) {
+			dungeon.setCellType(x, y, tile.getCellType(x % tile.width, y % tile.height));
+		}
+	}
+}
+
+// Resident set size of this process in MB (Linux only)
+inline double getResidentSetSize()
+{
+	double rss = 0.0;
+#if defined(__linux__)
+	FILE *statm = fopen("/proc/self/statm", "r");
+	if (statm) {
+		unsigned long pages, residentPages;
+		if (fscanf(statm, "%lu %lu", &pages, &residentPages) == 2) {
+			rss = residentPages * 4096.0 / (1024.0 * 1024.0);
+		}
+		fclose(statm);
+	}
+#endif
+	return rss;
+}
@@ -0,0 +1,183 @@
+/*
+* Chunked dungeon world benchmark
+*
+* Checks that chunks of a ChunkedDungeon are the same regardless of generation order and eviction, that
+* neighbouring chunks are connected through their shared borders and that all cells of an area are reachable,
+* then walks across the world to measure chunk generation times and memory use
+*
+* Usage: chunkbenchmark [-seed n] [-chunksize n] [-maxchunks n] [-distance n]
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "../generator/ChunkedDungeon.h"
+#include "benchmarkutils.h"
+
+using namespace dungeongenerator;
+
+struct Area {
+	int left, top, right, bottom;
+};
+
+// Same cells, walls and doors for different load orders and with chunks being evicted and regenerated in between
+bool checkDeterminism(uint64_t seed, int chunkSize, const Area &area)
+{
+	ChunkedDungeon reference(seed, chunkSize, 1024);
+	ChunkedDungeon evicting(seed, chunkSize, 2);
+	for (int y = area.bottom; y >= area.top; y--) {
+		for (int x = area.right; x >= area.left; x--) {
+			evicting.update(x, y, 0);
+		}
+	}
+	for (int y = area.top; y <= area.bottom; y++) {
+		for (int x = area.left; x <= area.right; x++) {
+			evicting.update(x, y, 0);
+			if ((reference.getCellType(x, y) != evicting.getCellType(x, y)) ||
+				(reference.getCellWalls(x, y) != evicting.getCellWalls(x, y)) ||
+				(reference.getCellDoors(x, y) != evicting.getCellDoors(x, y))) {
+				fprintf(stderr, "Cell %d/%d differs between load orders\n", x, y);
+				return false;
+			}
+		}
+	}
+	printf("Chunks identical for different load orders (%llu chunks generated with eviction)\n", (unsigned long long)evicting.chunksGenerated);
+	return true;
+}
+
+/*
+	Every border between two chunks must have exactly one connection with the walls opened on both sides,
+	all other cells next to a border are closed towards it
+*/
+bool checkBorders(ChunkedDungeon &world, int chunkSize, int chunksX, int chunksY)
+{
+	for (int cy = -chunksY; cy <= chunksY; cy++) {
+		for (int cx = -chunksX; cx <= chunksX; cx++) {
+			for (int vertical = 0; vertical < 2; vertical++) {
+				int connections = 0;
+				for (int i = 0; i < chunkSize; i++) {
+					// Cell a is west/north of the border, cell b is east/south
+					const int bx = vertical ? cx * chunkSize : cx * chunkSize + i;
+					const int by = vertical ? cy * chunkSize + i : cy * chunkSize;
+					const int ax = vertical ? bx - 1 : bx;
+					const int ay = vertical ? by : by - 1;
+					const int dirA = vertical ? Cell::dirEast : Cell::dirSouth;
+					const int dirB = vertical ? Cell::dirWest : Cell::dirNorth;
+					const bool solidA = world.getCellType(ax, ay) != Cell::cellTypeEmpty;
+					const bool solidB = world.getCellType(bx, by) != Cell::cellTypeEmpty;
+					if (solidA && solidB) {
+						connections++;
+						if (world.hasWall(ax, ay, dirA) || world.hasWall(bx, by, dirB)) {
+							fprintf(stderr, "Connection between chunks at %d/%d is blocked by a wall\n", bx, by);
+							return false;
+						}
+					}
+					else if ((solidA && !world.hasWall(ax, ay, dirA)) || (solidB && !world.hasWall(bx, by, dirB))) {
+						fprintf(stderr, "Missing wall at chunk border at %d/%d\n", bx, by);
+						return false;
+					}
+				}
+				if (connections != 1) {
+					fprintf(stderr, "Border of chunk %d/%d has %d connections\n", cx, cy, connections);
+					return false;
+				}
+			}
+		}
+	}
+	printf("All chunk borders connected\n");
+	return true;
+}
+
+// Flood fill through open walls, all non-empty cells of the area should be reachable from the starting room
+bool checkReachability(ChunkedDungeon &world, const Area &area)
+{
+	const int width = area.right - area.left + 1;
+	const int height = area.bottom - area.top + 1;
+	std::vector<uint8_t> visited((size_t)width * height, 0);
+	int startX, startY;
+	world.getRoomCenter(0, 0, startX, startY);
+	std::vector<std::pair<int, int>> stack = { { startX, startY } };
+	visited[(startY - area.top) * width + (startX - area.left)] = 1;
+	size_t reached = 0;
+	const int offsets[4][2] = { { 0, -1 }, { 0, 1 }, { -1, 0 }, { 1, 0 } };
+	while (!stack.empty()) {
+		const std::pair<int, int> cell = stack.back();
+		stack.pop_back();
+		reached++;
+		for (int dir = 0; dir < 4; dir++) {
+			const int x = cell.first + offsets[dir][0];
+			const int y = cell.second + offsets[dir][1];
+			if ((x < area.left) || (y < area.top) || (x > area.right) || (y > area.bottom) || world.hasWall(cell.first, cell.second, dir)) {
+				continue;
+			}
+			uint8_t &v = visited[(y - area.top) * width + (x - area.left)];
+			if ((!v) && (world.getCellType(x, y) != Cell::cellTypeEmpty)) {
+				v = 1;
+				stack.push_back({ x, y });
+			}
+		}
+	}
+	size_t total = 0;
+	for (int y = area.top; y <= area.bottom; y++) {
+		for (int x = area.left; x <= area.right; x++) {
+			total += (world.getCellType(x, y) != Cell::cellTypeEmpty) ? 1 : 0;
+		}
+	}
+	printf("%zu of %zu cells reachable from the starting room (%.2f%%)\n", reached, total, 100.0 * reached / total);
+	return reached == total;
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t seed = 0;
+	int chunkSize = 64;
+	size_t maxChunks = 64;
+	int distance = 100;
+	for (int i = 1; i < argc - 1; i++) {
+		if (strcmp(argv[i], "-seed") == 0) {
+			seed = strtoull(argv[i + 1], nullptr, 10);
+		}
+		if (strcmp(argv[i], "-chunksize") == 0) {
+			chunkSize = atoi(argv[i + 1]);
+		}
+		if (strcmp(argv[i], "-maxchunks") == 0) {
+			maxChunks = atoi(argv[i + 1]);
+		}
+		if (strcmp(argv[i], "-distance") == 0) {
+			distance = atoi(argv[i + 1]);
+		}
+	}
+
+	ChunkedDungeon world(seed, chunkSize, 1024);
+	chunkSize = world.chunkSize;
+	const int chunks = 3;
+	const Area area = { -chunks * chunkSize, -chunks * chunkSize, (chunks + 1) * chunkSize - 1, (chunks + 1) * chunkSize - 1 };
+	if ((!checkDeterminism(seed, chunkSize, area)) || (!checkBorders(world, chunkSize, chunks, chunks)) || (!checkReachability(world, area))) {
+		return EXIT_FAILURE;
+	}
+
+	// Walk east in a straight line, keeping the area within the draw distance loaded
+	ChunkedDungeon walker(seed, chunkSize, maxChunks);
+	const int radius = 24;
+	size_t maxLoaded = 0;
+	auto tStart = std::chrono::high_resolution_clock::now();
+	for (int x = 0; x < distance * chunkSize; x++) {
+		walker.update(x, 0, radius);
+		maxLoaded = std::max(maxLoaded, walker.getLoadedChunkCount());
+	}
+	auto tEnd = std::chrono::high_resolution_clock::now();
+	double tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+	printf("Walked %d chunks (%d cells): %llu chunks generated, %.3f ms per chunk, max. %zu chunks loaded (limit %zu), rss %.2f MB\n",
+		distance, distance * chunkSize, (unsigned long long)walker.chunksGenerated, tDiff / walker.chunksGenerated, maxLoaded, maxChunks, getResidentSetSize());
+
+	return 0;
+}
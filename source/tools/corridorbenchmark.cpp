@@ -0,0 +1,139 @@
+/*
+* Corridor generation benchmark
+*
+* Compares the previous corridor generation (every room connected along its whole chain up to the root)
+* with connecting every partition node once, using straight corridors and corridors routed over a cost field
+*
+* Checks that the deduplicated straight corridors are identical to the previous ones and that all rooms
+* are connected with routed corridors
+*
+* Degenerate grids (one or two cells wide) are always included to check that all routing modes handle
+* partitions whose centers lie on the grid's outer edge
+*
+* Usage: corridorbenchmark [-seed n] [-norecursive] [sizes (n or wxh)...]
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "../generator/Dungeon.h"
+#include "benchmarkutils.h"
+
+using namespace dungeongenerator;
+
+struct GridSize {
+	int width;
+	int height;
+};
+
+size_t countCorridors(const Dungeon &dungeon)
+{
+	return std::count(dungeon.cellTypes.begin(), dungeon.cellTypes.end(), (uint8_t)Cell::cellTypeCorridor);
+}
+
+// Flood fill over non-empty cells, returns true if all non-empty cells are reachable from the first room
+bool checkConnected(const Dungeon &dungeon)
+{
+	BspPartition *room = nullptr;
+	for (auto index : dungeon.partitionList) {
+		if (dungeon.partitions[index].hasRoom) {
+			room = const_cast<BspPartition*>(&dungeon.partitions[index]);
+			break;
+		}
+	}
+	if (!room) {
+		return true;
+	}
+	std::vector<uint8_t> visited(dungeon.cellTypes.size(), 0);
+	std::vector<uint32_t> stack = { dungeon.getCellIndex(room->centerX, room->centerY) };
+	visited[stack[0]] = 1;
+	size_t reached = 0;
+	while (!stack.empty()) {
+		const uint32_t index = stack.back();
+		stack.pop_back();
+		reached++;
+		const int x = index % dungeon.width;
+		const int y = index / dungeon.width;
+		const int neighbours[4][2] = { { x, y - 1 }, { x, y + 1 }, { x - 1, y }, { x + 1, y } };
+		for (auto &n : neighbours) {
+			if ((n[0] < 0) || (n[1] < 0) || (n[0] >= dungeon.width) || (n[1] >= dungeon.height)) {
+				continue;
+			}
+			const uint32_t neighbour = dungeon.getCellIndex(n[0], n[1]);
+			if ((!visited[neighbour]) && (dungeon.cellTypes[neighbour] != Cell::cellTypeEmpty)) {
+				visited[neighbour] = 1;
+				stack.push_back(neighbour);
+			}
+		}
+	}
+	return reached == (size_t)(dungeon.cellTypes.size() - std::count(dungeon.cellTypes.begin(), dungeon.cellTypes.end(), (uint8_t)Cell::cellTypeEmpty));
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t seed = 0;
+	bool recursive = true;
+	std::vector<GridSize> sizes = { { 1, 1 }, { 2, 2 }, { 64, 1 }, { 64, 2 }, { 1, 64 }, { 2, 64 } };
+	const size_t degenerateSizes = sizes.size();
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-seed") == 0) && (i + 1 < argc)) {
+			seed = strtoull(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "-norecursive") == 0) {
+			recursive = false;
+		}
+		else {
+			GridSize size;
+			if (sscanf(argv[i], "%dx%d", &size.width, &size.height) != 2) {
+				size.height = size.width = atoi(argv[i]);
+			}
+			sizes.push_back(size);
+		}
+	}
+	if (sizes.size() == degenerateSizes) {
+		sizes.insert(sizes.end(), { { 256, 256 }, { 1024, 1024 }, { 4096, 4096 } });
+	}
+
+	printf("width,height,recursive(ms),straight(ms),routed(ms),speedup,corridor cells straight,corridor cells routed,cells expanded\n");
+
+	for (auto size : sizes) {
+		Dungeon reference(size.width, size.height, seed);
+		reference.generateRooms();
+		double tRecursive = 0.0;
+		if (recursive) {
+			tRecursive = timeStage([&] { reference.generateCorridorsRecursive(); });
+		}
+
+		Dungeon straight(size.width, size.height, seed);
+		straight.corridorRouting = Dungeon::corridorRoutingStraight;
+		straight.generateRooms();
+		double tStraight = timeStage([&] { straight.generateCorridors(); });
+		if (recursive && (straight.cellTypes != reference.cellTypes)) {
+			fprintf(stderr, "Straight corridors differ from the previous corridor generation (%dx%d)\n", size.width, size.height);
+			return EXIT_FAILURE;
+		}
+
+		Dungeon routed(size.width, size.height, seed);
+		routed.corridorRouting = Dungeon::corridorRoutingCostField;
+		routed.generateRooms();
+		double tRouted = timeStage([&] { routed.generateCorridors(); });
+		if (!checkConnected(routed)) {
+			fprintf(stderr, "Routed corridors don't connect all rooms (%dx%d)\n", size.width, size.height);
+			return EXIT_FAILURE;
+		}
+
+		printf("%d,%d,%.3f,%.3f,%.3f,%.1f,%zu,%zu,%llu\n", size.width, size.height, tRecursive, tStraight, tRouted, recursive ? tRecursive / tRouted : 0.0,
+			countCorridors(straight), countCorridors(routed), (unsigned long long)routed.corridorRouter.cellsExpanded);
+	}
+
+	return 0;
+}
@@ -0,0 +1,178 @@
+/*
+* Cell culling benchmark
+*
+* Builds the cell hierarchy for dungeons of different sizes and culls random views against it (CPU only), once with
+* the renderer's draw distance and once with a draw distance covering the whole dungeon (like the top-down view)
+*
+* Compares the time per view with testing every cell of the grid and checks that both return the same cells
+*
+* Usage: cullingbenchmark [-seed n] [-views n] [sizes...]
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "../generator/Dungeon.h"
+#include "../generator/CellHierarchy.h"
+#include "benchmarkutils.h"
+
+using namespace dungeongenerator;
+
+// Same settings as the renderer
+const float fieldOfView = 60.0f;
+const float aspectRatio = 1280.0f / 720.0f;
+const float maxDrawDistance = 16.0f;
+const float eyeHeight = -0.5f;
+
+// Frustum planes for a horizontal view direction, extracted from the view projection matrix like vks::Frustum does
+void getFrustumPlanes(float eyeX, float eyeZ, float yaw, float *planes)
+{
+	const float f = 1.0f / tanf(fieldOfView * 0.5f * 3.14159265f / 180.0f);
+	const float zNear = 0.1f;
+	const float zFar = 1024.0f;
+	float projection[16] = { 0.0f };
+	projection[0] = f / aspectRatio;
+	projection[5] = f;
+	projection[10] = zFar / (zNear - zFar);
+	projection[11] = -1.0f;
+	projection[14] = -(zFar * zNear) / (zFar - zNear);
+	const float fx = sinf(yaw);
+	const float fz = cosf(yaw);
+	const float sx = -fz;
+	const float sz = fx;
+	const float eye[3] = { eyeX, eyeHeight, eyeZ };
+	float view[16] = {
+		sx, 0.0f, -fx, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		sz, 0.0f, -fz, 0.0f,
+		-(sx * eye[0] + sz * eye[2]), -eye[1], fx * eye[0] + fz * eye[2], 1.0f
+	};
+	float m[16];
+	for (uint32_t c = 0; c < 4; c++) {
+		for (uint32_t r = 0; r < 4; r++) {
+			m[c * 4 + r] = 0.0f;
+			for (uint32_t k = 0; k < 4; k++) {
+				m[c * 4 + r] += projection[k * 4 + r] * view[c * 4 + k];
+			}
+		}
+	}
+	// Left, right, top, bottom, back, front
+	const int rows[6] = { 0, 0, 1, 1, 2, 2 };
+	const float signs[6] = { 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, -1.0f };
+	for (uint32_t i = 0; i < 6; i++) {
+		float *plane = &planes[i * 4];
+		for (uint32_t c = 0; c < 4; c++) {
+			plane[c] = m[c * 4 + 3] + signs[i] * m[c * 4 + rows[i]];
+		}
+		const float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		for (uint32_t c = 0; c < 4; c++) {
+			plane[c] /= length;
+		}
+	}
+}
+
+// Reference: tests every non-empty cell of the grid
+void cullGrid(const Dungeon &dungeon, const CellHierarchy &hierarchy, const float *planes, const float *eye, float maxDistance, std::vector<uint32_t> &result)
+{
+	for (int y = 0; y < dungeon.height; y++) {
+		for (int x = 0; x < dungeon.width; x++) {
+			if (dungeon.getCellType(x, y) == Cell::cellTypeEmpty) {
+				continue;
+			}
+			if ((x - eye[0]) * (x - eye[0]) + eye[1] * eye[1] + (y - eye[2]) * (y - eye[2]) > maxDistance * maxDistance) {
+				continue;
+			}
+			const float boxMin[3] = { x - 0.5f, -hierarchy.cellHalfHeight, y - 0.5f };
+			const float boxMax[3] = { x + 0.5f, hierarchy.cellHalfHeight, y + 0.5f };
+			if (CellHierarchy::checkBox(planes, boxMin, boxMax) != CellHierarchy::boxOutside) {
+				result.push_back(dungeon.getCellIndex(x, y));
+			}
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t seed = 0;
+	uint32_t viewCount = 200;
+	std::vector<int> sizes;
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-seed") == 0) && (i + 1 < argc)) {
+			seed = strtoull(argv[++i], nullptr, 10);
+		}
+		else if ((strcmp(argv[i], "-views") == 0) && (i + 1 < argc)) {
+			viewCount = std::max(atoi(argv[++i]), 1);
+		}
+		else {
+			sizes.push_back(atoi(argv[i]));
+		}
+	}
+	if (sizes.empty()) {
+		sizes = { 64, 256, 1024 };
+	}
+
+	printf("size,distance,build(ms),memory(KB),cells,cells visible,nodes visited,cells tested,grid(us),hierarchy(us),speedup\n");
+
+	for (auto size : sizes) {
+		Dungeon dungeon(size, size, seed);
+		dungeon.generateRooms();
+		dungeon.generateCorridors();
+		dungeon.generateWalls();
+		dungeon.generateDoors();
+
+		CellHierarchy hierarchy;
+		double tBuild = timeStage([&] { hierarchy.build(dungeon); });
+
+		std::vector<uint32_t> walkable;
+		for (uint32_t i = 0; i < dungeon.cellTypes.size(); i++) {
+			if (dungeon.cellTypes[i] != Cell::cellTypeEmpty) {
+				walkable.push_back(i);
+			}
+		}
+
+		const float distances[2] = { maxDrawDistance, (float)size * 2.0f };
+		for (auto distance : distances) {
+			Random random(seed, 1);
+			std::vector<uint32_t> reference, culled;
+			uint64_t cellsVisible = 0, nodesVisited = 0, cellsTested = 0;
+			double tGrid = 0.0, tHierarchy = 0.0;
+			for (uint32_t v = 0; v < viewCount; v++) {
+				const uint32_t eyeCell = walkable[random.next() % walkable.size()];
+				const float eye[3] = { (float)(eyeCell % size), eyeHeight, (float)(eyeCell / size) };
+				const float yaw = random.range(3600) * 3.14159265f / 1800.0f;
+				float planes[24];
+				getFrustumPlanes(eye[0], eye[2], yaw, planes);
+
+				reference.clear();
+				culled.clear();
+				tGrid += timeStage([&] { cullGrid(dungeon, hierarchy, planes, eye, distance, reference); });
+				tHierarchy += timeStage([&] { hierarchy.cull(planes, eye, distance, culled); });
+				cellsVisible += culled.size();
+				nodesVisited += hierarchy.nodesVisited;
+				cellsTested += hierarchy.cellsTested;
+
+				std::sort(culled.begin(), culled.end());
+				if (culled != reference) {
+					fprintf(stderr, "Hierarchy culling doesn't match the grid (%dx%d, view %u: %zu cells instead of %zu)\n", size, size, v, culled.size(), reference.size());
+					return EXIT_FAILURE;
+				}
+			}
+
+			printf("%d,%.0f,%.3f,%.1f,%zu,%.1f,%.1f,%.1f,%.2f,%.2f,%.1f\n", size, distance, tBuild, hierarchy.getMemorySize() / 1024.0, walkable.size(),
+				(double)cellsVisible / viewCount, (double)nodesVisited / viewCount, (double)cellsTested / viewCount,
+				tGrid * 1000.0 / viewCount, tHierarchy * 1000.0 / viewCount, tGrid / std::max(tHierarchy, 1e-9));
+		}
+	}
+
+	return 0;
+}
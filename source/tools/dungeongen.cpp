@@ -0,0 +1,184 @@
+/*
+* Headless dungeon generator
+*
+* Generates dungeons without a Vulkan device, reports the time spent in each generation stage
+* and optionally dumps the resulting cell grids as text files or saves them as level files
+*
+* Usage: dungeongen [-size n | -size WxH] [-count n] [-seed n] [-threads n] [-dump directory] [-save directory]
+*        dungeongen -load file [-dump directory]
+*
+* -size can be passed multiple times, every size generates count dungeons with the seeds seed..seed+count-1
+* -load reads a level file written with -save (e.g. by another tool) instead of generating
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "../generator/Dungeon.h"
+#include "../generator/DungeonFile.h"
+#include "benchmarkutils.h"
+
+using namespace dungeongenerator;
+
+struct GridSize {
+	int width;
+	int height;
+};
+
+// Characters used for the grid dump
+char getCellChar(const Dungeon &dungeon, int x, int y)
+{
+	if (dungeon.hasDoor(x, y)) {
+		return '+';
+	}
+	switch (dungeon.getCellType(x, y)) {
+	case Cell::cellTypeRoom:
+		return '.';
+	case Cell::cellTypeCorridor:
+		return ',';
+	default:
+		return '#';
+	}
+}
+
+std::string getFileName(const Dungeon &dungeon, const std::string &directory, const std::string &extension)
+{
+	return directory + "/dungeon_" + std::to_string(dungeon.width) + "x" + std::to_string(dungeon.height) + "_" + std::to_string(dungeon.seed) + extension;
+}
+
+bool dumpDungeon(const Dungeon &dungeon, const std::string &directory)
+{
+	const std::string fileName = getFileName(dungeon, directory, ".txt");
+	FILE *file = fopen(fileName.c_str(), "w");
+	if (!file) {
+		fprintf(stderr, "Could not open \"%s\" for writing\n", fileName.c_str());
+		return false;
+	}
+	fprintf(file, "# %dx%d seed %llu\n", dungeon.width, dungeon.height, (unsigned long long)dungeon.seed);
+	std::vector<char> row(dungeon.width + 1);
+	row[dungeon.width] = '\n';
+	for (int y = 0; y < dungeon.height; y++) {
+		for (int x = 0; x < dungeon.width; x++) {
+			row[x] = getCellChar(dungeon, x, y);
+		}
+		fwrite(row.data(), 1, row.size(), file);
+	}
+	fclose(file);
+	return true;
+}
+
+bool saveDungeon(const Dungeon &dungeon, const std::string &directory)
+{
+	const std::string fileName = getFileName(dungeon, directory, ".dng");
+	if (!DungeonFile::save(dungeon, fileName)) {
+		fprintf(stderr, "Could not write \"%s\"\n", fileName.c_str());
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<GridSize> sizes;
+	uint32_t count = 1;
+	uint64_t seed = 0;
+	uint32_t threads = 1;
+	std::string dumpDirectory;
+	std::string saveDirectory;
+	std::string loadFile;
+
+	for (int i = 1; i < argc - 1; i++) {
+		if (strcmp(argv[i], "-size") == 0) {
+			GridSize size;
+			if (sscanf(argv[i + 1], "%dx%d", &size.width, &size.height) != 2) {
+				size.height = size.width = atoi(argv[i + 1]);
+			}
+			if ((size.width <= 0) || (size.height <= 0)) {
+				fprintf(stderr, "Invalid size \"%s\"\n", argv[i + 1]);
+				return EXIT_FAILURE;
+			}
+			sizes.push_back(size);
+		}
+		if (strcmp(argv[i], "-count") == 0) {
+			count = std::max(atoi(argv[i + 1]), 1);
+		}
+		if (strcmp(argv[i], "-seed") == 0) {
+			seed = strtoull(argv[i + 1], nullptr, 10);
+		}
+		if (strcmp(argv[i], "-threads") == 0) {
+			threads = std::max(atoi(argv[i + 1]), 1);
+		}
+		if (strcmp(argv[i], "-dump") == 0) {
+			dumpDirectory = argv[i + 1];
+		}
+		if (strcmp(argv[i], "-save") == 0) {
+			saveDirectory = argv[i + 1];
+		}
+		if (strcmp(argv[i], "-load") == 0) {
+			loadFile = argv[i + 1];
+		}
+	}
+
+	if (!loadFile.empty()) {
+		DungeonFile file;
+		double tOpen = timeStage([&] { file.open(loadFile); });
+		if (!file.isOpen()) {
+			fprintf(stderr, "Could not open \"%s\" (missing or not a valid level file)\n", loadFile.c_str());
+			return EXIT_FAILURE;
+		}
+		printf("width,height,seed,open(ms),nodes,rooms\n");
+		printf("%d,%d,%llu,%.3f,%u,%u\n", file.header->width, file.header->height, (unsigned long long)file.header->seed, tOpen, file.header->partitionCount, file.header->roomCount);
+		if (!dumpDirectory.empty()) {
+			Dungeon dungeon(file.header->width, file.header->height);
+			file.unpack(dungeon);
+			if (!dumpDungeon(dungeon, dumpDirectory)) {
+				return EXIT_FAILURE;
+			}
+		}
+		return 0;
+	}
+
+	if (sizes.empty()) {
+		sizes.push_back({ 64, 64 });
+	}
+
+	printf("width,height,seed,rooms(ms),corridors(ms),walls(ms),doors(ms),total(ms),partitions,rooms\n");
+
+	for (auto &size : sizes) {
+		Dungeon dungeon(size.width, size.height);
+		dungeon.threadCount = threads;
+		for (uint32_t i = 0; i < count; i++) {
+			const uint64_t dungeonSeed = seed + i;
+			double tRooms = timeStage([&] { dungeon.generateRooms(dungeonSeed); });
+			double tCorridors = timeStage([&] { dungeon.generateCorridors(); });
+			double tWalls = timeStage([&] { dungeon.generateWalls(); });
+			double tDoors = timeStage([&] { dungeon.generateDoors(); });
+			size_t rooms = 0;
+			for (auto index : dungeon.partitionList) {
+				rooms += dungeon.partitions[index].hasRoom ? 1 : 0;
+			}
+			printf("%d,%d,%llu,%.3f,%.3f,%.3f,%.3f,%.3f,%zu,%zu\n",
+				size.width, size.height, (unsigned long long)dungeonSeed,
+				tRooms, tCorridors, tWalls, tDoors, tRooms + tCorridors + tWalls + tDoors,
+				dungeon.partitionList.size(), rooms);
+			if ((!dumpDirectory.empty()) && (!dumpDungeon(dungeon, dumpDirectory))) {
+				return EXIT_FAILURE;
+			}
+			if ((!saveDirectory.empty()) && (!saveDungeon(dungeon, saveDirectory))) {
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	return 0;
+}
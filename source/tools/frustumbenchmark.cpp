@@ -0,0 +1,124 @@
+/*
+* Frustum culling micro benchmark
+*
+* Tests random boxes and spheres around the viewer against a view frustum, one at a time with vks::Frustum::checkBox
+* and checkSphere and in batches with checkBoxes and checkSpheres, and checks that both give the same results
+*
+* Needs glm and the example base headers, so it isn't built with GENERATOR_ONLY
+*
+* Usage: frustumbenchmark [-seed n] [-count n] [-runs n]
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "frustum.hpp"
+#include "../generator/Random.h"
+#include "benchmarkutils.h"
+
+using namespace dungeongenerator;
+
+int main(int argc, char *argv[])
+{
+	uint64_t seed = 0;
+	uint32_t count = 1 << 16;
+	uint32_t runs = 100;
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-seed") == 0) && (i + 1 < argc)) {
+			seed = strtoull(argv[++i], nullptr, 10);
+		}
+		else if ((strcmp(argv[i], "-count") == 0) && (i + 1 < argc)) {
+			count = std::max(atoi(argv[++i]), 1);
+		}
+		else if ((strcmp(argv[i], "-runs") == 0) && (i + 1 < argc)) {
+			runs = std::max(atoi(argv[++i]), 1);
+		}
+	}
+
+	// Same projection as the renderer, looking along a diagonal so no plane normal is axis aligned
+	vks::Frustum frustum;
+	const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1280.0f / 720.0f, 0.1f, 1024.0f);
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(1.0f, -0.6f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	frustum.update(projection * view);
+
+	// Cells within the draw distance (half extents like the renderer's cell boxes) and random spheres
+	Random random(seed, 0);
+	std::vector<float> centerX(count), centerY(count), centerZ(count), extentX(count), extentY(count), extentZ(count), radius(count);
+	for (uint32_t i = 0; i < count; i++) {
+		centerX[i] = (float)random.range(33) - 16.0f;
+		centerY[i] = 0.0f;
+		centerZ[i] = (float)random.range(33) - 16.0f;
+		extentX[i] = 0.5f;
+		extentY[i] = 2.5f;
+		extentZ[i] = 0.5f;
+		radius[i] = random.range(300) / 100.0f;
+	}
+
+	const uint32_t wordCount = (count + 63) / 64;
+	std::vector<uint64_t> scalar(wordCount), batched(wordCount);
+	uint32_t visibleScalar = 0, visibleBatched = 0;
+
+	printf("test,simd width,count,visible,scalar(ns),batched(ns),speedup\n");
+
+	double tScalar = timeStage([&] {
+		for (uint32_t r = 0; r < runs; r++) {
+			std::fill(scalar.begin(), scalar.end(), 0);
+			visibleScalar = 0;
+			for (uint32_t i = 0; i < count; i++) {
+				if (frustum.checkBox(glm::vec3(centerX[i], centerY[i], centerZ[i]), glm::vec3(extentX[i], extentY[i], extentZ[i])) & 1) {
+					scalar[i / 64] |= 1ULL << (i % 64);
+					visibleScalar++;
+				}
+			}
+		}
+	});
+	double tBatched = timeStage([&] {
+		for (uint32_t r = 0; r < runs; r++) {
+			visibleBatched = frustum.checkBoxes(centerX.data(), centerY.data(), centerZ.data(), extentX.data(), extentY.data(), extentZ.data(), count, batched.data());
+		}
+	});
+	printf("box,%d,%u,%u,%.2f,%.2f,%.1f\n", VKS_FRUSTUM_SIMD_WIDTH, count, visibleBatched, tScalar * 1e6 / ((double)runs * count), tBatched * 1e6 / ((double)runs * count), tScalar / std::max(tBatched, 1e-9));
+	if ((scalar != batched) || (visibleScalar != visibleBatched)) {
+		fprintf(stderr, "Batched box test doesn't match checkBox\n");
+		return EXIT_FAILURE;
+	}
+
+	tScalar = timeStage([&] {
+		for (uint32_t r = 0; r < runs; r++) {
+			std::fill(scalar.begin(), scalar.end(), 0);
+			visibleScalar = 0;
+			for (uint32_t i = 0; i < count; i++) {
+				if (frustum.checkSphere(glm::vec3(centerX[i], centerY[i], centerZ[i]), radius[i])) {
+					scalar[i / 64] |= 1ULL << (i % 64);
+					visibleScalar++;
+				}
+			}
+		}
+	});
+	tBatched = timeStage([&] {
+		for (uint32_t r = 0; r < runs; r++) {
+			visibleBatched = frustum.checkSpheres(centerX.data(), centerY.data(), centerZ.data(), radius.data(), count, batched.data());
+		}
+	});
+	printf("sphere,%d,%u,%u,%.2f,%.2f,%.1f\n", VKS_FRUSTUM_SIMD_WIDTH, count, visibleBatched, tScalar * 1e6 / ((double)runs * count), tBatched * 1e6 / ((double)runs * count), tScalar / std::max(tBatched, 1e-9));
+	if ((scalar != batched) || (visibleScalar != visibleBatched)) {
+		fprintf(stderr, "Batched sphere test doesn't match checkSphere\n");
+		return EXIT_FAILURE;
+	}
+
+	return 0;
+}
@@ -0,0 +1,176 @@
+/*
+* Dungeon generator benchmark
+*
+* Measures the throughput (cells per second) of the single generation stages (rooms, corridors,
+* walls and doors) for different grid sizes without the need for a GPU
+*
+* Every run generates a full dungeon with the same seed and times each stage separately. After the
+* warm-up runs, min/max/avg/median/p90/p99 are reported per size and stage and written as CSV
+* (same style as the benchmarkresults.csv of the renderer's benchmark mode) and optionally as JSON
+*
+* Usage: generatorbenchmark [-size n]... [-runs n] [-warmup n] [-seed n] [-threads n] [-csv file] [-json file]
+*
+* Default sizes are 64^2 to 4096^2, larger grids (up to 16384^2) need to be passed explicitly as
+* corridor generation alone takes minutes for those
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "benchmark.hpp"
+#include "../generator/Dungeon.h"
+#include "benchmarkutils.h"
+
+using namespace dungeongenerator;
+
+enum Stage { stageRooms = 0, stageCorridors, stageWalls, stageDoors, stageCount };
+const char* stageNames[stageCount] = { "generateRooms", "generateCorridors", "generateWalls", "generateDoors" };
+
+struct Result {
+	int size;
+	uint32_t runs;
+	Stage stage;
+	vks::BenchmarkStatistics stats;
+	// Throughput based on the median time
+	double cellsPerSecond;
+};
+
+void runBenchmark(int size, uint32_t runs, uint32_t warmup, uint64_t seed, uint32_t threads, std::vector<Result> &results)
+{
+	Dungeon dungeon(size, size, seed);
+	dungeon.threadCount = threads;
+
+	std::vector<double> times[stageCount];
+	for (uint32_t r = 0; r < warmup + runs; r++) {
+		double t[stageCount];
+		t[stageRooms] = timeStage([&] { dungeon.generateRooms(); });
+		t[stageCorridors] = timeStage([&] { dungeon.generateCorridors(); });
+		t[stageWalls] = timeStage([&] { dungeon.generateWalls(); });
+		t[stageDoors] = timeStage([&] { dungeon.generateDoors(); });
+		if (r >= warmup) {
+			for (uint32_t s = 0; s < stageCount; s++) {
+				times[s].push_back(t[s]);
+			}
+		}
+	}
+
+	const double cells = (double)size * size;
+	for (uint32_t s = 0; s < stageCount; s++) {
+		Result result;
+		result.size = size;
+		result.runs = runs;
+		result.stage = (Stage)s;
+		result.stats = vks::BenchmarkStatistics::calculate(times[s]);
+		result.cellsPerSecond = (result.stats.median > 0.0) ? cells / (result.stats.median / 1000.0) : 0.0;
+		results.push_back(result);
+		printf("%5dx%-5d %-18s median %10.3f ms  p99 %10.3f ms  %8.2f Mcells/s\n", size, size, stageNames[s], result.stats.median, result.stats.p99, result.cellsPerSecond / 1.0e6);
+	}
+}
+
+bool saveCSV(const std::string &filename, const std::vector<Result> &results)
+{
+	std::ofstream file(filename, std::ios::out);
+	if (!file.is_open()) {
+		return false;
+	}
+	file << std::fixed << std::setprecision(4);
+	file << "size,stage,runs,min(ms),max(ms),avg(ms),stddev(ms),median(ms),p90(ms),p99(ms),cells/s" << std::endl;
+	for (auto &result : results) {
+		file << result.size << "x" << result.size << "," << stageNames[result.stage] << "," << result.runs << ","
+			<< result.stats.min << "," << result.stats.max << "," << result.stats.avg << "," << result.stats.stddev << ","
+			<< result.stats.median << "," << result.stats.p90 << "," << result.stats.p99 << ","
+			<< std::setprecision(0) << result.cellsPerSecond << std::setprecision(4) << std::endl;
+	}
+	return true;
+}
+
+bool saveJSON(const std::string &filename, const std::vector<Result> &results, uint64_t seed, uint32_t threads)
+{
+	std::ofstream file(filename, std::ios::out);
+	if (!file.is_open()) {
+		return false;
+	}
+	file << std::fixed << std::setprecision(4);
+	file << "{" << std::endl;
+	file << "\t\"seed\": " << seed << "," << std::endl;
+	file << "\t\"threads\": " << threads << "," << std::endl;
+	file << "\t\"results\": [" << std::endl;
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result &result = results[i];
+		file << "\t\t{ \"size\": " << result.size << ", \"stage\": \"" << stageNames[result.stage] << "\", \"runs\": " << result.runs
+			<< ", \"min\": " << result.stats.min << ", \"max\": " << result.stats.max << ", \"avg\": " << result.stats.avg
+			<< ", \"stddev\": " << result.stats.stddev << ", \"median\": " << result.stats.median
+			<< ", \"p90\": " << result.stats.p90 << ", \"p99\": " << result.stats.p99
+			<< ", \"cellsPerSecond\": " << std::setprecision(0) << result.cellsPerSecond << std::setprecision(4) << " }"
+			<< ((i < results.size() - 1) ? "," : "") << std::endl;
+	}
+	file << "\t]" << std::endl;
+	file << "}" << std::endl;
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<int> sizes;
+	int32_t runs = -1;
+	uint32_t warmup = 1;
+	uint64_t seed = 0;
+	uint32_t threads = 1;
+	std::string csvFile = "generatorbenchmarkresults.csv";
+	std::string jsonFile;
+
+	for (int i = 1; i < argc - 1; i++) {
+		if (strcmp(argv[i], "-size") == 0) {
+			sizes.push_back(std::max(atoi(argv[i + 1]), 1));
+		}
+		if (strcmp(argv[i], "-runs") == 0) {
+			runs = std::max(atoi(argv[i + 1]), 1);
+		}
+		if (strcmp(argv[i], "-warmup") == 0) {
+			warmup = std::max(atoi(argv[i + 1]), 0);
+		}
+		if (strcmp(argv[i], "-seed") == 0) {
+			seed = strtoull(argv[i + 1], nullptr, 10);
+		}
+		if (strcmp(argv[i], "-threads") == 0) {
+			threads = std::max(atoi(argv[i + 1]), 1);
+		}
+		if (strcmp(argv[i], "-csv") == 0) {
+			csvFile = argv[i + 1];
+		}
+		if (strcmp(argv[i], "-json") == 0) {
+			jsonFile = argv[i + 1];
+		}
+	}
+	if (sizes.empty()) {
+		sizes = { 64, 256, 1024, 4096 };
+	}
+
+	std::vector<Result> results;
+	for (auto size : sizes) {
+		// Unless set, use fewer runs for larger grids
+		const uint32_t sizeRuns = (runs > 0) ? runs : ((size <= 256) ? 100 : ((size <= 1024) ? 10 : 3));
+		runBenchmark(size, sizeRuns, warmup, seed, threads, results);
+	}
+
+	if (!saveCSV(csvFile, results)) {
+		fprintf(stderr, "Could not write results to \"%s\"\n", csvFile.c_str());
+		return EXIT_FAILURE;
+	}
+	if ((!jsonFile.empty()) && (!saveJSON(jsonFile, results, seed, threads))) {
+		fprintf(stderr, "Could not write results to \"%s\"\n", jsonFile.c_str());
+		return EXIT_FAILURE;
+	}
+
+	return 0;
+}
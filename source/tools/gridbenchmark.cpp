@@ -0,0 +1,184 @@
+/*
+* Dungeon cell grid layout benchmark
+*
+* Compares the flat structure-of-arrays cell grid of the dungeon generator against the
+* previous layout (one heap allocated cell object per grid position)
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "../generator/Dungeon.h"
+#include "benchmarkutils.h"
+
+using namespace dungeongenerator;
+
+/*
+	Replica of the previous cell layout
+	Same size and heap layout as the old class (model matrix, command buffer handle and two bool vectors per cell)
+*/
+struct LegacyCell {
+	int x;
+	int y;
+	int type;
+	bool hasDoor = false;
+	void *commandBuffer = nullptr;
+	bool uncovered = false;
+	float modelMatrix[16];
+	std::vector<bool> walls;
+	std::vector<bool> doors;
+	LegacyCell(int posX, int posY) : x(posX), y(posY), type(Cell::cellTypeEmpty) {
+		walls = { false, false, false, false };
+		doors = { false, false, false, false };
+	}
+};
+
+struct LegacyGrid {
+	int width;
+	int height;
+	std::vector< std::vector<LegacyCell*> > cells;
+
+	LegacyGrid(const Dungeon &source) : width(source.width), height(source.height) {
+		cells.resize(width);
+		for (int x = 0; x < width; ++x) {
+			cells[x].resize(height);
+			for (int y = 0; y < height; ++y) {
+				cells[x][y] = new LegacyCell(x, y);
+				cells[x][y]->type = source.getCellType(x, y);
+			}
+		}
+	}
+
+	~LegacyGrid() {
+		for (auto &column : cells) {
+			for (auto cell : column) {
+				delete cell;
+			}
+		}
+	}
+
+	// Estimated heap footprint (cell objects, pointer columns and the bit storage of both bool vectors incl. allocator overhead)
+	size_t getMemorySize() const {
+		const size_t allocOverhead = 16;
+		const size_t perCell = sizeof(LegacyCell) + allocOverhead + 2 * (sizeof(uint64_t) + allocOverhead) + sizeof(LegacyCell*);
+		return (size_t)width * height * perCell + width * (sizeof(std::vector<LegacyCell*>) + allocOverhead);
+	}
+
+	// Same logic as the previous Dungeon::generateWalls
+	void generateWalls() {
+		for (int x = 0; x < width; ++x) {
+			for (int y = 0; y < height; ++y) {
+				if (cells[x][y]->type != Cell::cellTypeEmpty) {
+					LegacyCell *curCell = cells[x][y];
+					if ((x == 0) || (cells[x - 1][y]->type == Cell::cellTypeEmpty)) {
+						curCell->walls[Cell::dirWest] = true;
+					}
+					if ((x == width - 1) || (cells[x + 1][y]->type == Cell::cellTypeEmpty)) {
+						curCell->walls[Cell::dirEast] = true;
+					}
+					if ((y == 0) || (cells[x][y - 1]->type == Cell::cellTypeEmpty)) {
+						curCell->walls[Cell::dirNorth] = true;
+					}
+					if ((y == height - 1) || (cells[x][y + 1]->type == Cell::cellTypeEmpty)) {
+						curCell->walls[Cell::dirSouth] = true;
+					}
+				}
+			}
+		}
+	}
+
+	uint32_t countWalls() const {
+		uint32_t count = 0;
+		for (auto &column : cells) {
+			for (auto cell : column) {
+				for (auto w : cell->walls) {
+					count += w ? 1 : 0;
+				}
+			}
+		}
+		return count;
+	}
+};
+
+uint32_t countWalls(const Dungeon &dungeon) {
+	uint32_t count = 0;
+	for (auto mask : dungeon.cellWalls) {
+		for (int dir = 0; dir < 4; dir++) {
+			count += (mask & Cell::dirBit(dir)) ? 1 : 0;
+		}
+	}
+	return count;
+}
+
+void runBenchmark(int size, const Dungeon &tile, uint32_t runs) {
+	Dungeon dungeon(size, size);
+	fillDungeon(dungeon, tile);
+	LegacyGrid legacy(dungeon);
+
+	volatile uint32_t sink = 0;
+
+	// Full grid walk counting non-empty cells
+	double tWalkLegacy = timeRuns(runs, [&] {
+		uint32_t count = 0;
+		for (int x = 0; x < legacy.width; x++) {
+			for (int y = 0; y < legacy.height; y++) {
+				count += (legacy.cells[x][y]->type != Cell::cellTypeEmpty) ? 1 : 0;
+			}
+		}
+		sink = count;
+	});
+	double tWalkFlat = timeRuns(runs, [&] {
+		uint32_t count = 0;
+		for (auto type : dungeon.cellTypes) {
+			count += (type != Cell::cellTypeEmpty) ? 1 : 0;
+		}
+		sink = count;
+	});
+
+	// Wall generation
+	double tWallsLegacy = timeRuns(runs, [&] { legacy.generateWalls(); });
+	double tWallsFlat = timeRuns(runs, [&] { dungeon.generateWalls(); });
+
+	if (countWalls(dungeon) != legacy.countWalls()) {
+		fprintf(stderr, "Wall mismatch for %dx%d grid!\n", size, size);
+		exit(EXIT_FAILURE);
+	}
+
+	const double mbLegacy = legacy.getMemorySize() / (1024.0 * 1024.0);
+	const double mbFlat = dungeon.getCellMemorySize() / (1024.0 * 1024.0);
+
+	printf("%5dx%-5d walk: %9.3f ms -> %9.3f ms (%5.1fx)  walls: %9.3f ms -> %9.3f ms (%5.1fx)  memory: %9.2f MB -> %8.2f MB (%5.1f%%)\n",
+		size, size,
+		tWalkLegacy, tWalkFlat, tWalkLegacy / tWalkFlat,
+		tWallsLegacy, tWallsFlat, tWallsLegacy / tWallsFlat,
+		mbLegacy, mbFlat, mbFlat / mbLegacy * 100.0);
+}
+
+int main(int argc, char *argv[])
+{
+	Dungeon tile(64, 64, 0);
+	tile.generateRooms();
+	tile.generateCorridors();
+
+	std::vector<int> sizes = { 64, 4096 };
+	if (argc > 1) {
+		sizes.clear();
+		for (int i = 1; i < argc; i++) {
+			sizes.push_back(atoi(argv[i]));
+		}
+	}
+
+	for (auto size : sizes) {
+		runBenchmark(size, tile, (size <= 256) ? 100 : 3);
+	}
+
+	return 0;
+}
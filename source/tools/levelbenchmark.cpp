@@ -0,0 +1,208 @@
+/*
+* Dungeon level file benchmark
+*
+* Saves generated dungeons as level files and compares loading them (memory mapped, optionally unpacked
+* into a dungeon) against generating them again. Also checks that the loaded levels match the generated ones
+* and that levels with a corrupt partition table are rejected
+*
+* Usage: levelbenchmark [-seed n] [-directory path] [sizes...]
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "../generator/Dungeon.h"
+#include "../generator/DungeonFile.h"
+#include "benchmarkutils.h"
+
+using namespace dungeongenerator;
+
+bool compareCells(const Dungeon &dungeon, DungeonFile &file)
+{
+	for (int y = 0; y < dungeon.height; y++) {
+		for (int x = 0; x < dungeon.width; x++) {
+			const uint32_t index = dungeon.getCellIndex(x, y);
+			if ((file.getCellType(x, y) != dungeon.cellTypes[index]) ||
+				(file.getCellWalls(x, y) != dungeon.cellWalls[index]) ||
+				(file.getCellDoors(x, y) != dungeon.cellDoors[index])) {
+				fprintf(stderr, "Mapped level differs at %d/%d\n", x, y);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool compareDungeons(const Dungeon &a, const Dungeon &b)
+{
+	if ((a.cellTypes != b.cellTypes) || (a.cellWalls != b.cellWalls) || (a.cellDoors != b.cellDoors) || (a.partitionList != b.partitionList) ||
+		(a.partitions.nodes.size() != b.partitions.nodes.size())) {
+		return false;
+	}
+	for (size_t i = 0; i < a.partitions.nodes.size(); i++) {
+		const BspPartition &pa = a.partitions.nodes[i];
+		const BspPartition &pb = b.partitions.nodes[i];
+		if ((pa.parent != pb.parent) || (pa.firstChild != pb.firstChild) || (pa.left != pb.left) || (pa.right != pb.right) || (pa.top != pb.top) ||
+			(pa.bottom != pb.bottom) || (pa.centerX != pb.centerX) || (pa.centerY != pb.centerY) || (pa.hasRoom != pb.hasRoom)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+	Level files with a broken partition table must be rejected on open, a level without any rooms must load and
+	report that it has no room to start in
+*/
+bool checkCorruptFiles(const Dungeon &dungeon, const std::string &fileName)
+{
+	FILE *file = fopen(fileName.c_str(), "rb");
+	if (!file) {
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	std::vector<uint8_t> original((size_t)ftell(file));
+	fseek(file, 0, SEEK_SET);
+	const bool read = fread(original.data(), 1, original.size(), file) == original.size();
+	fclose(file);
+	if (!read) {
+		return false;
+	}
+
+	DungeonFile::Header header;
+	memcpy(&header, original.data(), sizeof(header));
+	const uint32_t last = header.partitionCount - 1;
+	struct Corruption {
+		const char *name;
+		uint32_t index;
+		size_t offset;
+		int32_t value;
+	} corruptions[] = {
+		{ "parent out of range", last, offsetof(DungeonFile::PartitionEntry, parent), (int32_t)header.partitionCount },
+		{ "parent after child", 1, offsetof(DungeonFile::PartitionEntry, parent), (int32_t)last },
+		{ "right outside of the grid", last, offsetof(DungeonFile::PartitionEntry, right), dungeon.width + 1 },
+		{ "negative top", last, offsetof(DungeonFile::PartitionEntry, top), -1 },
+		{ "center outside of the bounds", last, offsetof(DungeonFile::PartitionEntry, centerX), -1 },
+	};
+	const std::string corruptName = fileName + ".corrupt";
+	bool passed = true;
+	for (auto &corruption : corruptions) {
+		std::vector<uint8_t> data = original;
+		memcpy(data.data() + header.partitionTableOffset + corruption.index * sizeof(DungeonFile::PartitionEntry) + corruption.offset, &corruption.value, sizeof(int32_t));
+		file = fopen(corruptName.c_str(), "wb");
+		fwrite(data.data(), 1, data.size(), file);
+		fclose(file);
+		DungeonFile level;
+		if (level.open(corruptName)) {
+			fprintf(stderr, "Level with %s was not rejected\n", corruption.name);
+			passed = false;
+		}
+	}
+
+	// Same level without rooms
+	std::vector<uint8_t> data = original;
+	DungeonFile::PartitionEntry *entries = (DungeonFile::PartitionEntry*)(data.data() + header.partitionTableOffset);
+	for (uint32_t i = 0; i < header.partitionCount; i++) {
+		entries[i].hasRoom = 0;
+	}
+	((DungeonFile::Header*)data.data())->roomCount = 0;
+	file = fopen(corruptName.c_str(), "wb");
+	fwrite(data.data(), 1, data.size(), file);
+	fclose(file);
+	DungeonFile level;
+	Dungeon empty(dungeon.width, dungeon.height);
+	if ((!level.open(corruptName)) || (!level.unpack(empty)) || (empty.getRandomRoom() != nullptr)) {
+		fprintf(stderr, "Level without rooms was not handled\n");
+		passed = false;
+	}
+	level.close();
+	remove(corruptName.c_str());
+	return passed;
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t seed = 0;
+	std::string directory = ".";
+	std::vector<int> sizes;
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-seed") == 0) && (i + 1 < argc)) {
+			seed = strtoull(argv[++i], nullptr, 10);
+		}
+		else if ((strcmp(argv[i], "-directory") == 0) && (i + 1 < argc)) {
+			directory = argv[++i];
+		}
+		else {
+			sizes.push_back(atoi(argv[i]));
+		}
+	}
+	if (sizes.empty()) {
+		sizes = { 64, 256, 1024, 4096 };
+	}
+
+	printf("size,generate(ms),save(ms),file(KB),cells(KB),open(ms),unpack(ms),scan(ms)\n");
+
+	for (auto size : sizes) {
+		Dungeon dungeon(size, size, seed);
+		double tGenerate = timeStage([&] {
+			dungeon.generateRooms();
+			dungeon.generateCorridors();
+			dungeon.generateWalls();
+			dungeon.generateDoors();
+		});
+
+		const std::string fileName = directory + "/level_" + std::to_string(size) + ".dng";
+		bool saved = false;
+		double tSave = timeStage([&] { saved = DungeonFile::save(dungeon, fileName); });
+		if (!saved) {
+			fprintf(stderr, "Could not write \"%s\"\n", fileName.c_str());
+			return EXIT_FAILURE;
+		}
+
+		DungeonFile file;
+		double tOpen = timeStage([&] { file.open(fileName); });
+		if (!file.isOpen()) {
+			fprintf(stderr, "Could not open \"%s\"\n", fileName.c_str());
+			return EXIT_FAILURE;
+		}
+
+		Dungeon loaded(size, size);
+		double tUnpack = timeStage([&] { file.unpack(loaded); });
+		if (!compareDungeons(dungeon, loaded)) {
+			fprintf(stderr, "Unpacked level differs from the generated dungeon (%dx%d)\n", size, size);
+			return EXIT_FAILURE;
+		}
+
+		// Cell access directly on the mapped file
+		volatile uint32_t sink = 0;
+		double tScan = timeStage([&] {
+			uint32_t count = 0;
+			for (int y = 0; y < size; y++) {
+				for (int x = 0; x < size; x++) {
+					count += file.getCellWalls(x, y);
+				}
+			}
+			sink = count;
+		});
+		if ((!compareCells(dungeon, file)) || (!checkCorruptFiles(dungeon, fileName))) {
+			return EXIT_FAILURE;
+		}
+
+		printf("%d,%.3f,%.3f,%.1f,%.1f,%.3f,%.3f,%.3f\n", size, tGenerate, tSave, file.header->fileSize / 1024.0, dungeon.getCellMemorySize() / 1024.0, tOpen, tUnpack, tScan);
+		file.close();
+		remove(fileName.c_str());
+	}
+
+	return 0;
+}
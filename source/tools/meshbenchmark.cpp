@@ -0,0 +1,218 @@
+/*
+* Merged dungeon mesh benchmark
+*
+* Bakes the merged chunk meshes for dungeons of different sizes (CPU only) and compares the vertex, index and draw
+* counts with drawing every cell face separately (six vertices and one draw per face)
+*
+* Checks that the merged quads cover every face of the per cell renderer exactly once (same face type and texture
+* set) and nothing else, and that building on a thread pool and rebuilding edited chunks give the same result as a
+* full single threaded build
+*
+* Usage: meshbenchmark [-seed n] [-chunksize n] [-threads n] [sizes...]
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#include "../generator/Dungeon.h"
+#include "../generator/DungeonMesh.h"
+#include "threadpool.hpp"
+#include "benchmarkutils.h"
+
+using namespace dungeongenerator;
+
+// Face type of a quad from its normal and height
+uint32_t getFaceType(const DungeonMesh &mesh, const DungeonMesh::Vertex &vertex)
+{
+	if (vertex.normal[1] != 0.0f) {
+		return (vertex.position[1] == mesh.floorY) ? DungeonMesh::faceFloor : DungeonMesh::faceCeiling;
+	}
+	if (vertex.normal[2] != 0.0f) {
+		return (vertex.normal[2] > 0.0f) ? DungeonMesh::faceWallNorth : DungeonMesh::faceWallSouth;
+	}
+	return (vertex.normal[0] > 0.0f) ? DungeonMesh::faceWallWest : DungeonMesh::faceWallEast;
+}
+
+// Returns the number of chunks that differ between the meshes
+uint32_t compareMeshes(const DungeonMesh &a, const DungeonMesh &b)
+{
+	uint32_t differences = 0;
+	for (size_t i = 0; i < a.chunks.size(); i++) {
+		const DungeonMesh::Chunk &chunkA = a.chunks[i];
+		const DungeonMesh::Chunk &chunkB = b.chunks[i];
+		if ((chunkA.indices != chunkB.indices) || (chunkA.vertices.size() != chunkB.vertices.size()) ||
+			((!chunkA.vertices.empty()) && (memcmp(chunkA.vertices.data(), chunkB.vertices.data(), chunkA.vertices.size() * sizeof(DungeonMesh::Vertex)) != 0))) {
+			differences++;
+		}
+	}
+	return differences;
+}
+
+/*
+	Marks the cell faces covered by the quads of all chunks (one counter per cell, face type and texture set)
+	Returns the number of quads that cover a face the per cell renderer doesn't draw
+*/
+uint32_t checkCoverage(Dungeon &dungeon, DungeonMesh &mesh, std::vector<uint8_t> &coverage)
+{
+	const uint32_t stride = 6 * DungeonMesh::textureSetCount;
+	coverage.assign(dungeon.cellTypes.size() * stride, 0);
+	DungeonAccessor cells(&dungeon);
+	static const int directions[] = { 0, Cell::dirNorth, Cell::dirSouth, Cell::dirWest, Cell::dirEast };
+	uint32_t errors = 0;
+	for (auto &chunk : mesh.chunks) {
+		for (uint32_t set = 0; set < DungeonMesh::textureSetCount; set++) {
+			const uint32_t first = chunk.firstIndex[set];
+			for (uint32_t i = first; i < first + chunk.indexCount[set]; i += 6) {
+				// Quads are two triangles (0, 1, 2) and (0, 2, 3)
+				const DungeonMesh::Vertex *corners[4] = {
+					&chunk.vertices[chunk.indices[i]], &chunk.vertices[chunk.indices[i + 1]], &chunk.vertices[chunk.indices[i + 2]], &chunk.vertices[chunk.indices[i + 5]]
+				};
+				const uint32_t face = getFaceType(mesh, *corners[0]);
+				const bool ceiling = (i >= first + chunk.indexCount[set] - chunk.ceilingIndexCount[set]);
+				if (ceiling != (face == DungeonMesh::faceCeiling)) {
+					errors++;
+				}
+				float minX = corners[0]->position[0], maxX = minX, minZ = corners[0]->position[2], maxZ = minZ;
+				for (auto corner : corners) {
+					minX = std::min(minX, corner->position[0]);
+					maxX = std::max(maxX, corner->position[0]);
+					minZ = std::min(minZ, corner->position[2]);
+					maxZ = std::max(maxZ, corner->position[2]);
+				}
+				// Cells whose face lies on the quad, walls are on the cell border facing into the cell
+				int x0 = (int)lroundf(minX + 0.5f), x1 = (int)lroundf(maxX - 0.5f);
+				int y0 = (int)lroundf(minZ + 0.5f), y1 = (int)lroundf(maxZ - 0.5f);
+				if ((face == DungeonMesh::faceWallNorth) || (face == DungeonMesh::faceWallSouth)) {
+					y0 = y1 = (int)lroundf(minZ + ((face == DungeonMesh::faceWallNorth) ? 0.5f : -0.5f));
+				}
+				if ((face == DungeonMesh::faceWallWest) || (face == DungeonMesh::faceWallEast)) {
+					x0 = x1 = (int)lroundf(minX + ((face == DungeonMesh::faceWallWest) ? 0.5f : -0.5f));
+				}
+				for (int y = y0; y <= y1; y++) {
+					for (int x = x0; x <= x1; x++) {
+						const uint8_t cellType = cells.getCellType(x, y);
+						const bool drawn = (cellType != Cell::cellTypeEmpty) && (DungeonMesh::getTextureSet(cellType) == set) &&
+							((face == DungeonMesh::faceFloor) || (face == DungeonMesh::faceCeiling) || (cells.hasWall(x, y, directions[face])));
+						if (!drawn) {
+							errors++;
+							continue;
+						}
+						coverage[dungeon.getCellIndex(x, y) * stride + set * 6 + face]++;
+					}
+				}
+			}
+		}
+	}
+	return errors;
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t seed = 0;
+	int chunkSize = 16;
+	uint32_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::vector<int> sizes;
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-seed") == 0) && (i + 1 < argc)) {
+			seed = strtoull(argv[++i], nullptr, 10);
+		}
+		else if ((strcmp(argv[i], "-chunksize") == 0) && (i + 1 < argc)) {
+			chunkSize = std::max(atoi(argv[++i]), 1);
+		}
+		else if ((strcmp(argv[i], "-threads") == 0) && (i + 1 < argc)) {
+			threads = std::max(atoi(argv[++i]), 1);
+		}
+		else {
+			sizes.push_back(atoi(argv[i]));
+		}
+	}
+	if (sizes.empty()) {
+		sizes = { 64, 256, 1024 };
+	}
+
+	vks::ThreadPool threadPool;
+	threadPool.setThreadCount(threads);
+
+	printf("size,chunks,build(ms),build %u threads(ms),update(ms),cell faces,cell vertices,cell draws,merged quads,merged vertices,merged indices,merged draws,memory(KB)\n", threads);
+
+	for (auto size : sizes) {
+		Dungeon dungeon(size, size, seed);
+		dungeon.generateRooms();
+		dungeon.generateCorridors();
+		dungeon.generateWalls();
+		dungeon.generateDoors();
+		DungeonAccessor cells(&dungeon);
+
+		DungeonMesh mesh;
+		double tBuild = timeStage([&] { mesh.build(cells, dungeon.width, dungeon.height, chunkSize); });
+		DungeonMesh meshThreaded;
+		double tBuildThreaded = timeStage([&] { meshThreaded.build(cells, dungeon.width, dungeon.height, chunkSize, &threadPool); });
+		if (compareMeshes(mesh, meshThreaded) > 0) {
+			fprintf(stderr, "Meshes built on the thread pool differ (%dx%d)\n", size, size);
+			return EXIT_FAILURE;
+		}
+
+		// Expected faces: floor and ceiling of every non-empty cell plus its walls
+		const uint32_t stride = 6 * DungeonMesh::textureSetCount;
+		static const int directions[] = { 0, Cell::dirNorth, Cell::dirSouth, Cell::dirWest, Cell::dirEast };
+		std::vector<uint8_t> coverage;
+		uint32_t errors = checkCoverage(dungeon, mesh, coverage);
+		uint64_t cellFaces = 0;
+		for (int y = 0; y < size; y++) {
+			for (int x = 0; x < size; x++) {
+				const uint8_t cellType = dungeon.getCellType(x, y);
+				for (uint32_t set = 0; set < DungeonMesh::textureSetCount; set++) {
+					for (uint32_t face = 0; face < 6; face++) {
+						const bool expected = (cellType != Cell::cellTypeEmpty) && (DungeonMesh::getTextureSet(cellType) == set) &&
+							((face == DungeonMesh::faceFloor) || (face == DungeonMesh::faceCeiling) || (dungeon.hasWall(x, y, directions[face])));
+						cellFaces += expected ? 1 : 0;
+						if (coverage[dungeon.getCellIndex(x, y) * stride + set * 6 + face] != (expected ? 1 : 0)) {
+							errors++;
+						}
+					}
+				}
+			}
+		}
+
+		uint64_t quads = 0, draws = 0, mergedFaces = 0;
+		for (auto &chunk : mesh.chunks) {
+			quads += chunk.indices.size() / 6;
+			mergedFaces += chunk.cellFaceCount;
+			for (uint32_t set = 0; set < DungeonMesh::textureSetCount; set++) {
+				draws += (chunk.indexCount[set] > 0) ? 1 : 0;
+			}
+		}
+		if (mergedFaces != cellFaces) {
+			errors++;
+		}
+
+		// Dig a line through the middle and compare the updated chunks with a full rebuild
+		dungeon.setCellTypes(1, size / 2, size - 2, size / 2, Cell::cellTypeCorridor);
+		dungeon.updateDirtyRegions();
+		double tUpdate = timeStage([&] { mesh.update(cells, dungeon.changedCells); });
+		DungeonMesh reference;
+		reference.build(cells, dungeon.width, dungeon.height, chunkSize);
+		errors += compareMeshes(mesh, reference);
+
+		printf("%d,%zu,%.3f,%.3f,%.3f,%llu,%llu,%llu,%llu,%zu,%zu,%llu,%zu\n", size, mesh.chunks.size(), tBuild, tBuildThreaded, tUpdate,
+			(unsigned long long)cellFaces, (unsigned long long)cellFaces * 6, (unsigned long long)cellFaces, (unsigned long long)quads,
+			reference.getVertexCount(), reference.getIndexCount(), (unsigned long long)draws, mesh.getMemorySize() / 1024);
+		if (errors > 0) {
+			fprintf(stderr, "Merged mesh doesn't match the cell faces (%dx%d, %u errors)\n", size, size, errors);
+			return EXIT_FAILURE;
+		}
+	}
+
+	return 0;
+}
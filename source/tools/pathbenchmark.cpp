@@ -0,0 +1,213 @@
+/*
+* Path finding benchmark
+*
+* Builds the hierarchical path finding graph for dungeons of different sizes and measures path queries per second
+* between random cells, single threaded and batched on a thread pool. Local queries (destination within 32 cells
+* of the start, e.g. monsters chasing the player) are measured separately
+*
+* All paths are checked for validity, a sample is compared against the shortest path found by a breadth first
+* search over the whole grid
+*
+* Usage: pathbenchmark [-seed n] [-queries n] [-threads n] [-verify n] [sizes...]
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#include "../generator/Dungeon.h"
+#include "../generator/Pathfinder.h"
+#include "threadpool.hpp"
+#include "benchmarkutils.h"
+
+using namespace dungeongenerator;
+
+// Length of the shortest path (in steps) using a breadth first search over the whole grid, -1 if there is none
+int getShortestPathLength(const Dungeon &dungeon, uint32_t start, uint32_t dest, std::vector<int32_t> &distances, std::vector<uint32_t> &queue)
+{
+	std::fill(distances.begin(), distances.end(), -1);
+	queue.clear();
+	queue.push_back(start);
+	distances[start] = 0;
+	for (size_t i = 0; i < queue.size(); i++) {
+		const uint32_t cell = queue[i];
+		if (cell == dest) {
+			return distances[cell];
+		}
+		const int x = cell % dungeon.width;
+		const int y = cell / dungeon.width;
+		const int neighbours[4][2] = { { x, y - 1 }, { x, y + 1 }, { x - 1, y }, { x + 1, y } };
+		for (auto &n : neighbours) {
+			if ((n[0] < 0) || (n[1] < 0) || (n[0] >= dungeon.width) || (n[1] >= dungeon.height)) {
+				continue;
+			}
+			const uint32_t neighbour = dungeon.getCellIndex(n[0], n[1]);
+			if ((distances[neighbour] < 0) && (dungeon.cellTypes[neighbour] != Cell::cellTypeEmpty)) {
+				distances[neighbour] = distances[cell] + 1;
+				queue.push_back(neighbour);
+			}
+		}
+	}
+	return -1;
+}
+
+bool checkPath(const Dungeon &dungeon, const Pathfinder::Request &request)
+{
+	const std::vector<uint32_t> &path = request.path;
+	if (path.empty() || (path.front() != dungeon.getCellIndex(request.startX, request.startY)) || (path.back() != dungeon.getCellIndex(request.destX, request.destY))) {
+		return false;
+	}
+	for (size_t i = 0; i < path.size(); i++) {
+		if (dungeon.cellTypes[path[i]] == Cell::cellTypeEmpty) {
+			return false;
+		}
+		if (i > 0) {
+			const int dx = abs((int)(path[i] % dungeon.width) - (int)(path[i - 1] % dungeon.width));
+			const int dy = abs((int)(path[i] / dungeon.width) - (int)(path[i - 1] / dungeon.width));
+			if (dx + dy != 1) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Runs the requests serially and batched on the thread pool, checks all paths and that both runs have the same results
+bool runQueries(const Dungeon &dungeon, Pathfinder &pathfinder, std::vector<Pathfinder::Request> &requests, vks::ThreadPool &threadPool, double &tSerial, double &tParallel, double &averageLength)
+{
+	tSerial = timeStage([&] { pathfinder.findPaths(requests); });
+	std::vector<std::vector<uint32_t>> serialPaths(requests.size());
+	for (size_t i = 0; i < requests.size(); i++) {
+		serialPaths[i].swap(requests[i].path);
+	}
+	tParallel = timeStage([&] { pathfinder.findPaths(requests, &threadPool); });
+
+	size_t totalLength = 0;
+	for (size_t i = 0; i < requests.size(); i++) {
+		if (!checkPath(dungeon, requests[i])) {
+			fprintf(stderr, "Invalid path from %d/%d to %d/%d (%dx%d)\n", requests[i].startX, requests[i].startY, requests[i].destX, requests[i].destY, dungeon.width, dungeon.height);
+			return false;
+		}
+		if (requests[i].path != serialPaths[i]) {
+			fprintf(stderr, "Batched and serial paths differ (%dx%d)\n", dungeon.width, dungeon.height);
+			return false;
+		}
+		totalLength += requests[i].path.size() - 1;
+	}
+	averageLength = (double)totalLength / requests.size();
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t seed = 0;
+	uint32_t queryCount = 10000;
+	uint32_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+	uint32_t verifyCount = 200;
+	std::vector<int> sizes;
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-seed") == 0) && (i + 1 < argc)) {
+			seed = strtoull(argv[++i], nullptr, 10);
+		}
+		else if ((strcmp(argv[i], "-queries") == 0) && (i + 1 < argc)) {
+			queryCount = std::max(atoi(argv[++i]), 1);
+		}
+		else if ((strcmp(argv[i], "-threads") == 0) && (i + 1 < argc)) {
+			threads = std::max(atoi(argv[++i]), 1);
+		}
+		else if ((strcmp(argv[i], "-verify") == 0) && (i + 1 < argc)) {
+			verifyCount = atoi(argv[++i]);
+		}
+		else {
+			sizes.push_back(atoi(argv[i]));
+		}
+	}
+	if (sizes.empty()) {
+		sizes = { 256, 1024 };
+	}
+
+	vks::ThreadPool threadPool;
+	threadPool.setThreadCount(threads);
+
+	printf("size,build(ms),memory(MB),regions,nodes,edges,queries,queries/s (1 thread),queries/s (%u threads),avg. length,local queries/s (1 thread),local queries/s (%u threads),avg. local length,optimal\n", threads, threads);
+
+	for (auto size : sizes) {
+		Dungeon dungeon(size, size, seed);
+		dungeon.generateRooms();
+		dungeon.generateCorridors();
+		dungeon.generateWalls();
+		dungeon.generateDoors();
+
+		Pathfinder pathfinder;
+		double tBuild = timeStage([&] { pathfinder.build(dungeon); });
+
+		// Random pairs of non-empty cells
+		std::vector<uint32_t> walkable;
+		for (uint32_t i = 0; i < dungeon.cellTypes.size(); i++) {
+			if (dungeon.cellTypes[i] != Cell::cellTypeEmpty) {
+				walkable.push_back(i);
+			}
+		}
+		Random random(seed, 1);
+		std::vector<Pathfinder::Request> requests(queryCount);
+		for (auto &request : requests) {
+			const uint32_t start = walkable[random.next() % walkable.size()];
+			const uint32_t dest = walkable[random.next() % walkable.size()];
+			request.startX = start % size;
+			request.startY = start / size;
+			request.destX = dest % size;
+			request.destY = dest / size;
+		}
+
+		std::vector<Pathfinder::Request> localRequests(queryCount);
+		const int localRange = 32;
+		for (auto &request : localRequests) {
+			const uint32_t start = walkable[random.next() % walkable.size()];
+			request.startX = request.destX = start % size;
+			request.startY = request.destY = start / size;
+			for (uint32_t attempt = 0; attempt < 64; attempt++) {
+				const int x = request.startX + random.range(2 * localRange + 1) - localRange;
+				const int y = request.startY + random.range(2 * localRange + 1) - localRange;
+				if ((x >= 0) && (y >= 0) && (x < size) && (y < size) && (dungeon.getCellType(x, y) != Cell::cellTypeEmpty)) {
+					request.destX = x;
+					request.destY = y;
+					break;
+				}
+			}
+		}
+
+		double tSerial, tParallel, tLocalSerial, tLocalParallel;
+		double averageLength, averageLocalLength;
+		if ((!runQueries(dungeon, pathfinder, requests, threadPool, tSerial, tParallel, averageLength)) ||
+			(!runQueries(dungeon, pathfinder, localRequests, threadPool, tLocalSerial, tLocalParallel, averageLocalLength))) {
+			return EXIT_FAILURE;
+		}
+
+		// Compare a sample against the shortest paths
+		std::vector<int32_t> distances(dungeon.cellTypes.size());
+		std::vector<uint32_t> queue;
+		uint32_t optimal = 0;
+		const uint32_t verified = std::min(verifyCount, queryCount);
+		for (uint32_t i = 0; i < verified; i++) {
+			const Pathfinder::Request &request = requests[i];
+			const int shortest = getShortestPathLength(dungeon, dungeon.getCellIndex(request.startX, request.startY), dungeon.getCellIndex(request.destX, request.destY), distances, queue);
+			optimal += ((int)request.path.size() - 1 == shortest) ? 1 : 0;
+		}
+
+		printf("%d,%.3f,%.2f,%zu,%zu,%zu,%u,%.0f,%.0f,%.1f,%.0f,%.0f,%.1f,%u/%u\n", size, tBuild, pathfinder.getMemorySize() / (1024.0 * 1024.0),
+			pathfinder.regions.size(), pathfinder.nodes.size(), pathfinder.edges.size(), queryCount,
+			queryCount / (tSerial / 1000.0), queryCount / (tParallel / 1000.0), averageLength,
+			queryCount / (tLocalSerial / 1000.0), queryCount / (tLocalParallel / 1000.0), averageLocalLength, optimal, verified);
+	}
+
+	return 0;
+}
@@ -0,0 +1,227 @@
+/*
+* Portal culling benchmark
+*
+* Builds the portal graph for dungeons of different sizes and renders random views (CPU only): counts the cells
+* within the draw distance that pass the frustum test, the potentially visible set and the portal test and measures
+* the time for traversing the portal graph
+*
+* Checks that portal culling is conservative: cells hit by horizontal rays cast from the viewer through the screen
+* must never be culled
+*
+* Usage: portalbenchmark [-seed n] [-views n] [sizes...]
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "../generator/Dungeon.h"
+#include "../generator/PortalGraph.h"
+#include "../generator/PotentiallyVisibleSet.h"
+#include "benchmarkutils.h"
+
+using namespace dungeongenerator;
+
+// Same settings as the renderer
+const float fieldOfView = 60.0f;
+const float aspectRatio = 1280.0f / 720.0f;
+const float maxDrawDistance = 16.0f;
+const float eyeHeight = -0.5f;
+
+// Column major view projection matrix (right handed, depth zero to one like the renderer) for a horizontal view direction
+void getViewProjection(float eyeX, float eyeZ, float yaw, float *m)
+{
+	const float f = 1.0f / tanf(fieldOfView * 0.5f * 3.14159265f / 180.0f);
+	const float zNear = 0.1f;
+	const float zFar = 1024.0f;
+	float projection[16] = { 0.0f };
+	projection[0] = f / aspectRatio;
+	projection[5] = f;
+	projection[10] = zFar / (zNear - zFar);
+	projection[11] = -1.0f;
+	projection[14] = -(zFar * zNear) / (zFar - zNear);
+	// Forward (fx, 0, fz), side = forward x up, up = side x forward = (0, 1, 0)
+	const float fx = sinf(yaw);
+	const float fz = cosf(yaw);
+	const float sx = -fz;
+	const float sz = fx;
+	const float eye[3] = { eyeX, eyeHeight, eyeZ };
+	float view[16] = {
+		sx, 0.0f, -fx, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		sz, 0.0f, -fz, 0.0f,
+		-(sx * eye[0] + sz * eye[2]), -eye[1], fx * eye[0] + fz * eye[2], 1.0f
+	};
+	for (uint32_t c = 0; c < 4; c++) {
+		for (uint32_t r = 0; r < 4; r++) {
+			m[c * 4 + r] = 0.0f;
+			for (uint32_t k = 0; k < 4; k++) {
+				m[c * 4 + r] += projection[k * 4 + r] * view[c * 4 + k];
+			}
+		}
+	}
+}
+
+inline void getCellBox(const PortalGraph &portals, int x, int y, float *boxMin, float *boxMax)
+{
+	boxMin[0] = x - 0.5f;
+	boxMin[1] = portals.minY;
+	boxMin[2] = y - 0.5f;
+	boxMax[0] = x + 0.5f;
+	boxMax[1] = portals.maxY;
+	boxMax[2] = y + 0.5f;
+}
+
+// Casts horizontal rays through the screen, returns the number of cells hit by a ray but culled by the portal graph
+uint32_t checkRays(const Dungeon &dungeon, const PortalGraph &portals, const float *viewProjection, float eyeX, float eyeZ, float yaw)
+{
+	const float halfWidth = aspectRatio * tanf(fieldOfView * 0.5f * 3.14159265f / 180.0f);
+	const float fx = sinf(yaw);
+	const float fz = cosf(yaw);
+	uint32_t missed = 0;
+	const uint32_t rayCount = 256;
+	for (uint32_t i = 0; i < rayCount; i++) {
+		const float screenX = -0.98f + 1.96f * i / (rayCount - 1);
+		float dx = fx - fz * screenX * halfWidth;
+		float dz = fz + fx * screenX * halfWidth;
+		const float length = sqrtf(dx * dx + dz * dz);
+		dx /= length;
+		dz /= length;
+		// Walk the cells along the ray (cell x covers [x - 0.5, x + 0.5))
+		int x = (int)floorf(eyeX + 0.5f);
+		int y = (int)floorf(eyeZ + 0.5f);
+		const int stepX = (dx > 0.0f) ? 1 : -1;
+		const int stepY = (dz > 0.0f) ? 1 : -1;
+		const float deltaX = (dx != 0.0f) ? fabsf(1.0f / dx) : 1e30f;
+		const float deltaY = (dz != 0.0f) ? fabsf(1.0f / dz) : 1e30f;
+		float tMaxX = (dx > 0.0f) ? (x + 0.5f - eyeX) * deltaX : ((dx < 0.0f) ? (eyeX - (x - 0.5f)) * deltaX : 1e30f);
+		float tMaxY = (dz > 0.0f) ? (y + 0.5f - eyeZ) * deltaY : ((dz < 0.0f) ? (eyeZ - (y - 0.5f)) * deltaY : 1e30f);
+		float t = 0.0f;
+		while (t <= maxDrawDistance) {
+			if ((x < 0) || (y < 0) || (x >= dungeon.width) || (y >= dungeon.height) || (dungeon.getCellType(x, y) == Cell::cellTypeEmpty)) {
+				break;
+			}
+			float boxMin[3], boxMax[3];
+			getCellBox(portals, x, y, boxMin, boxMax);
+			if (!portals.isBoxVisible(dungeon.getCellIndex(x, y), boxMin, boxMax, viewProjection)) {
+				missed++;
+			}
+			if (tMaxX < tMaxY) {
+				t = tMaxX;
+				tMaxX += deltaX;
+				x += stepX;
+			}
+			else {
+				t = tMaxY;
+				tMaxY += deltaY;
+				y += stepY;
+			}
+		}
+	}
+	return missed;
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t seed = 0;
+	uint32_t viewCount = 2000;
+	std::vector<int> sizes;
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-seed") == 0) && (i + 1 < argc)) {
+			seed = strtoull(argv[++i], nullptr, 10);
+		}
+		else if ((strcmp(argv[i], "-views") == 0) && (i + 1 < argc)) {
+			viewCount = std::max(atoi(argv[++i]), 1);
+		}
+		else {
+			sizes.push_back(atoi(argv[i]));
+		}
+	}
+	if (sizes.empty()) {
+		sizes = { 64, 256 };
+	}
+
+	printf("size,build(ms),sectors,portals,doors,cells frustum,cells pvs,cells portal,cells pvs+portal,sectors visible,portals passed,traversal(us),missed\n");
+
+	for (auto size : sizes) {
+		Dungeon dungeon(size, size, seed);
+		dungeon.generateRooms();
+		dungeon.generateCorridors();
+		dungeon.generateWalls();
+		dungeon.generateDoors();
+
+		PortalGraph portals;
+		double tBuild = timeStage([&] { portals.build(dungeon); });
+		const size_t doorCount = std::count_if(portals.portals.begin(), portals.portals.end(), [](const PortalGraph::Portal &portal) { return portal.door; });
+
+		PotentiallyVisibleSet visibility;
+		visibility.build(dungeon, (int)maxDrawDistance);
+
+		std::vector<uint32_t> walkable;
+		for (uint32_t i = 0; i < dungeon.cellTypes.size(); i++) {
+			if (dungeon.cellTypes[i] != Cell::cellTypeEmpty) {
+				walkable.push_back(i);
+			}
+		}
+
+		Random random(seed, 1);
+		uint64_t cellsFrustum = 0, cellsPvs = 0, cellsPortal = 0, cellsBoth = 0, sectorsVisible = 0, portalsPassed = 0, missed = 0;
+		double tTraversal = 0.0;
+		for (uint32_t v = 0; v < viewCount; v++) {
+			const uint32_t eyeCell = walkable[random.next() % walkable.size()];
+			const int eyeCellX = eyeCell % size;
+			const int eyeCellY = eyeCell / size;
+			const float eyeX = (float)eyeCellX;
+			const float eyeZ = (float)eyeCellY;
+			const float yaw = random.range(3600) * 3.14159265f / 1800.0f;
+			float viewProjection[16];
+			getViewProjection(eyeX, eyeZ, yaw, viewProjection);
+
+			tTraversal += timeStage([&] { portals.traverse(viewProjection, eyeX, eyeZ, maxDrawDistance); });
+			sectorsVisible += portals.visibleSectors.size();
+			portalsPassed += portals.portalsPassed;
+
+			const int range = (int)maxDrawDistance;
+			for (int y = std::max(eyeCellY - range, 0); y <= std::min(eyeCellY + range, size - 1); y++) {
+				for (int x = std::max(eyeCellX - range, 0); x <= std::min(eyeCellX + range, size - 1); x++) {
+					if ((dungeon.getCellType(x, y) == Cell::cellTypeEmpty) || ((x - eyeX) * (x - eyeX) + (y - eyeZ) * (y - eyeZ) > maxDrawDistance * maxDrawDistance)) {
+						continue;
+					}
+					float boxMin[3], boxMax[3];
+					getCellBox(portals, x, y, boxMin, boxMax);
+					PortalGraph::Rect rect;
+					if (!PortalGraph::projectBox(viewProjection, boxMin, boxMax, rect)) {
+						continue;
+					}
+					cellsFrustum++;
+					const bool pvs = visibility.isVisible(eyeCellX, eyeCellY, x, y);
+					const bool portal = portals.isBoxVisible(dungeon.getCellIndex(x, y), boxMin, boxMax, viewProjection);
+					cellsPvs += pvs ? 1 : 0;
+					cellsPortal += portal ? 1 : 0;
+					cellsBoth += (pvs && portal) ? 1 : 0;
+				}
+			}
+
+			missed += checkRays(dungeon, portals, viewProjection, eyeX, eyeZ, yaw);
+		}
+
+		printf("%d,%.3f,%zu,%zu,%zu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.2f,%llu\n", size, tBuild, portals.sectors.size(), portals.portals.size(), doorCount,
+			(double)cellsFrustum / viewCount, (double)cellsPvs / viewCount, (double)cellsPortal / viewCount, (double)cellsBoth / viewCount,
+			(double)sectorsVisible / viewCount, (double)portalsPassed / viewCount, tTraversal * 1000.0 / viewCount, (unsigned long long)missed);
+		if (missed > 0) {
+			fprintf(stderr, "Portal culling removed cells hit by view rays (%dx%d)\n", size, size);
+			return EXIT_FAILURE;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,113 @@
+/*
+* Dungeon generator thread scaling benchmark
+*
+* Times partition subdivision and room placement (Dungeon::generateRooms) for 1..N threads
+* and checks that every thread count results in the same dungeon as the serial path
+*
+* With -soak n the same dungeon is instead regenerated n times with different seeds to check
+* that memory use stays flat
+*
+* Usage: scalingbenchmark [-size n] [-threads n] [-runs n] [-seed n] [-soak n]
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#include "../generator/Dungeon.h"
+#include "benchmarkutils.h"
+
+using namespace dungeongenerator;
+
+int soak(int size, uint32_t threads, uint32_t count)
+{
+	printf("Regenerating a %dx%d dungeon %u times\n", size, size, count);
+	printf("iteration,partitions,rss(MB)\n");
+	Dungeon dungeon(size, size);
+	dungeon.threadCount = threads;
+	for (uint32_t i = 0; i < count; i++) {
+		dungeon.generateRooms(i);
+		dungeon.generateCorridors();
+		if ((i == 0) || ((i + 1) % std::max(count / 10, 1u) == 0)) {
+			printf("%u,%zu,%.2f\n", i + 1, dungeon.partitionList.size(), getResidentSetSize());
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int size = 8192;
+	uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	uint32_t runs = 3;
+	uint64_t seed = 0;
+	uint32_t soakCount = 0;
+
+	for (int i = 1; i < argc - 1; i++) {
+		if (strcmp(argv[i], "-size") == 0) {
+			size = atoi(argv[i + 1]);
+		}
+		if (strcmp(argv[i], "-threads") == 0) {
+			maxThreads = std::max(atoi(argv[i + 1]), 1);
+		}
+		if (strcmp(argv[i], "-runs") == 0) {
+			runs = std::max(atoi(argv[i + 1]), 1);
+		}
+		if (strcmp(argv[i], "-seed") == 0) {
+			seed = strtoull(argv[i + 1], nullptr, 10);
+		}
+		if (strcmp(argv[i], "-soak") == 0) {
+			soakCount = atoi(argv[i + 1]);
+		}
+	}
+
+	if (soakCount > 0) {
+		return soak(size, maxThreads, soakCount);
+	}
+
+	printf("generateRooms on %dx%d, seed %llu, %u run(s) per thread count\n", size, size, (unsigned long long)seed, runs);
+	printf("threads,best(ms),speedup,partitions,identical\n");
+
+	std::vector<uint8_t> reference;
+	size_t referencePartitions = 0;
+	double serialTime = 0.0;
+
+	for (uint32_t threads = 1; threads <= maxThreads; threads++) {
+		double best = 0.0;
+		bool identical = true;
+		size_t partitions = 0;
+		for (uint32_t r = 0; r < runs; r++) {
+			Dungeon dungeon(size, size, seed);
+			dungeon.threadCount = threads;
+			auto tStart = std::chrono::high_resolution_clock::now();
+			dungeon.generateRooms();
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			double tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+			best = (r == 0) ? tDiff : std::min(best, tDiff);
+			partitions = dungeon.partitionList.size();
+			if (reference.empty()) {
+				reference = dungeon.cellTypes;
+				referencePartitions = partitions;
+			}
+			identical &= (dungeon.cellTypes == reference) && (partitions == referencePartitions);
+		}
+		if (threads == 1) {
+			serialTime = best;
+		}
+		printf("%u,%.3f,%.2f,%zu,%s\n", threads, best, serialTime / best, partitions, identical ? "yes" : "NO");
+		if (!identical) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	return 0;
+}
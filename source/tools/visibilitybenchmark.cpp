@@ -0,0 +1,198 @@
+/*
+* Visibility benchmark
+*
+* Builds the potentially visible sets for dungeons of different sizes and compares the per frame cost of collecting
+* the visible cells around the player from the sets with the previous ray march over every cell within the draw
+* distance
+*
+* Checks that building on a thread pool gives the same sets and that updating the sets after edits gives the
+* same result as building them from scratch
+*
+* Usage: visibilitybenchmark [-seed n] [-radius n] [-threads n] [-queries n] [sizes...]
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#include "../generator/Dungeon.h"
+#include "../generator/PotentiallyVisibleSet.h"
+#include "../generator/BitPlane.h"
+#include "threadpool.hpp"
+#include "benchmarkutils.h"
+
+using namespace dungeongenerator;
+
+// Line of sight test previously used for the fog of war (samples the line between the cell centers)
+bool checkVisibility(const Dungeon &dungeon, int fromX, int fromY, int toX, int toY)
+{
+	float difX = (float)(toX - fromX);
+	float difY = (float)(toY - fromY);
+	float dist = fabsf(difX) + fabsf(difY);
+	if (dist == 0.0f) {
+		return true;
+	}
+	float dx = difX / dist;
+	float dy = difY / dist;
+	for (uint32_t i = 0; i <= ceilf(dist); i++) {
+		int x = (int)floorf(fromX + dx * i);
+		int y = (int)floorf(fromY + dy * i);
+		if (dungeon.getCellType(x, y) == Cell::cellTypeEmpty) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool equalSets(const PotentiallyVisibleSet &a, const PotentiallyVisibleSet &b)
+{
+	if (a.entries.size() != b.entries.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < a.entries.size(); i++) {
+		const PotentiallyVisibleSet::Entry &ea = a.entries[i];
+		const PotentiallyVisibleSet::Entry &eb = b.entries[i];
+		if ((ea.rowOffset != eb.rowOffset) || (ea.rowCount != eb.rowCount)) {
+			return false;
+		}
+		for (int row = ea.rowOffset; row < ea.rowOffset + ea.rowCount; row++) {
+			if (a.getRow((uint32_t)i, row) != b.getRow((uint32_t)i, row)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t seed = 0;
+	int radius = 16;
+	uint32_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+	uint32_t queryCount = 10000;
+	std::vector<int> sizes;
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-seed") == 0) && (i + 1 < argc)) {
+			seed = strtoull(argv[++i], nullptr, 10);
+		}
+		else if ((strcmp(argv[i], "-radius") == 0) && (i + 1 < argc)) {
+			radius = std::min(std::max(atoi(argv[++i]), 1), PotentiallyVisibleSet::maxRadius);
+		}
+		else if ((strcmp(argv[i], "-threads") == 0) && (i + 1 < argc)) {
+			threads = std::max(atoi(argv[++i]), 1);
+		}
+		else if ((strcmp(argv[i], "-queries") == 0) && (i + 1 < argc)) {
+			queryCount = std::max(atoi(argv[++i]), 1);
+		}
+		else {
+			sizes.push_back(atoi(argv[i]));
+		}
+	}
+	if (sizes.empty()) {
+		sizes = { 64, 256 };
+	}
+
+	vks::ThreadPool threadPool;
+	threadPool.setThreadCount(threads);
+
+	printf("size,build(ms),build %u threads(ms),memory(KB),uncompressed(KB),avg. visible,ray march(us/frame),pvs(us/frame),cells ray march,cells pvs,edit update(ms)\n", threads);
+
+	for (auto size : sizes) {
+		Dungeon dungeon(size, size, seed);
+		dungeon.generateRooms();
+		dungeon.generateCorridors();
+		dungeon.generateWalls();
+		dungeon.generateDoors();
+
+		PotentiallyVisibleSet pvs;
+		double tBuild = timeStage([&] { pvs.build(dungeon, radius); });
+		PotentiallyVisibleSet pvsThreaded;
+		double tBuildThreaded = timeStage([&] { pvsThreaded.build(dungeon, radius, &threadPool); });
+		if (!equalSets(pvs, pvsThreaded)) {
+			fprintf(stderr, "Sets built on the thread pool differ (%dx%d)\n", size, size);
+			return EXIT_FAILURE;
+		}
+
+		std::vector<uint32_t> walkable;
+		uint64_t visibleTotal = 0;
+		for (uint32_t i = 0; i < dungeon.cellTypes.size(); i++) {
+			if (dungeon.cellTypes[i] != Cell::cellTypeEmpty) {
+				walkable.push_back(i);
+				visibleTotal += pvs.getVisibleCount(i);
+			}
+		}
+		const size_t uncompressed = walkable.size() * (2 * radius + 1) * sizeof(uint64_t);
+
+		// Collect the visible cells around random player positions, both ways
+		Random random(seed, 1);
+		std::vector<uint32_t> playerCells(queryCount);
+		for (auto &cell : playerCells) {
+			cell = walkable[random.next() % walkable.size()];
+		}
+		uint64_t cellsRayMarch = 0;
+		double tRayMarch = timeStage([&] {
+			for (auto cell : playerCells) {
+				const int px = cell % size;
+				const int py = cell / size;
+				for (int y = std::max(py - radius, 0); y <= std::min(py + radius, size - 1); y++) {
+					for (int x = std::max(px - radius, 0); x <= std::min(px + radius, size - 1); x++) {
+						if ((dungeon.getCellType(x, y) != Cell::cellTypeEmpty) && ((x - px) * (x - px) + (y - py) * (y - py) <= radius * radius) &&
+							(checkVisibility(dungeon, px, py, x, y))) {
+							cellsRayMarch++;
+						}
+					}
+				}
+			}
+		});
+		uint64_t cellsPvs = 0;
+		double tPvs = timeStage([&] {
+			for (auto cell : playerCells) {
+				const int px = cell % size;
+				const int py = cell / size;
+				const PotentiallyVisibleSet::Entry &entry = pvs.entries[cell];
+				for (int row = 0; row < entry.rowCount; row++) {
+					const int y = py + entry.rowOffset + row;
+					for (uint64_t bits = pvs.getRow(cell, entry.rowOffset + row); bits != 0; bits &= bits - 1) {
+						const int x = px - radius + (int)BitPlane::getLowestBit(bits);
+						if ((x - px) * (x - px) + (y - py) * (y - py) <= radius * radius) {
+							cellsPvs++;
+						}
+					}
+				}
+			}
+		});
+
+		// Dig out random cells, update the sets and compare against a full rebuild
+		double tUpdate = 0.0;
+		const uint32_t editCount = 16;
+		for (uint32_t i = 0; i < editCount; i++) {
+			const int x = 1 + random.range(size - 2);
+			const int y = 1 + random.range(size - 2);
+			dungeon.setCellTypes(x, y, x, y, Cell::cellTypeCorridor);
+			dungeon.updateDirtyRegions();
+			tUpdate += timeStage([&] { pvs.update(dungeon, dungeon.changedCells); });
+		}
+		PotentiallyVisibleSet reference;
+		reference.build(dungeon, radius);
+		if (!equalSets(pvs, reference)) {
+			fprintf(stderr, "Updated sets differ from a full rebuild (%dx%d)\n", size, size);
+			return EXIT_FAILURE;
+		}
+
+		printf("%d,%.3f,%.3f,%.1f,%.1f,%.1f,%.2f,%.2f,%.1f,%.1f,%.3f\n", size, tBuild, tBuildThreaded, pvs.getMemorySize() / 1024.0, uncompressed / 1024.0,
+			(double)visibleTotal / walkable.size(), tRayMarch * 1000.0 / queryCount, tPvs * 1000.0 / queryCount,
+			(double)cellsRayMarch / queryCount, (double)cellsPvs / queryCount, tUpdate / editCount);
+	}
+
+	return 0;
+}
@@ -0,0 +1,122 @@
+/*
+* Scripted walkthrough benchmark
+*
+* Builds the walk visiting every room (as used for the renderer's benchmark runs) for dungeons of different sizes and
+* measures how long it takes
+*
+* Checks that the walk only steps between neighbouring non-empty cells, that it reaches the center of every room and
+* that building it again gives the same walk
+*
+* Usage: walkthroughbenchmark [-seed n] [sizes...]
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "../generator/Dungeon.h"
+#include "../generator/Pathfinder.h"
+#include "../generator/Walkthrough.h"
+#include "benchmarkutils.h"
+
+using namespace dungeongenerator;
+
+// Returns the number of errors in the walk
+uint32_t checkWalkthrough(const Dungeon &dungeon, const Walkthrough &walkthrough, uint32_t roomCount)
+{
+	uint32_t errors = 0;
+	const std::vector<uint32_t> &path = walkthrough.path;
+	for (size_t i = 0; i < path.size(); i++) {
+		if (dungeon.cellTypes[path[i]] == Cell::cellTypeEmpty) {
+			errors++;
+		}
+		if (i > 0) {
+			const int dx = abs((int)(path[i] % dungeon.width) - (int)(path[i - 1] % dungeon.width));
+			const int dy = abs((int)(path[i] / dungeon.width) - (int)(path[i - 1] / dungeon.width));
+			if (dx + dy != 1) {
+				errors++;
+			}
+		}
+	}
+	// All rooms are connected, so every room has to be visited (once)
+	if ((walkthrough.unreachableRooms > 0) || (walkthrough.rooms.size() != roomCount)) {
+		errors++;
+	}
+	for (auto index : walkthrough.rooms) {
+		const BspPartition &room = dungeon.partitions[index];
+		if (std::find(path.begin(), path.end(), dungeon.getCellIndex(room.centerX, room.centerY)) == path.end()) {
+			errors++;
+		}
+	}
+	return errors;
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t seed = 0;
+	std::vector<int> sizes;
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-seed") == 0) && (i + 1 < argc)) {
+			seed = strtoull(argv[++i], nullptr, 10);
+		}
+		else {
+			sizes.push_back(atoi(argv[i]));
+		}
+	}
+	if (sizes.empty()) {
+		sizes = { 64, 256, 1024 };
+	}
+
+	printf("size,rooms,visited,path cells,build(ms)\n");
+
+	for (auto size : sizes) {
+		Dungeon dungeon(size, size, seed);
+		dungeon.generateRooms();
+		dungeon.generateCorridors();
+		dungeon.generateWalls();
+		dungeon.generateDoors();
+
+		Pathfinder pathfinder;
+		pathfinder.build(dungeon);
+
+		// Start in the first room of the partition list
+		uint32_t roomCount = 0;
+		const BspPartition *start = nullptr;
+		for (auto index : dungeon.partitionList) {
+			if (dungeon.partitions[index].hasRoom) {
+				start = start ? start : &dungeon.partitions[index];
+				roomCount++;
+			}
+		}
+		if (!start) {
+			fprintf(stderr, "Dungeon has no rooms (%dx%d)\n", size, size);
+			return EXIT_FAILURE;
+		}
+
+		Walkthrough walkthrough;
+		double tBuild = timeStage([&] { walkthrough.build(dungeon, pathfinder, start->centerX, start->centerY); });
+		Walkthrough reference;
+		reference.build(dungeon, pathfinder, start->centerX, start->centerY);
+
+		uint32_t errors = checkWalkthrough(dungeon, walkthrough, roomCount);
+		if ((walkthrough.path != reference.path) || (walkthrough.rooms != reference.rooms)) {
+			errors++;
+		}
+
+		printf("%d,%u,%zu,%zu,%.3f\n", size, roomCount, walkthrough.rooms.size(), walkthrough.path.size(), tBuild);
+		if (errors > 0) {
+			fprintf(stderr, "Invalid walkthrough (%dx%d, %u errors)\n", size, size, errors);
+			return EXIT_FAILURE;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,198 @@
+/*
+* Dungeon wall and door generation benchmark
+*
+* Checks that the bit parallel wall and door generation (Dungeon::generateWalls/generateDoors) produces
+* the same results as the scalar reference versions for generated dungeons and random cell grids of
+* different (also non multiple of 64) sizes, then compares the speed of both versions
+*
+* Also checks that incremental edits (Dungeon::setCellTypes + updateDirtyRegions) result in the same walls
+* and doors as regenerating them for the whole grid and compares the cost of both
+*
+* Usage: wallbenchmark [size]...
+*
+* Copyright (C) 2017 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "../generator/Dungeon.h"
+#include "benchmarkutils.h"
+
+using namespace dungeongenerator;
+
+// Runs both versions on a copy of the dungeon and compares the resulting wall and door masks
+bool checkEquivalence(const Dungeon &dungeon, const char *description)
+{
+	Dungeon scalar = dungeon;
+	scalar.generateWallsScalar();
+	scalar.generateDoorsScalar();
+	Dungeon bitParallel = dungeon;
+	bitParallel.generateWalls();
+	bitParallel.generateDoors();
+	for (int y = 0; y < dungeon.height; y++) {
+		for (int x = 0; x < dungeon.width; x++) {
+			const uint32_t index = dungeon.getCellIndex(x, y);
+			if ((scalar.cellWalls[index] != bitParallel.cellWalls[index]) || (scalar.cellDoors[index] != bitParallel.cellDoors[index])) {
+				fprintf(stderr, "Mismatch for %s (%dx%d) at %d/%d: walls %x/%x doors %x/%x\n", description, dungeon.width, dungeon.height, x, y,
+					scalar.cellWalls[index], bitParallel.cellWalls[index], scalar.cellDoors[index], bitParallel.cellDoors[index]);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool runEquivalenceTests()
+{
+	const int sizes[][2] = { { 1, 1 }, { 2, 5 }, { 3, 3 }, { 7, 9 }, { 63, 63 }, { 64, 64 }, { 65, 65 }, { 100, 37 }, { 127, 129 }, { 200, 300 } };
+	uint32_t count = 0;
+	for (auto &size : sizes) {
+		for (uint64_t seed = 0; seed < 8; seed++) {
+			// Generated dungeon (partitioning needs a minimum size)
+			if ((size[0] >= 16) && (size[1] >= 16)) {
+				Dungeon dungeon(size[0], size[1], seed);
+				dungeon.generateRooms();
+				dungeon.generateCorridors();
+				if (!checkEquivalence(dungeon, "generated dungeon")) {
+					return false;
+				}
+				count++;
+			}
+			// Random cell types, also covers cases that generated dungeons rarely contain (e.g. cells at the border)
+			Dungeon noise(size[0], size[1], seed);
+			Random random(seed, 1);
+			for (auto &type : noise.cellTypes) {
+				type = (uint8_t)random.range(3);
+			}
+			if (!checkEquivalence(noise, "random grid")) {
+				return false;
+			}
+			count++;
+		}
+	}
+	printf("%u grids checked, bit parallel and scalar versions are identical\n", count);
+	return true;
+}
+
+// Walls and doors for the whole grid as generated from scratch
+void regenerateWallsAndDoors(Dungeon &dungeon)
+{
+	std::fill(dungeon.cellWalls.begin(), dungeon.cellWalls.end(), 0);
+	std::fill(dungeon.cellDoors.begin(), dungeon.cellDoors.end(), 0);
+	dungeon.generateWalls();
+	dungeon.generateDoors();
+}
+
+// Applies random edits and compares the incrementally updated grid (incl. the change list) against a full regeneration
+bool runEditTests()
+{
+	uint32_t editCount = 0;
+	for (uint64_t seed = 0; seed < 8; seed++) {
+		Dungeon dungeon(97, 131, seed);
+		dungeon.generateRooms();
+		dungeon.generateCorridors();
+		dungeon.generateWalls();
+		dungeon.generateDoors();
+		Random random(seed, 2);
+		for (uint32_t i = 0; i < 200; i++) {
+			const int left = random.range(dungeon.width + 4) - 2;
+			const int top = random.range(dungeon.height + 4) - 2;
+			const int right = left + random.range(6);
+			const int bottom = top + random.range(6);
+			dungeon.setCellTypes(left, top, right, bottom, (uint8_t)random.range(3));
+			// Also batch several edits before updating
+			if (random.range(4) != 0) {
+				continue;
+			}
+			dungeon.updateDirtyRegions();
+			Dungeon reference = dungeon;
+			regenerateWallsAndDoors(reference);
+			if ((dungeon.cellWalls != reference.cellWalls) || (dungeon.cellDoors != reference.cellDoors)) {
+				fprintf(stderr, "Incremental update differs from full regeneration (seed %llu, edit %u)\n", (unsigned long long)seed, i);
+				return false;
+			}
+			editCount++;
+		}
+	}
+	// Change list contains exactly the cells that differ
+	Dungeon dungeon(64, 64, 0);
+	dungeon.generateRooms();
+	dungeon.generateCorridors();
+	dungeon.generateWalls();
+	dungeon.generateDoors();
+	const Dungeon before = dungeon;
+	dungeon.setCellTypes(10, 10, 20, 12, Cell::cellTypeCorridor);
+	dungeon.setCellTypes(30, 40, 31, 50, Cell::cellTypeEmpty);
+	dungeon.updateDirtyRegions();
+	std::vector<uint32_t> expected;
+	for (uint32_t i = 0; i < dungeon.cellTypes.size(); i++) {
+		if ((dungeon.cellTypes[i] != before.cellTypes[i]) || (dungeon.cellWalls[i] != before.cellWalls[i]) || (dungeon.cellDoors[i] != before.cellDoors[i])) {
+			expected.push_back(i);
+		}
+	}
+	if (dungeon.changedCells != expected) {
+		fprintf(stderr, "Change list mismatch (%zu cells, expected %zu)\n", dungeon.changedCells.size(), expected.size());
+		return false;
+	}
+	printf("%u incremental updates checked, identical to full regeneration\n", editCount);
+	return true;
+}
+
+void runBenchmark(int size, const Dungeon &tile, uint32_t runs)
+{
+	Dungeon dungeon(size, size);
+	fillDungeon(dungeon, tile);
+
+	double tWallsScalar = timeRuns(runs, [&] { dungeon.generateWallsScalar(); });
+	double tDoorsScalar = timeRuns(runs, [&] { dungeon.generateDoorsScalar(); });
+	double tWalls = timeRuns(runs, [&] { dungeon.generateWalls(); });
+	double tDoors = timeRuns(runs, [&] { dungeon.generateDoors(); });
+
+	// Digging a single cell, updating incrementally vs. regenerating walls and doors for the whole grid
+	const int digX = size / 2;
+	const int digY = size / 2;
+	uint8_t digType = Cell::cellTypeCorridor;
+	double tEdit = timeRuns(runs, [&] {
+		dungeon.setCellTypes(digX, digY, digX, digY, digType);
+		dungeon.updateDirtyRegions();
+		digType = (digType == Cell::cellTypeCorridor) ? Cell::cellTypeEmpty : Cell::cellTypeCorridor;
+	});
+
+	printf("%5dx%-5d walls: %9.3f ms -> %9.3f ms (%5.1fx)  doors: %9.3f ms -> %9.3f ms (%5.1fx)  single cell edit: %9.3f ms -> %7.4f ms\n",
+		size, size,
+		tWallsScalar, tWalls, tWallsScalar / tWalls,
+		tDoorsScalar, tDoors, tDoorsScalar / tDoors,
+		tWalls + tDoors, tEdit);
+}
+
+int main(int argc, char *argv[])
+{
+	if ((!runEquivalenceTests()) || (!runEditTests())) {
+		return EXIT_FAILURE;
+	}
+
+	Dungeon tile(256, 256, 0);
+	tile.generateRooms();
+	tile.generateCorridors();
+
+	std::vector<int> sizes = { 256, 4096 };
+	if (argc > 1) {
+		sizes.clear();
+		for (int i = 1; i < argc; i++) {
+			sizes.push_back(atoi(argv[i]));
+		}
+	}
+
+	for (auto size : sizes) {
+		runBenchmark(size, tile, (size <= 1024) ? 20 : 3);
+	}
+
+	return 0;
+}